@@ -1,9 +1,9 @@
 from info import __doc__
 
-__all__ = ['xfloat16']
+__all__ = ['xfloat16', 'bfloat16', 'float8_e4m3fn', 'float8_e5m2']
 
 import numpy
-from .numpy_xhalf import xfloat16
+from .numpy_xhalf import xfloat16, bfloat16, float8_e4m3fn, float8_e5m2
 
 if numpy.__dict__.get('xfloat16') is not None:
     raise RuntimeError('The NumPy package already has a half/xfloat16 type')
@@ -11,12 +11,18 @@ if numpy.__dict__.get('xfloat16') is not None:
 # Add xfloat16 into the numpy module space
 numpy.xhalf = xfloat16
 numpy.xfloat16 = xfloat16
+numpy.bfloat16 = bfloat16
+numpy.float8_e4m3fn = float8_e4m3fn
+numpy.float8_e5m2 = float8_e5m2
 
 def add_to_typeDict():
     # Add it to the numpy type dictionary
     import sys
     f16 = numpy.dtype(xfloat16)
     numpy.typeDict['xfloat16'] = f16
+    numpy.typeDict['bfloat16'] = numpy.dtype(bfloat16)
+    numpy.typeDict['float8_e4m3fn'] = numpy.dtype(float8_e4m3fn)
+    numpy.typeDict['float8_e5m2'] = numpy.dtype(float8_e5m2)
     # numpy.typeDict['f2'] = f16
     # numpy.typeDict['=f2'] = f16
     # if sys.byteorder == 'little':
@@ -0,0 +1,435 @@
+/*
+ * Cycles per element of the half conversion primitives in halffloat.c,
+ * over value distributions that take their different paths.  It needs
+ * neither Python nor NumPy:
+ *
+ *   cc -O2 -DHALF_STANDALONE -I. benchmarks/bench_convert.c halffloat.c \
+ *      -o bench_convert
+ *   ./bench_convert [n [repeats [simd_level]]]
+ *
+ * Cycles come from the Linux perf cycle counter when it can be opened,
+ * then from rdtsc (reference cycles at the TSC rate) on x86.  The best of
+ * the repeats over n elements (4096 by default, so the data stays in L1)
+ * is reported, with nanoseconds per element next to it.
+ */
+#include "halffloat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define BENCH_HAVE_PERF 1
+#else
+#define BENCH_HAVE_PERF 0
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_RDTSC 1
+#else
+#define BENCH_HAVE_RDTSC 0
+#endif
+
+/*
+ ********************************************************************
+ *                        CYCLE COUNTERS                            *
+ ********************************************************************
+ */
+
+static const char *counter_name = "none";
+#if BENCH_HAVE_PERF
+static int perf_fd = -1;
+#endif
+
+static void
+counter_open(void)
+{
+#if BENCH_HAVE_PERF
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    perf_fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (perf_fd >= 0) {
+        counter_name = "perf cpu-cycles";
+        return;
+    }
+#endif
+#if BENCH_HAVE_RDTSC
+    counter_name = "rdtsc reference cycles";
+#endif
+}
+
+static npy_uint64
+counter_read(void)
+{
+#if BENCH_HAVE_PERF
+    npy_uint64 count;
+
+    if (perf_fd >= 0 && read(perf_fd, &count, sizeof(count)) ==
+                                                    sizeof(count)) {
+        return count;
+    }
+#endif
+#if BENCH_HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static double
+seconds(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+ ********************************************************************
+ *                      VALUE DISTRIBUTIONS                         *
+ ********************************************************************
+ */
+
+static npy_uint32 rng_state = 0x12345678u;
+
+static npy_uint32
+rng_next(void)
+{
+    /* xorshift32 */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* A float with a random sign and mantissa, and an exponent in [lo, hi] */
+static npy_uint32
+rng_float(npy_uint32 lo, npy_uint32 hi)
+{
+    npy_uint32 r = rng_next();
+
+    return (r & 0x80000000u) | ((lo + rng_next() % (hi - lo + 1)) << 23) |
+           (r & 0x007fffffu);
+}
+
+/* Halves are normal for float exponents 113 to 142 */
+static npy_uint32
+make_normal(void)
+{
+    return rng_float(113, 142);
+}
+
+/* Values that round to half subnormals */
+static npy_uint32
+make_denormal(void)
+{
+    return rng_float(103, 112);
+}
+
+/* Values above the half range, one in eight infinite */
+static npy_uint32
+make_overflow(void)
+{
+    npy_uint32 f = rng_float(143, 254);
+
+    return (rng_next() & 7) ? f : (f & 0x80000000u) | 0x7f800000u;
+}
+
+/* Quiet and signalling NaNs with random payloads */
+static npy_uint32
+make_nan(void)
+{
+    npy_uint32 f = rng_float(255, 255);
+
+    return (f & 0x007fffffu) ? f : f | 0x00400000u;
+}
+
+/* Exactly halfway between two normal halves */
+static npy_uint32
+make_tie(void)
+{
+    return (make_normal() & 0xffffe000u) | 0x00001000u;
+}
+
+static npy_uint32
+make_denormal_1(void)
+{
+    return rng_next() % 100 < 1 ? make_denormal() : make_normal();
+}
+
+static npy_uint32
+make_denormal_10(void)
+{
+    return rng_next() % 100 < 10 ? make_denormal() : make_normal();
+}
+
+static npy_uint32
+make_denormal_50(void)
+{
+    return rng_next() % 100 < 50 ? make_denormal() : make_normal();
+}
+
+typedef struct {
+    const char *name;
+    npy_uint32 (*make)(void);
+} distribution;
+
+static const distribution distributions[] = {
+    {"normal", make_normal},
+    {"denormal", make_denormal},
+    {"overflow", make_overflow},
+    {"nan", make_nan},
+    {"tie", make_tie},
+    {"denorm1%", make_denormal_1},
+    {"denorm10%", make_denormal_10},
+    {"denorm50%", make_denormal_50},
+};
+#define NDIST ((int)(sizeof(distributions) / sizeof(distributions[0])))
+
+/*
+ ********************************************************************
+ *                          PRIMITIVES                              *
+ ********************************************************************
+ */
+
+/* The inputs of one distribution in each source format */
+typedef struct {
+    npy_uint32 *f;
+    npy_uint64 *d;
+    npy_uint16 *h;
+} inputs;
+
+/* The output buffers, one per destination format */
+typedef struct {
+    npy_uint16 *h;
+    npy_uint32 *f;
+    npy_uint64 *d;
+} outputs;
+
+static void
+run_float_to_half(const inputs *in, outputs *out, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        out->h[i] = floatbits_to_halfbits(in->f[i]);
+    }
+}
+
+static void
+run_double_to_half(const inputs *in, outputs *out, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        out->h[i] = doublebits_to_halfbits(in->d[i]);
+    }
+}
+
+static void
+run_half_to_float(const inputs *in, outputs *out, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        out->f[i] = halfbits_to_floatbits(in->h[i]);
+    }
+}
+
+static void
+run_half_to_double(const inputs *in, outputs *out, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        out->d[i] = halfbits_to_doublebits(in->h[i]);
+    }
+}
+
+static void
+run_float_to_half_n(const inputs *in, outputs *out, npy_intp n)
+{
+    floatbits_to_halfbits_n(in->f, out->h, n);
+}
+
+static void
+run_double_to_half_n(const inputs *in, outputs *out, npy_intp n)
+{
+    doublebits_to_halfbits_n(in->d, out->h, n);
+}
+
+static void
+run_half_to_float_n(const inputs *in, outputs *out, npy_intp n)
+{
+    halfbits_to_floatbits_n(in->h, out->f, n);
+}
+
+static void
+run_half_to_double_n(const inputs *in, outputs *out, npy_intp n)
+{
+    halfbits_to_doublebits_n(in->h, out->d, n);
+}
+
+static void
+run_float_to_half_rtz_n(const inputs *in, outputs *out, npy_intp n)
+{
+    floatbits_to_halfbits_round_n(in->f, out->h, n,
+                                  HALF_ROUNDING_TOWARD_ZERO, 0, 0);
+}
+
+static void
+run_float_to_half_sr_n(const inputs *in, outputs *out, npy_intp n)
+{
+    floatbits_to_halfbits_round_n(in->f, out->h, n,
+                                  HALF_ROUNDING_STOCHASTIC, 1, 0);
+}
+
+static void
+run_double_to_half_rtz_n(const inputs *in, outputs *out, npy_intp n)
+{
+    doublebits_to_halfbits_round_n(in->d, out->h, n,
+                                   HALF_ROUNDING_TOWARD_ZERO, 0, 0);
+}
+
+static void
+run_double_to_half_sr_n(const inputs *in, outputs *out, npy_intp n)
+{
+    doublebits_to_halfbits_round_n(in->d, out->h, n,
+                                   HALF_ROUNDING_STOCHASTIC, 1, 0);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(const inputs *in, outputs *out, npy_intp n);
+} primitive;
+
+static const primitive primitives[] = {
+    {"floatbits_to_halfbits", run_float_to_half},
+    {"doublebits_to_halfbits", run_double_to_half},
+    {"halfbits_to_floatbits", run_half_to_float},
+    {"halfbits_to_doublebits", run_half_to_double},
+    {"floatbits_to_halfbits_n", run_float_to_half_n},
+    {"doublebits_to_halfbits_n", run_double_to_half_n},
+    {"halfbits_to_floatbits_n", run_half_to_float_n},
+    {"halfbits_to_doublebits_n", run_half_to_double_n},
+    {"float->half toward zero", run_float_to_half_rtz_n},
+    {"float->half stochastic", run_float_to_half_sr_n},
+    {"double->half toward zero", run_double_to_half_rtz_n},
+    {"double->half stochastic", run_double_to_half_sr_n},
+};
+#define NPRIM ((int)(sizeof(primitives) / sizeof(primitives[0])))
+
+/*
+ * Fills the inputs from a distribution of floats.  The doubles hold the
+ * same values, and the halves are the floats rounded, so that each
+ * format sees the same mix of normals, subnormals, infinities and NaNs.
+ */
+static void
+fill_inputs(inputs *in, const distribution *dist, npy_intp n)
+{
+    npy_intp i;
+    float f;
+    double d;
+
+    for (i = 0; i < n; i++) {
+        in->f[i] = dist->make();
+        memcpy(&f, &in->f[i], sizeof(f));
+        d = f;
+        memcpy(&in->d[i], &d, sizeof(d));
+        in->h[i] = floatbits_to_halfbits(in->f[i]);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    npy_intp n = argc > 1 ? atol(argv[1]) : 4096;
+    int repeats = argc > 2 ? atoi(argv[2]) : 200;
+    static double cycles[NPRIM][NDIST], nanos[NPRIM][NDIST];
+    inputs in;
+    outputs out;
+    int p, k, r;
+
+    if (n <= 0 || repeats <= 0) {
+        fprintf(stderr, "usage: %s [n [repeats [simd_level]]]\n", argv[0]);
+        return 2;
+    }
+    if (argc > 3) {
+        half_set_simd_level(atoi(argv[3]));
+    }
+    in.f = (npy_uint32 *)malloc(n * sizeof(*in.f));
+    in.d = (npy_uint64 *)malloc(n * sizeof(*in.d));
+    in.h = (npy_uint16 *)malloc(n * sizeof(*in.h));
+    out.f = (npy_uint32 *)malloc(n * sizeof(*out.f));
+    out.d = (npy_uint64 *)malloc(n * sizeof(*out.d));
+    out.h = (npy_uint16 *)malloc(n * sizeof(*out.h));
+    if (!in.f || !in.d || !in.h || !out.f || !out.d || !out.h) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    counter_open();
+
+    for (k = 0; k < NDIST; k++) {
+        fill_inputs(&in, &distributions[k], n);
+        for (p = 0; p < NPRIM; p++) {
+            npy_uint64 best = (npy_uint64)-1, c;
+            double best_t = 1e300, t;
+
+            primitives[p].run(&in, &out, n);
+            for (r = 0; r < repeats; r++) {
+                t = seconds();
+                c = counter_read();
+                primitives[p].run(&in, &out, n);
+                c = counter_read() - c;
+                t = seconds() - t;
+                best = c < best ? c : best;
+                best_t = t < best_t ? t : best_t;
+            }
+            cycles[p][k] = (double)best / n;
+            nanos[p][k] = best_t * 1e9 / n;
+        }
+    }
+
+    printf("n = %ld, best of %d, simd level %d, %s\n\n", (long)n, repeats,
+           half_simd_level(), counter_name);
+    printf("%-26s", "cycles/element");
+    for (k = 0; k < NDIST; k++) {
+        printf(" %9s", distributions[k].name);
+    }
+    printf("\n");
+    for (p = 0; p < NPRIM; p++) {
+        printf("%-26s", primitives[p].name);
+        for (k = 0; k < NDIST; k++) {
+            printf(" %9.2f", cycles[p][k]);
+        }
+        printf("\n");
+    }
+    printf("\n%-26s", "ns/element");
+    for (k = 0; k < NDIST; k++) {
+        printf(" %9s", distributions[k].name);
+    }
+    printf("\n");
+    for (p = 0; p < NPRIM; p++) {
+        printf("%-26s", primitives[p].name);
+        for (k = 0; k < NDIST; k++) {
+            printf(" %9.2f", nanos[p][k]);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,252 @@
+"""Throughput benchmarks for the xfloat16 casts and array functions.
+
+Every registered cast to and from xfloat16, dot, argmax, fill, the sorts
+and getitem/setitem are timed over working sets from L1-resident to
+DRAM-bound, contiguous, strided and unaligned, next to the same operation
+on float32.  Run it as
+
+    python -m half.benchmarks.bench_half [--quick] [--json FILE]
+                                         [--compare FILE] [--filter REGEX]
+
+The ratio column is the float32 time over the xfloat16 time.  --json
+writes the results for a later --compare, which lists every case that
+lost more than --threshold of its throughput and exits with 1.
+"""
+import argparse
+import json
+import platform
+import re
+import sys
+import time
+import warnings
+
+import numpy as np
+from half import xfloat16, numpy_xhalf
+
+# Bytes touched by one call on xfloat16, float32 runs the same item count
+SIZES = [('L1', 16 << 10), ('L2', 256 << 10), ('L3', 4 << 20),
+         ('DRAM', 64 << 20)]
+LAYOUTS = ['contiguous', 'strided', 'unaligned']
+# Elementwise Python work is too slow for the largest sizes
+SLOW_LIMIT = 4 << 20
+
+# Every type with a registered cast to and from xfloat16
+CAST_TYPES = [np.bool_, np.byte, np.ubyte, np.short, np.ushort, np.intc,
+              np.uintc, np.int_, np.uint, np.longlong, np.ulonglong,
+              np.single, np.double, np.longdouble, np.csingle, np.cdouble,
+              np.clongdouble]
+
+
+def make(dtype, n, layout, rng, scale=100):
+    """An array of n values of dtype with the given memory layout"""
+    dtype = np.dtype(dtype)
+    if dtype.kind == 'b':
+        v = rng.random_sample(n) < 0.5
+    elif dtype.kind in 'iu':
+        v = rng.randint(0, 100, n)
+    else:
+        v = rng.standard_normal(n) * scale
+    if layout == 'contiguous':
+        a = np.empty(n, dtype)
+    elif layout == 'strided':
+        a = np.empty(2 * n, dtype)[::2]
+    else:
+        buf = np.empty(n * dtype.itemsize + 1, np.uint8)
+        a = np.frombuffer(buf, dtype, n, 1)
+    with warnings.catch_warnings():
+        warnings.simplefilter('ignore')
+        a[...] = v
+    return a
+
+
+def timeit(fn, min_time):
+    """Best seconds per call of fn over five runs of at least min_time"""
+    fn()
+    number = 1
+    while True:
+        t = time.perf_counter()
+        for _ in range(number):
+            fn()
+        t = time.perf_counter() - t
+        if t >= min_time:
+            break
+        number *= 2 if t <= 0 else max(2, int(min_time / t * 1.2))
+    best = t
+    for _ in range(4):
+        t = time.perf_counter()
+        for _ in range(number):
+            fn()
+        best = min(best, time.perf_counter() - t)
+    return best / number
+
+
+def cases(layout, rng, slow):
+    """(name, width, setup) for every operation, where setup(T, n) returns
+    the callable timing it on n items of T, xfloat16 or float32, and
+    width(T) the bytes it moves per item"""
+    out = []
+    for S in CAST_TYPES:
+        name = S.__name__
+
+        def to_half(T, n, S=S):
+            src = make(S, n, layout, rng)
+            dst = make(T, n, layout, rng)
+            return lambda: np.copyto(dst, src, casting='unsafe')
+
+        def from_half(T, n, S=S):
+            src = make(T, n, layout, rng)
+            dst = make(S, n, layout, rng)
+            return lambda: np.copyto(dst, src, casting='unsafe')
+
+        def width(T, k=np.dtype(S).itemsize):
+            return k + np.dtype(T).itemsize
+        out.append(('cast %s->T' % name, width, to_half))
+        out.append(('cast T->%s' % name, width, from_half))
+
+    def dot(T, n):
+        a = make(T, n, layout, rng, 1)
+        b = make(T, n, layout, rng, 1)
+        return lambda: np.dot(a, b)
+
+    def argmax(T, n):
+        a = make(T, n, layout, rng)
+        return lambda: a.argmax()
+
+    def fill(T, n):
+        # arange sets the first two items and fills in the rest
+        return lambda: np.arange(0, n / 1024.0, 1 / 1024.0, dtype=T)
+
+    def itemsize(T):
+        return np.dtype(T).itemsize
+    out += [('dot', lambda T: 2 * itemsize(T), dot),
+            ('argmax', itemsize, argmax), ('fill', itemsize, fill)]
+    if not slow:
+        return out
+
+    def sort(T, n, kind='quicksort'):
+        a = make(T, n, layout, rng)
+        return lambda: np.sort(a, kind=kind)
+
+    def mergesort(T, n):
+        return sort(T, n, 'mergesort')
+
+    def argsort(T, n):
+        a = make(T, n, layout, rng)
+        return lambda: np.argsort(a)
+
+    def getitem(T, n):
+        a = make(T, n, layout, rng)
+        return lambda: a.tolist()
+
+    def setitem(T, n):
+        a = make(T, n, layout, rng)
+        values = a.tolist()
+
+        def run():
+            a[...] = values
+        return run
+    out += [('sort', itemsize, sort), ('mergesort', itemsize, mergesort),
+            ('argsort', itemsize, argsort), ('getitem', itemsize, getitem),
+            ('setitem', itemsize, setitem)]
+    return out
+
+
+def run(sizes=SIZES, layouts=LAYOUTS, pattern=None, min_time=0.02,
+        out=sys.stdout):
+    """Times every case and returns the result records"""
+    rng = np.random.RandomState(0)
+    pattern = re.compile(pattern or '')
+    results = []
+    if out is not None:
+        out.write('%-24s %-5s %-10s %9s %9s %9s %6s\n' %
+                  ('case', 'size', 'layout', 'Melem/s', 'GB/s',
+                   'f32 GB/s', 'ratio'))
+    for level, size in sizes:
+        for layout in layouts:
+            for name, width, setup in cases(layout, rng, size <= SLOW_LIMIT):
+                if not pattern.search(name):
+                    continue
+                n = size // width(xfloat16)
+                with warnings.catch_warnings(), np.errstate(all='ignore'):
+                    warnings.simplefilter('ignore')
+                    t = timeit(setup(xfloat16, n), min_time)
+                    base = timeit(setup(np.float32, n), min_time)
+                r = {'case': name, 'level': level, 'n': n,
+                     'layout': layout, 'seconds': t,
+                     'elements_per_s': n / t,
+                     'gb_per_s': n * width(xfloat16) / t / 1e9,
+                     'float32_elements_per_s': n / base,
+                     'float32_gb_per_s': n * width(np.float32) / base / 1e9,
+                     'ratio': base / t}
+                results.append(r)
+                if out is not None:
+                    out.write('%-24s %-5s %-10s %9.1f %9.2f %9.2f %6.2f\n' %
+                              (name, level, layout, r['elements_per_s'] / 1e6,
+                               r['gb_per_s'], r['float32_gb_per_s'],
+                               r['ratio']))
+                    out.flush()
+    return results
+
+
+def environment():
+    return {'numpy': np.__version__, 'python': platform.python_version(),
+            'machine': platform.machine(), 'platform': platform.platform(),
+            'processor': platform.processor(),
+            'simd_level': numpy_xhalf.simd_level()}
+
+
+def compare(results, baseline, threshold, out=sys.stdout):
+    """The cases in results slower than baseline by more than threshold"""
+    key = lambda r: (r['case'], r['level'], r['layout'])
+    old = dict((key(r), r) for r in baseline['results'])
+    slower = []
+    for r in results:
+        b = old.get(key(r))
+        if b is not None and r['elements_per_s'] < \
+                b['elements_per_s'] * (1 - threshold):
+            slower.append((r, b))
+            out.write('slower: %-24s %-5s %-10s %9.1f -> %9.1f Melem/s\n' %
+                      (r['case'], r['level'], r['layout'],
+                       b['elements_per_s'] / 1e6, r['elements_per_s'] / 1e6))
+    return slower
+
+
+def main(argv=None):
+    p = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    p.add_argument('--quick', action='store_true',
+                   help='only the L1 and L2 sizes, contiguous')
+    p.add_argument('--filter', help='only the cases matching this regex')
+    p.add_argument('--simd', type=int, help='cap the SIMD level')
+    p.add_argument('--min-time', type=float, default=0.02,
+                   help='seconds per timing run (default 0.02)')
+    p.add_argument('--json', help='write the results to this file')
+    p.add_argument('--compare', help='results of an earlier --json run')
+    p.add_argument('--threshold', type=float, default=0.1,
+                   help='slowdown reported by --compare (default 0.1)')
+    args = p.parse_args(argv)
+
+    if args.simd is not None:
+        numpy_xhalf.set_simd_level(args.simd)
+    sizes, layouts = SIZES, LAYOUTS
+    if args.quick:
+        sizes, layouts = SIZES[:2], LAYOUTS[:1]
+    results = run(sizes, layouts, args.filter, args.min_time)
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({'version': 1, 'environment': environment(),
+                       'results': results}, f, indent=1)
+    if args.compare:
+        with open(args.compare) as f:
+            baseline = json.load(f)
+        if compare(results, baseline, args.threshold):
+            return 1
+    return 0
+
+
+def bench_half():
+    """Entry point for numpy.testing.Tester().bench"""
+    main(['--quick'])
+
+
+if __name__ == '__main__':
+    sys.exit(main())
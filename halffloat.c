@@ -27,7 +27,11 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "halffloat.h"
+#ifndef HALF_STANDALONE
 #include "numpy/ufuncobject.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
 
 /*
  * This chooses between 'ties to even' and 'ties away from zero'.
@@ -319,8 +323,37 @@ half_ge(npy_half h1, npy_half h2)
  * from zero', depending on a #define above.
  */
 
-npy_uint16
-floatbits_to_halfbits(npy_uint32 f)
+static int half_fpe_selected = HALF_FPE_RAISE;
+
+/*
+ * Raises the FP flags of a HALF_FPE_* status, once for all the values it
+ * was collected over, unless the mode is HALF_FPE_IGNORE.
+ */
+static void
+half_raise_status(int status)
+{
+    if (half_fpe_selected != HALF_FPE_RAISE) {
+        return;
+    }
+#if HALF_GENERATE_OVERFLOW
+    if (status & HALF_FPE_OVERFLOW) {
+        generate_overflow_error();
+    }
+#endif
+#if HALF_GENERATE_UNDERFLOW
+    if (status & HALF_FPE_UNDERFLOW) {
+        generate_underflow_error();
+    }
+#endif
+    (void)status;
+}
+
+/*
+ * The conversions collect their overflow and underflow in *status, so a
+ * bulk loop keeps them in a register and raises them once.
+ */
+static NPY_INLINE npy_uint16
+half_round_floatbits(npy_uint32 f, int *status)
 {
     npy_uint32 f_exp, f_man;
     npy_uint16 h_sgn, h_exp, h_man;
@@ -351,7 +384,7 @@ floatbits_to_halfbits(npy_uint32 f)
         } else {
             /* overflow to signed inf */
 #if HALF_GENERATE_OVERFLOW
-            generate_overflow_error();
+            *status |= HALF_FPE_OVERFLOW;
 #endif
             return (npy_uint16) (h_sgn + 0x7c00u);
         }
@@ -367,14 +400,14 @@ floatbits_to_halfbits(npy_uint32 f)
 #if HALF_GENERATE_UNDERFLOW 
             /* If f != 0, we underflowed to 0 */
             if ((f&0x7fffffff) != 0) {
-                generate_underflow_error();
+                *status |= HALF_FPE_UNDERFLOW;
             }
 #endif
             return h_sgn;
         }
         /* It underflowed to a denormalized value */
 #if HALF_GENERATE_UNDERFLOW 
-        generate_underflow_error();
+        *status |= HALF_FPE_UNDERFLOW;
 #endif
         /* Make the denormalized mantissa */
         f_exp >>= 23;
@@ -384,9 +417,11 @@ floatbits_to_halfbits(npy_uint32 f)
         /*
          * If the last bit in the half mantissa is 0 (already even), and
          * the remaining bit pattern is 1000...0, then we do not add one
-         * to the bit after the half mantissa.  In all other cases, we do.
+         * to the bit after the half mantissa.  The (113 - f_exp) shift
+         * can drop up to 11 bits, so those are checked in the original.
+         * In all other cases, we do.
          */
-        if ((f_man&0x00003fffu) != 0x00001000u) {
+        if (((f_man&0x00003fffu) != 0x00001000u) || (f&0x000007ffu)) {
             f_man += 0x00001000u;
         }
 #else
@@ -427,7 +462,7 @@ floatbits_to_halfbits(npy_uint32 f)
 #if HALF_GENERATE_OVERFLOW
     h_man += h_exp;
     if (h_man == 0x7c00u) {
-        generate_overflow_error();
+        *status |= HALF_FPE_OVERFLOW;
     }
     return h_sgn + h_man;
 #else
@@ -435,8 +470,8 @@ floatbits_to_halfbits(npy_uint32 f)
 #endif
 }
 
-npy_uint16
-doublebits_to_halfbits(npy_uint64 d)
+static NPY_INLINE npy_uint16
+half_round_doublebits(npy_uint64 d, int *status)
 {
     npy_uint64 d_exp, d_man;
     npy_uint16 h_sgn, h_exp, h_man;
@@ -467,7 +502,7 @@ doublebits_to_halfbits(npy_uint64 d)
         } else {
             /* overflow to signed inf */
 #if HALF_GENERATE_OVERFLOW
-            generate_overflow_error();
+            *status |= HALF_FPE_OVERFLOW;
 #endif
             return h_sgn + 0x7c00u;
         }
@@ -483,14 +518,14 @@ doublebits_to_halfbits(npy_uint64 d)
 #if HALF_GENERATE_UNDERFLOW 
             /* If d != 0, we underflowed to 0 */
             if ((d&0x7fffffffffffffff) != 0) {
-                generate_underflow_error();
+                *status |= HALF_FPE_UNDERFLOW;
             }
 #endif
             return h_sgn;
         }
         /* It underflowed to a denormalized value */
 #if HALF_GENERATE_UNDERFLOW 
-        generate_underflow_error();
+        *status |= HALF_FPE_UNDERFLOW;
 #endif
         /* Make the denormalized mantissa */
         d_exp >>= 52;
@@ -501,9 +536,12 @@ doublebits_to_halfbits(npy_uint64 d)
         /*
          * If the last bit in the half mantissa is 0 (already even), and
          * the remaining bit pattern is 1000...0, then we do not add one
-         * to the bit after the half mantissa.  In all other cases, we do.
+         * to the bit after the half mantissa.  The (1009 - d_exp) shift
+         * can drop up to 11 bits, so those are checked in the original.
+         * In all other cases, we do.
          */
-        if ((d_man&0x000007ffffffffffu) != 0x0000020000000000u) {
+        if (((d_man&0x000007ffffffffffu) != 0x0000020000000000u) ||
+                                            (d&0x00000000000007ffu)) {
             d_man += 0x0000020000000000u;
         }
 #else
@@ -545,7 +583,7 @@ doublebits_to_halfbits(npy_uint64 d)
 #if HALF_GENERATE_OVERFLOW
     h_man += h_exp;
     if (h_man == 0x7c00u) {
-        generate_overflow_error();
+        *status |= HALF_FPE_OVERFLOW;
     }
     return h_sgn + h_man;
 #else
@@ -553,6 +591,26 @@ doublebits_to_halfbits(npy_uint64 d)
 #endif
 }
 
+npy_uint16
+floatbits_to_halfbits(npy_uint32 f)
+{
+    int status = 0;
+    npy_uint16 h = half_round_floatbits(f, &status);
+
+    half_raise_status(status);
+    return h;
+}
+
+npy_uint16
+doublebits_to_halfbits(npy_uint64 d)
+{
+    int status = 0;
+    npy_uint16 h = half_round_doublebits(d, &status);
+
+    half_raise_status(status);
+    return h;
+}
+
 npy_uint32
 halfbits_to_floatbits(npy_uint16 h)
 {
@@ -620,3 +678,4703 @@ halfbits_to_doublebits(npy_uint16 h)
     }
 }
  
+
+
+/*
+ ********************************************************************
+ *                     BULK CONVERSIONS                             *
+ ********************************************************************
+ */
+
+/*
+ * The bulk conversions produce exactly the bits of the scalar routines
+ * above, and raise the same floating point status flags, but only once
+ * per call instead of once per element.  The SIMD kernels are compiled
+ * with per-function target attributes and selected at runtime, so the
+ * module as a whole still builds for the baseline ISA.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+        HALF_ROUND_TIES_TO_EVEN
+#define HALF_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#include <cpuid.h>
+#define HALF_TARGET(isa) __attribute__((target(isa)))
+#define HALF_SIMD_INLINE NPY_INLINE __attribute__((always_inline))
+#define HALF_TARGET_SSE2 HALF_TARGET("sse2")
+#define HALF_TARGET_AVX2 HALF_TARGET("avx2,f16c,fma")
+#define HALF_TARGET_AVX512 HALF_TARGET("avx2,f16c,fma,avx512f,avx512bw,avx512vl")
+#else
+#define HALF_HAVE_X86_SIMD 0
+#endif
+
+static int half_simd_detected = -1;
+static int half_simd_selected = -1;
+
+static int
+half_detect_simd(void)
+{
+#if HALF_HAVE_X86_SIMD
+    unsigned int eax, ebx, ecx, edx;
+    int f16c;
+
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("sse2")) {
+        return HALF_SIMD_NONE;
+    }
+    /* CPUID.1:ECX bit 29 is F16C, which older compilers cannot query */
+    f16c = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 29));
+    if (!f16c || !__builtin_cpu_supports("avx2") ||
+                 !__builtin_cpu_supports("fma")) {
+        return HALF_SIMD_SSE2;
+    }
+    if (!__builtin_cpu_supports("avx512f") ||
+            !__builtin_cpu_supports("avx512bw") ||
+            !__builtin_cpu_supports("avx512vl")) {
+        return HALF_SIMD_AVX2;
+    }
+    return HALF_SIMD_AVX512;
+#else
+    return HALF_SIMD_NONE;
+#endif
+}
+
+int
+half_simd_level(void)
+{
+    /* Racing initializations all compute the same value */
+    if (half_simd_selected < 0) {
+        if (half_simd_detected < 0) {
+            half_simd_detected = half_detect_simd();
+        }
+        half_simd_selected = half_simd_detected;
+    }
+    return half_simd_selected;
+}
+
+int
+half_set_simd_level(int level)
+{
+    if (half_simd_detected < 0) {
+        half_simd_detected = half_detect_simd();
+    }
+    if (level < 0 || level > half_simd_detected) {
+        level = half_simd_detected;
+    }
+    half_simd_selected = level;
+    return level;
+}
+
+int
+half_fpe_mode(void)
+{
+    return half_fpe_selected;
+}
+
+int
+half_set_fpe_mode(int mode)
+{
+    if (mode == HALF_FPE_RAISE || mode == HALF_FPE_IGNORE) {
+        half_fpe_selected = mode;
+    }
+    return half_fpe_selected;
+}
+
+/*
+ * The status of the flags collected by a bulk conversion.  The
+ * conditions match the ones under which the scalar routines raise them.
+ */
+static NPY_INLINE int
+half_flags_status(int overflow, int underflow)
+{
+    return (overflow ? HALF_FPE_OVERFLOW : 0) |
+           (underflow ? HALF_FPE_UNDERFLOW : 0);
+}
+
+static void
+half_raise_flags(int overflow, int underflow)
+{
+    half_raise_status(half_flags_status(overflow, underflow));
+}
+
+/*
+ * Decode tables with the float and double bits of every half (256KB and
+ * 512KB), built on first use and published with an atomic pointer swap;
+ * a thread losing the race frees its copy.  A lookup is about twice as
+ * fast as the bit manipulation, and faster than gathering into a buffer
+ * for the SSE2 kernel, but not than F16C.
+ */
+#if defined(__GNUC__)
+#define HALF_ATOMIC_LOAD(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define HALF_ATOMIC_PUBLISH(p, v) \
+    __atomic_compare_exchange_n(&(p), &half_null_table, (v), 0, \
+                                __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)
+#else
+#define HALF_ATOMIC_LOAD(p) (p)
+#define HALF_ATOMIC_PUBLISH(p, v) ((p) == NULL ? ((p) = (v), 1) : 0)
+#endif
+
+static void *half_float_table_bits = NULL;
+static void *half_double_table_bits = NULL;
+static int half_decode = HALF_DECODE_AUTO;
+
+static void *
+half_build_table(void **table, int wide)
+{
+    void *ret = HALF_ATOMIC_LOAD(*table), *half_null_table = NULL;
+    npy_uint32 i;
+
+    if (ret != NULL) {
+        return ret;
+    }
+    ret = malloc(0x10000u * (wide ? sizeof(npy_uint64) : sizeof(npy_uint32)));
+    if (ret == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < 0x10000u; i++) {
+        if (wide) {
+            ((npy_uint64 *)ret)[i] = halfbits_to_doublebits((npy_uint16)i);
+        }
+        else {
+            ((npy_uint32 *)ret)[i] = halfbits_to_floatbits((npy_uint16)i);
+        }
+    }
+    if (!HALF_ATOMIC_PUBLISH(*table, ret)) {
+        free(ret);
+        ret = HALF_ATOMIC_LOAD(*table);
+    }
+    return ret;
+}
+
+int
+half_decode_mode(void)
+{
+    return half_decode;
+}
+
+int
+half_set_decode_mode(int mode)
+{
+    if (mode != HALF_DECODE_BITS && mode != HALF_DECODE_TABLE) {
+        mode = HALF_DECODE_AUTO;
+    }
+    half_decode = mode;
+    return mode;
+}
+
+static int
+half_use_table(void)
+{
+    switch (half_decode) {
+        case HALF_DECODE_BITS:
+            return 0;
+        case HALF_DECODE_TABLE:
+            return 1;
+        default:
+            return half_simd_level() < HALF_SIMD_AVX2;
+    }
+}
+
+const npy_uint32 *
+half_float_table(void)
+{
+    if (!half_use_table()) {
+        return NULL;
+    }
+    return (const npy_uint32 *)half_build_table(&half_float_table_bits, 0);
+}
+
+const npy_uint64 *
+half_double_table(void)
+{
+    if (!half_use_table()) {
+        return NULL;
+    }
+    return (const npy_uint64 *)half_build_table(&half_double_table_bits, 1);
+}
+
+#if HALF_HAVE_X86_SIMD
+
+/*
+ * Float to half, SSE2.  Normal results are rounded with integer adds,
+ * subnormal results by adding 0.5f, whose ulp is exactly the smallest
+ * subnormal half, so the FPU does the round-to-nearest-even for us.
+ */
+static HALF_SIMD_INLINE HALF_TARGET_SSE2 __m128i
+floatbits_to_halfbits_sse2_4(__m128i f, __m128i *ovf, __m128i *unf)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a, sgn, nrm, sub, nan, big, tiny, man, ret;
+
+    a = _mm_and_si128(f, _mm_set1_epi32(0x7fffffff));
+    sgn = _mm_and_si128(_mm_srli_epi32(f, 16), _mm_set1_epi32(0x8000));
+
+    /* (a - 0x38000000 + 0xfff + odd) >> 13 */
+    nrm = _mm_and_si128(_mm_srli_epi32(a, 13), _mm_set1_epi32(1));
+    nrm = _mm_add_epi32(nrm, _mm_sub_epi32(a, _mm_set1_epi32(0x37fff001)));
+    nrm = _mm_srli_epi32(nrm, 13);
+
+    tiny = _mm_cmplt_epi32(a, _mm_set1_epi32(0x38800000));
+    big = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x477fffff));
+    nan = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x7f800000));
+
+    /* Only the tiny lanes go through the FPU, so NaNs raise nothing */
+    sub = _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(
+                _mm_and_si128(tiny, a)), _mm_set1_ps(0.5f)));
+    sub = _mm_sub_epi32(sub, _mm_set1_epi32(0x3f000000));
+
+    /* NaN keeps the top of its payload, but must stay a NaN */
+    man = _mm_srli_epi32(_mm_and_si128(a, _mm_set1_epi32(0x007fffff)), 13);
+    man = _mm_sub_epi32(man, _mm_cmpeq_epi32(man, zero));
+    man = _mm_or_si128(man, _mm_set1_epi32(0x7c00));
+
+    ret = _mm_or_si128(_mm_and_si128(tiny, sub), _mm_andnot_si128(tiny, nrm));
+    ret = _mm_or_si128(_mm_and_si128(big, _mm_set1_epi32(0x7c00)),
+                       _mm_andnot_si128(big, ret));
+    ret = _mm_or_si128(_mm_and_si128(nan, man), _mm_andnot_si128(nan, ret));
+
+    *ovf = _mm_or_si128(*ovf, _mm_and_si128(
+                _mm_cmpgt_epi32(a, _mm_set1_epi32(0x477fefff)),
+                _mm_cmplt_epi32(a, _mm_set1_epi32(0x7f800000))));
+    *unf = _mm_or_si128(*unf, _mm_andnot_si128(_mm_cmpeq_epi32(a, zero),
+                                               tiny));
+
+    /* Sign extend so the signed saturating pack keeps all 16 bits */
+    ret = _mm_or_si128(ret, sgn);
+    return _mm_srai_epi32(_mm_slli_epi32(ret, 16), 16);
+}
+
+static HALF_TARGET_SSE2 int
+floatbits_to_halfbits_sse2(const npy_uint32 *f, npy_uint16 *h, npy_intp n)
+{
+    __m128i ovf = _mm_setzero_si128(), unf = _mm_setzero_si128();
+    __m128i r0, r1;
+    npy_intp i;
+    int status;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        r0 = floatbits_to_halfbits_sse2_4(
+                    _mm_loadu_si128((const __m128i *)(f + i)), &ovf, &unf);
+        r1 = floatbits_to_halfbits_sse2_4(
+                    _mm_loadu_si128((const __m128i *)(f + i + 4)), &ovf, &unf);
+        _mm_storeu_si128((__m128i *)(h + i), _mm_packs_epi32(r0, r1));
+    }
+    status = half_flags_status(_mm_movemask_epi8(ovf),
+                               _mm_movemask_epi8(unf));
+    for (; i < n; i++) {
+        h[i] = half_round_floatbits(f[i], &status);
+    }
+    return status;
+}
+
+/*
+ * Half to float, SSE2.  Subnormal halves are made into floats with the
+ * right mantissa but an exponent one too large, and fixed up by an
+ * exact subtraction.
+ */
+static HALF_SIMD_INLINE HALF_TARGET_SSE2 __m128i
+halfbits_to_floatbits_sse2_4(__m128i h)
+{
+    __m128i o, e, infnan, sub;
+
+    o = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+    e = _mm_and_si128(o, _mm_set1_epi32(0x0f800000));
+    o = _mm_add_epi32(o, _mm_set1_epi32((127 - 15) << 23));
+
+    infnan = _mm_cmpeq_epi32(e, _mm_set1_epi32(0x0f800000));
+    o = _mm_add_epi32(o, _mm_and_si128(infnan,
+                                       _mm_set1_epi32((128 - 16) << 23)));
+
+    sub = _mm_cmpeq_epi32(e, _mm_setzero_si128());
+    e = _mm_castps_si128(_mm_sub_ps(
+                _mm_castsi128_ps(_mm_add_epi32(o, _mm_set1_epi32(1 << 23))),
+                _mm_castsi128_ps(_mm_set1_epi32(113 << 23))));
+    o = _mm_or_si128(_mm_and_si128(sub, e), _mm_andnot_si128(sub, o));
+
+    return _mm_or_si128(o, _mm_slli_epi32(
+                _mm_and_si128(h, _mm_set1_epi32(0x8000)), 16));
+}
+
+static HALF_TARGET_SSE2 void
+halfbits_to_floatbits_sse2(const npy_uint16 *h, npy_uint32 *f, npy_intp n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v;
+    npy_intp i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        v = _mm_loadu_si128((const __m128i *)(h + i));
+        _mm_storeu_si128((__m128i *)(f + i),
+                halfbits_to_floatbits_sse2_4(_mm_unpacklo_epi16(v, zero)));
+        _mm_storeu_si128((__m128i *)(f + i + 4),
+                halfbits_to_floatbits_sse2_4(_mm_unpackhi_epi16(v, zero)));
+    }
+    for (; i < n; i++) {
+        f[i] = halfbits_to_floatbits(h[i]);
+    }
+}
+
+/*
+ * Float to half, F16C.  vcvtps2ph rounds correctly, but quiets signaling
+ * NaNs, so NaN lanes are zeroed before the conversion (which also keeps
+ * FP_INVALID clear) and their payloads patched in afterwards.  The flags
+ * it sets in MXCSR are put back at the end of the call, the status comes
+ * from the integer compares like the other kernels.
+ */
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m128i
+floatbits_to_halfbits_avx2_8(__m256i x, __m256i *ovf, __m256i *unf)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i a, nan, man;
+    __m128i r, nanpatch, nanmask;
+
+    a = _mm256_and_si256(x, _mm256_set1_epi32(0x7fffffff));
+    nan = _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x7f800000));
+    r = _mm256_cvtps_ph(_mm256_castsi256_ps(_mm256_andnot_si256(nan, x)),
+                        _MM_FROUND_TO_NEAREST_INT);
+    if (!_mm256_testz_si256(nan, nan)) {
+        man = _mm256_srli_epi32(_mm256_and_si256(a,
+                                _mm256_set1_epi32(0x007fffff)), 13);
+        man = _mm256_sub_epi32(man, _mm256_cmpeq_epi32(man, zero));
+        man = _mm256_or_si256(man, _mm256_set1_epi32(0x7c00));
+        man = _mm256_or_si256(man, _mm256_and_si256(
+                    _mm256_srli_epi32(x, 16), _mm256_set1_epi32(0x8000)));
+        nanpatch = _mm256_castsi256_si128(_mm256_permute4x64_epi64(
+                    _mm256_packus_epi32(man, man), 0xd8));
+        nanmask = _mm256_castsi256_si128(_mm256_permute4x64_epi64(
+                    _mm256_packs_epi32(nan, nan), 0xd8));
+        r = _mm_blendv_epi8(r, nanpatch, nanmask);
+    }
+    *ovf = _mm256_or_si256(*ovf, _mm256_and_si256(
+                _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x477fefff)),
+                _mm256_cmpgt_epi32(_mm256_set1_epi32(0x7f800000), a)));
+    *unf = _mm256_or_si256(*unf, _mm256_andnot_si256(
+                _mm256_cmpeq_epi32(a, zero),
+                _mm256_cmpgt_epi32(_mm256_set1_epi32(0x38800000), a)));
+    return r;
+}
+
+static HALF_TARGET_AVX2 int
+floatbits_to_halfbits_avx2(const npy_uint32 *f, npy_uint16 *h, npy_intp n)
+{
+    __m256i ovf = _mm256_setzero_si256(), unf = _mm256_setzero_si256();
+    unsigned int csr = _mm_getcsr();
+    npy_intp i;
+    int status;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        _mm_storeu_si128((__m128i *)(h + i), floatbits_to_halfbits_avx2_8(
+                _mm256_loadu_si256((const __m256i *)(f + i)), &ovf, &unf));
+    }
+    _mm_setcsr(csr);
+    status = half_flags_status(!_mm256_testz_si256(ovf, ovf),
+                               !_mm256_testz_si256(unf, unf));
+    for (; i < n; i++) {
+        h[i] = half_round_floatbits(f[i], &status);
+    }
+    return status;
+}
+
+/* Half to float, F16C.  NaN lanes are patched as above. */
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m256i
+halfbits_to_floatbits_avx2_8(__m128i v)
+{
+    __m128i nan;
+    __m256i r, v32;
+
+    nan = _mm_cmpgt_epi16(_mm_and_si128(v, _mm_set1_epi16(0x7fff)),
+                          _mm_set1_epi16(0x7c00));
+    r = _mm256_castps_si256(_mm256_cvtph_ps(_mm_andnot_si128(nan, v)));
+    if (!_mm_testz_si128(nan, nan)) {
+        v32 = _mm256_cvtepu16_epi32(v);
+        v32 = _mm256_or_si256(_mm256_or_si256(
+                _mm256_slli_epi32(_mm256_and_si256(v32,
+                                _mm256_set1_epi32(0x8000)), 16),
+                _mm256_slli_epi32(_mm256_and_si256(v32,
+                                _mm256_set1_epi32(0x03ff)), 13)),
+                _mm256_set1_epi32(0x7f800000));
+        r = _mm256_blendv_epi8(r, v32, _mm256_cvtepi16_epi32(nan));
+    }
+    return r;
+}
+
+static HALF_TARGET_AVX2 void
+halfbits_to_floatbits_avx2(const npy_uint16 *h, npy_uint32 *f, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i *)(f + i), halfbits_to_floatbits_avx2_8(
+                _mm_loadu_si128((const __m128i *)(h + i))));
+    }
+    for (; i < n; i++) {
+        f[i] = halfbits_to_floatbits(h[i]);
+    }
+}
+
+/* Float to half, AVX-512.  Same scheme as the F16C kernel, 16 lanes. */
+static HALF_SIMD_INLINE HALF_TARGET_AVX512 __m256i
+floatbits_to_halfbits_avx512_16(__m512i x, __mmask16 *ovf, __mmask16 *unf)
+{
+    __mmask16 nan;
+    __m512i a, man;
+    __m256i r;
+
+    a = _mm512_and_si512(x, _mm512_set1_epi32(0x7fffffff));
+    nan = _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(0x7f800000));
+    r = _mm512_cvtps_ph(_mm512_castsi512_ps(
+                        _mm512_maskz_mov_epi32((__mmask16)~nan, x)),
+                        _MM_FROUND_TO_NEAREST_INT);
+    if (nan) {
+        man = _mm512_srli_epi32(_mm512_and_si512(a,
+                                _mm512_set1_epi32(0x007fffff)), 13);
+        man = _mm512_mask_mov_epi32(man,
+                    _mm512_cmpeq_epi32_mask(man, _mm512_setzero_si512()),
+                    _mm512_set1_epi32(1));
+        man = _mm512_or_si512(man, _mm512_set1_epi32(0x7c00));
+        man = _mm512_or_si512(man, _mm512_and_si512(
+                    _mm512_srli_epi32(x, 16), _mm512_set1_epi32(0x8000)));
+        r = _mm256_mask_mov_epi16(r, nan, _mm512_cvtepi32_epi16(man));
+    }
+    *ovf |= _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(0x477fefff)) &
+            _mm512_cmplt_epi32_mask(a, _mm512_set1_epi32(0x7f800000));
+    *unf |= _mm512_cmplt_epi32_mask(a, _mm512_set1_epi32(0x38800000)) &
+            _mm512_cmpneq_epi32_mask(a, _mm512_setzero_si512());
+    return r;
+}
+
+static HALF_TARGET_AVX512 int
+floatbits_to_halfbits_avx512(const npy_uint32 *f, npy_uint16 *h, npy_intp n)
+{
+    __mmask16 ovf = 0, unf = 0;
+    unsigned int csr = _mm_getcsr();
+    npy_intp i;
+    int status;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        _mm256_storeu_si256((__m256i *)(h + i), floatbits_to_halfbits_avx512_16(
+                _mm512_loadu_si512((const void *)(f + i)), &ovf, &unf));
+    }
+    _mm_setcsr(csr);
+    status = half_flags_status(ovf != 0, unf != 0);
+    for (; i < n; i++) {
+        h[i] = half_round_floatbits(f[i], &status);
+    }
+    return status;
+}
+
+/* Half to float, AVX-512. */
+static HALF_SIMD_INLINE HALF_TARGET_AVX512 __m512i
+halfbits_to_floatbits_avx512_16(__m256i v)
+{
+    __m512i r, v32;
+    __mmask16 nan;
+
+    nan = _mm256_cmpgt_epi16_mask(
+                _mm256_and_si256(v, _mm256_set1_epi16(0x7fff)),
+                _mm256_set1_epi16(0x7c00));
+    r = _mm512_castps_si512(_mm512_cvtph_ps(
+                _mm256_maskz_mov_epi16((__mmask16)~nan, v)));
+    if (nan) {
+        v32 = _mm512_cvtepu16_epi32(v);
+        v32 = _mm512_or_si512(_mm512_or_si512(
+                _mm512_slli_epi32(_mm512_and_si512(v32,
+                                _mm512_set1_epi32(0x8000)), 16),
+                _mm512_slli_epi32(_mm512_and_si512(v32,
+                                _mm512_set1_epi32(0x03ff)), 13)),
+                _mm512_set1_epi32(0x7f800000));
+        r = _mm512_mask_mov_epi32(r, nan, v32);
+    }
+    return r;
+}
+
+static HALF_TARGET_AVX512 void
+halfbits_to_floatbits_avx512(const npy_uint16 *h, npy_uint32 *f, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        _mm512_storeu_si512((void *)(f + i), halfbits_to_floatbits_avx512_16(
+                _mm256_loadu_si256((const __m256i *)(h + i))));
+    }
+    for (; i < n; i++) {
+        f[i] = halfbits_to_floatbits(h[i]);
+    }
+}
+
+/*
+ * Double to half.  There is no hardware conversion, and going through
+ * float would round twice, so the kernels below round directly from the
+ * double bits.  Normal results are rounded with integer adds.  Subnormal
+ * results add 2^28, whose ulp is exactly the smallest subnormal half.
+ */
+static HALF_SIMD_INLINE HALF_TARGET_SSE2 __m128i
+doublebits_to_halfbits_sse2_2(__m128i d, __m128i *ovf, __m128i *unf)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a, hi, sgn, nrm, sub, nan, big, tiny, man, ret, z;
+
+    a = _mm_and_si128(d, _mm_set1_epi64x(0x7fffffffffffffffLL));
+    sgn = _mm_and_si128(_mm_srli_epi64(d, 48), _mm_set1_epi64x(0x8000));
+
+    /*
+     * No 64-bit compares in SSE2, but every threshold has a zero low
+     * word, so comparing the high words is enough.  They are copied
+     * into both halves of each lane.
+     */
+    hi = _mm_shuffle_epi32(a, 0xf5);
+    tiny = _mm_cmplt_epi32(hi, _mm_set1_epi32(0x3f100000));
+    big = _mm_cmpgt_epi32(hi, _mm_set1_epi32(0x40efffff));
+    z = _mm_cmpeq_epi32(a, zero);
+    z = _mm_and_si128(z, _mm_shuffle_epi32(z, 0xb1));
+    nan = _mm_or_si128(_mm_cmpgt_epi32(hi, _mm_set1_epi32(0x7ff00000)),
+            _mm_andnot_si128(_mm_shuffle_epi32(_mm_cmpeq_epi32(a, zero), 0xa0),
+                         _mm_cmpeq_epi32(hi, _mm_set1_epi32(0x7ff00000))));
+
+    /* (a - 0x3f00000000000000 + 0x1ffffffffff + odd) >> 42 */
+    nrm = _mm_and_si128(_mm_srli_epi64(a, 42), _mm_set1_epi64x(1));
+    nrm = _mm_add_epi64(nrm, _mm_sub_epi64(a,
+                            _mm_set1_epi64x(0x3efffe0000000001LL)));
+    nrm = _mm_srli_epi64(nrm, 42);
+
+    sub = _mm_castpd_si128(_mm_add_pd(_mm_castsi128_pd(
+                _mm_and_si128(tiny, a)), _mm_set1_pd(268435456.0)));
+    sub = _mm_sub_epi64(sub, _mm_set1_epi64x(0x41b0000000000000LL));
+
+    man = _mm_srli_epi64(_mm_and_si128(a,
+                            _mm_set1_epi64x(0x000fffffffffffffLL)), 42);
+    man = _mm_or_si128(man, _mm_and_si128(_mm_cmpeq_epi32(man, zero),
+                                          _mm_set1_epi64x(1)));
+    man = _mm_or_si128(man, _mm_set1_epi64x(0x7c00));
+
+    ret = _mm_or_si128(_mm_and_si128(tiny, sub), _mm_andnot_si128(tiny, nrm));
+    ret = _mm_or_si128(_mm_and_si128(big, _mm_set1_epi64x(0x7c00)),
+                       _mm_andnot_si128(big, ret));
+    ret = _mm_or_si128(_mm_and_si128(nan, man), _mm_andnot_si128(nan, ret));
+
+    *ovf = _mm_or_si128(*ovf, _mm_and_si128(
+                _mm_cmpgt_epi32(hi, _mm_set1_epi32(0x40effdff)),
+                _mm_cmplt_epi32(hi, _mm_set1_epi32(0x7ff00000))));
+    *unf = _mm_or_si128(*unf, _mm_andnot_si128(z, tiny));
+
+    /* Move the two results into the low 32-bit lanes, sign extended */
+    ret = _mm_shuffle_epi32(_mm_or_si128(ret, sgn), 0x08);
+    return _mm_srai_epi32(_mm_slli_epi32(ret, 16), 16);
+}
+
+static HALF_TARGET_SSE2 int
+doublebits_to_halfbits_sse2(const npy_uint64 *d, npy_uint16 *h, npy_intp n)
+{
+    __m128i ovf = _mm_setzero_si128(), unf = _mm_setzero_si128();
+    __m128i r0, r1, r2, r3;
+    npy_intp i;
+    int status;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        r0 = doublebits_to_halfbits_sse2_2(
+                _mm_loadu_si128((const __m128i *)(d + i)), &ovf, &unf);
+        r1 = doublebits_to_halfbits_sse2_2(
+                _mm_loadu_si128((const __m128i *)(d + i + 2)), &ovf, &unf);
+        r2 = doublebits_to_halfbits_sse2_2(
+                _mm_loadu_si128((const __m128i *)(d + i + 4)), &ovf, &unf);
+        r3 = doublebits_to_halfbits_sse2_2(
+                _mm_loadu_si128((const __m128i *)(d + i + 6)), &ovf, &unf);
+        _mm_storeu_si128((__m128i *)(h + i), _mm_packs_epi32(
+                    _mm_unpacklo_epi64(r0, r1), _mm_unpacklo_epi64(r2, r3)));
+    }
+    status = half_flags_status(_mm_movemask_epi8(ovf),
+                               _mm_movemask_epi8(unf));
+    for (; i < n; i++) {
+        h[i] = half_round_doublebits(d[i], &status);
+    }
+    return status;
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m128i
+doublebits_to_halfbits_avx2_4(__m256i d, __m256i *ovf, __m256i *unf)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i a, nrm, sub, nan, big, tiny, man, ret;
+
+    a = _mm256_and_si256(d, _mm256_set1_epi64x(0x7fffffffffffffffLL));
+
+    tiny = _mm256_cmpgt_epi64(_mm256_set1_epi64x(0x3f10000000000000LL), a);
+    big = _mm256_cmpgt_epi64(a, _mm256_set1_epi64x(0x40efffffffffffffLL));
+    nan = _mm256_cmpgt_epi64(a, _mm256_set1_epi64x(0x7ff0000000000000LL));
+
+    nrm = _mm256_and_si256(_mm256_srli_epi64(a, 42), _mm256_set1_epi64x(1));
+    nrm = _mm256_add_epi64(nrm, _mm256_sub_epi64(a,
+                            _mm256_set1_epi64x(0x3efffe0000000001LL)));
+    nrm = _mm256_srli_epi64(nrm, 42);
+
+    sub = _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(
+                _mm256_and_si256(tiny, a)), _mm256_set1_pd(268435456.0)));
+    sub = _mm256_sub_epi64(sub, _mm256_set1_epi64x(0x41b0000000000000LL));
+
+    man = _mm256_srli_epi64(_mm256_and_si256(a,
+                            _mm256_set1_epi64x(0x000fffffffffffffLL)), 42);
+    man = _mm256_sub_epi64(man, _mm256_cmpeq_epi64(man, zero));
+    man = _mm256_or_si256(man, _mm256_set1_epi64x(0x7c00));
+
+    ret = _mm256_blendv_epi8(nrm, sub, tiny);
+    ret = _mm256_blendv_epi8(ret, _mm256_set1_epi64x(0x7c00), big);
+    ret = _mm256_blendv_epi8(ret, man, nan);
+    ret = _mm256_or_si256(ret, _mm256_and_si256(_mm256_srli_epi64(d, 48),
+                                        _mm256_set1_epi64x(0x8000)));
+
+    *ovf = _mm256_or_si256(*ovf, _mm256_and_si256(
+            _mm256_cmpgt_epi64(a, _mm256_set1_epi64x(0x40effdffffffffffLL)),
+            _mm256_cmpgt_epi64(_mm256_set1_epi64x(0x7ff0000000000000LL), a)));
+    *unf = _mm256_or_si256(*unf, _mm256_andnot_si256(
+                                    _mm256_cmpeq_epi64(a, zero), tiny));
+
+    /* The low 32 bits of each lane, in order */
+    return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(ret,
+                            _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+}
+
+static HALF_TARGET_AVX2 int
+doublebits_to_halfbits_avx2(const npy_uint64 *d, npy_uint16 *h, npy_intp n)
+{
+    __m256i ovf = _mm256_setzero_si256(), unf = _mm256_setzero_si256();
+    __m128i r0, r1;
+    npy_intp i;
+    int status;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        r0 = doublebits_to_halfbits_avx2_4(
+                _mm256_loadu_si256((const __m256i *)(d + i)), &ovf, &unf);
+        r1 = doublebits_to_halfbits_avx2_4(
+                _mm256_loadu_si256((const __m256i *)(d + i + 4)), &ovf, &unf);
+        _mm_storeu_si128((__m128i *)(h + i), _mm_packus_epi32(r0, r1));
+    }
+    status = half_flags_status(!_mm256_testz_si256(ovf, ovf),
+                               !_mm256_testz_si256(unf, unf));
+    for (; i < n; i++) {
+        h[i] = half_round_doublebits(d[i], &status);
+    }
+    return status;
+}
+
+static HALF_TARGET_AVX512 int
+doublebits_to_halfbits_avx512(const npy_uint64 *d, npy_uint16 *h, npy_intp n)
+{
+    __mmask8 ovf = 0, unf = 0, nan, big, tiny;
+    __m512i x, a, nrm, sub, man, ret;
+    npy_intp i;
+    int status;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        x = _mm512_loadu_si512((const void *)(d + i));
+        a = _mm512_and_si512(x, _mm512_set1_epi64(0x7fffffffffffffffLL));
+
+        tiny = _mm512_cmplt_epi64_mask(a,
+                            _mm512_set1_epi64(0x3f10000000000000LL));
+        big = _mm512_cmpge_epi64_mask(a,
+                            _mm512_set1_epi64(0x40f0000000000000LL));
+        nan = _mm512_cmpgt_epi64_mask(a,
+                            _mm512_set1_epi64(0x7ff0000000000000LL));
+
+        nrm = _mm512_and_si512(_mm512_srli_epi64(a, 42),
+                               _mm512_set1_epi64(1));
+        nrm = _mm512_add_epi64(nrm, _mm512_sub_epi64(a,
+                            _mm512_set1_epi64(0x3efffe0000000001LL)));
+        ret = _mm512_srli_epi64(nrm, 42);
+
+        if (tiny) {
+            sub = _mm512_castpd_si512(_mm512_add_pd(_mm512_castsi512_pd(
+                        _mm512_maskz_mov_epi64(tiny, a)),
+                        _mm512_set1_pd(268435456.0)));
+            sub = _mm512_sub_epi64(sub,
+                            _mm512_set1_epi64(0x41b0000000000000LL));
+            ret = _mm512_mask_mov_epi64(ret, tiny, sub);
+            unf |= tiny & _mm512_test_epi64_mask(a, a);
+        }
+        ret = _mm512_mask_mov_epi64(ret, big, _mm512_set1_epi64(0x7c00));
+        if (nan) {
+            man = _mm512_srli_epi64(_mm512_and_si512(a,
+                            _mm512_set1_epi64(0x000fffffffffffffLL)), 42);
+            man = _mm512_mask_mov_epi64(man,
+                        _mm512_cmpeq_epi64_mask(man, _mm512_setzero_si512()),
+                        _mm512_set1_epi64(1));
+            man = _mm512_or_si512(man, _mm512_set1_epi64(0x7c00));
+            ret = _mm512_mask_mov_epi64(ret, nan, man);
+        }
+        ret = _mm512_or_si512(ret, _mm512_and_si512(_mm512_srli_epi64(x, 48),
+                                        _mm512_set1_epi64(0x8000)));
+        _mm_storeu_si128((__m128i *)(h + i), _mm512_cvtepi64_epi16(ret));
+
+        ovf |= _mm512_cmpge_epi64_mask(a,
+                            _mm512_set1_epi64(0x40effe0000000000LL)) &
+               _mm512_cmplt_epi64_mask(a,
+                            _mm512_set1_epi64(0x7ff0000000000000LL));
+    }
+    status = half_flags_status(ovf != 0, unf != 0);
+    for (; i < n; i++) {
+        h[i] = half_round_doublebits(d[i], &status);
+    }
+    return status;
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+int
+floatbits_to_halfbits_status_n(const npy_uint32 *f, npy_uint16 *h, npy_intp n)
+{
+    npy_intp i;
+    int status = 0;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            return floatbits_to_halfbits_avx512(f, h, n);
+        case HALF_SIMD_AVX2:
+            return floatbits_to_halfbits_avx2(f, h, n);
+        case HALF_SIMD_SSE2:
+            return floatbits_to_halfbits_sse2(f, h, n);
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                h[i] = half_round_floatbits(f[i], &status);
+            }
+            return status;
+    }
+}
+
+void
+floatbits_to_halfbits_n(const npy_uint32 *f, npy_uint16 *h, npy_intp n)
+{
+    int status = floatbits_to_halfbits_status_n(f, h, n);
+
+    half_raise_status(status);
+}
+
+void
+halfbits_to_floatbits_n(const npy_uint16 *h, npy_uint32 *f, npy_intp n)
+{
+    const npy_uint32 *table;
+    npy_intp i;
+
+    switch (half_decode == HALF_DECODE_TABLE ? HALF_SIMD_NONE
+                                             : half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            halfbits_to_floatbits_avx512(h, f, n);
+            return;
+        case HALF_SIMD_AVX2:
+            halfbits_to_floatbits_avx2(h, f, n);
+            return;
+        case HALF_SIMD_SSE2:
+            halfbits_to_floatbits_sse2(h, f, n);
+            return;
+#endif
+        default:
+            table = half_float_table();
+            for (i = 0; i < n; i++) {
+                f[i] = table ? table[h[i]] : halfbits_to_floatbits(h[i]);
+            }
+    }
+}
+
+int
+doublebits_to_halfbits_status_n(const npy_uint64 *d, npy_uint16 *h, npy_intp n)
+{
+    npy_intp i;
+    int status = 0;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            return doublebits_to_halfbits_avx512(d, h, n);
+        case HALF_SIMD_AVX2:
+            return doublebits_to_halfbits_avx2(d, h, n);
+        case HALF_SIMD_SSE2:
+            return doublebits_to_halfbits_sse2(d, h, n);
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                h[i] = half_round_doublebits(d[i], &status);
+            }
+            return status;
+    }
+}
+
+void
+doublebits_to_halfbits_n(const npy_uint64 *d, npy_uint16 *h, npy_intp n)
+{
+    int status = doublebits_to_halfbits_status_n(d, h, n);
+
+    half_raise_status(status);
+}
+
+#if HALF_HAVE_X86_SIMD
+
+/*
+ * Half to double, F16C.  Groups of halves holding a NaN are done with the
+ * scalar routine, as vcvtph2ps and vcvtps2pd quiet signaling NaNs.
+ */
+static HALF_TARGET_AVX2 void
+halfbits_to_doublebits_avx2(const npy_uint16 *h, npy_uint64 *d, npy_intp n)
+{
+    __m128i v, nan;
+    __m256 f;
+    npy_intp i, j;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        v = _mm_loadu_si128((const __m128i *)(h + i));
+        nan = _mm_cmpgt_epi16(_mm_and_si128(v, _mm_set1_epi16(0x7fff)),
+                              _mm_set1_epi16(0x7c00));
+        if (!_mm_testz_si128(nan, nan)) {
+            for (j = i; j < i + 8; j++) {
+                d[j] = halfbits_to_doublebits(h[j]);
+            }
+            continue;
+        }
+        f = _mm256_cvtph_ps(v);
+        _mm256_storeu_pd((double *)(d + i),
+                         _mm256_cvtps_pd(_mm256_castps256_ps128(f)));
+        _mm256_storeu_pd((double *)(d + i + 4),
+                         _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)));
+    }
+    for (; i < n; i++) {
+        d[i] = halfbits_to_doublebits(h[i]);
+    }
+}
+
+static HALF_TARGET_AVX512 void
+halfbits_to_doublebits_avx512(const npy_uint16 *h, npy_uint64 *d, npy_intp n)
+{
+    __m256i v;
+    __m512 f;
+    npy_intp i, j;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        v = _mm256_loadu_si256((const __m256i *)(h + i));
+        if (_mm256_cmpgt_epi16_mask(_mm256_and_si256(v,
+                            _mm256_set1_epi16(0x7fff)),
+                        _mm256_set1_epi16(0x7c00))) {
+            for (j = i; j < i + 16; j++) {
+                d[j] = halfbits_to_doublebits(h[j]);
+            }
+            continue;
+        }
+        f = _mm512_cvtph_ps(v);
+        _mm512_storeu_pd((void *)(d + i),
+                         _mm512_cvtps_pd(_mm512_castps512_ps256(f)));
+        _mm512_storeu_pd((void *)(d + i + 8), _mm512_cvtps_pd(
+                    _mm256_castpd_ps(_mm512_extractf64x4_pd(
+                            _mm512_castps_pd(f), 1))));
+    }
+    for (; i < n; i++) {
+        d[i] = halfbits_to_doublebits(h[i]);
+    }
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+void
+halfbits_to_doublebits_n(const npy_uint16 *h, npy_uint64 *d, npy_intp n)
+{
+    const npy_uint64 *table;
+    npy_intp i;
+
+    switch (half_decode == HALF_DECODE_TABLE ? HALF_SIMD_NONE
+                                             : half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            halfbits_to_doublebits_avx512(h, d, n);
+            return;
+        case HALF_SIMD_AVX2:
+            halfbits_to_doublebits_avx2(h, d, n);
+            return;
+#endif
+        default:
+            table = half_double_table();
+            for (i = 0; i < n; i++) {
+                d[i] = table ? table[h[i]] : halfbits_to_doublebits(h[i]);
+            }
+    }
+}
+
+
+/*
+ ********************************************************************
+ *                 DIRECTED AND STOCHASTIC ROUNDING                 *
+ ********************************************************************
+ */
+
+/*
+ * Float to half rounding toward zero or stochastically.  x is the value
+ * in units of 2^-s of the result: the float bits rebased to the half
+ * exponent with s = 13 for normal results, the significand with
+ * s = 126 - exponent for subnormal ones.  The s bits shifted out, as a
+ * 32-bit fraction, decide the rounding: stochastic rounding rounds up
+ * when the fraction exceeds the random bits rnd, so with a probability
+ * equal to it.  Toward zero, values above the largest finite half give
+ * the largest finite half.  mode is a constant wherever this is inlined,
+ * so each mode compiles to its own loop.
+ */
+static NPY_INLINE npy_uint16
+half_round_floatbits_mode(npy_uint32 f, int mode, npy_uint32 rnd,
+                          int *status)
+{
+    npy_uint32 a = f&0x7fffffffu, x, h, frac;
+    npy_uint16 h_sgn = (npy_uint16) ((f&0x80000000u) >> 16);
+    int s;
+
+    if (a >= 0x7f800000u) {
+        /* inf and NaN are not rounded */
+        return half_round_floatbits(f, status);
+    }
+    if (a >= 0x38800000u) {
+        x = a - 0x38000000u;
+        s = 13;
+    }
+    else {
+#if HALF_GENERATE_UNDERFLOW
+        if (a != 0) {
+            *status |= HALF_FPE_UNDERFLOW;
+        }
+#endif
+        /* Float subnormals have the exponent of 1, without the hidden bit */
+        if ((a >> 23) != 0) {
+            x = (a&0x007fffffu) + 0x00800000u;
+            s = 126 - (int)(a >> 23);
+        }
+        else {
+            x = a;
+            s = 125;
+        }
+    }
+    h = s < 32 ? x >> s : 0;
+    frac = s <= 32 ? x << (32 - s) : (s < 64 ? x >> (s - 32) : 0);
+    if (mode == HALF_ROUNDING_STOCHASTIC && frac > rnd) {
+        h++;
+    }
+    if (h >= 0x7c00u) {
+#if HALF_GENERATE_OVERFLOW
+        *status |= HALF_FPE_OVERFLOW;
+#endif
+        h = mode == HALF_ROUNDING_TOWARD_ZERO ? 0x7bffu : 0x7c00u;
+    }
+    return (npy_uint16) (h_sgn + h);
+}
+
+/* Double to half, as above with s = 42 for normal results */
+static NPY_INLINE npy_uint16
+half_round_doublebits_mode(npy_uint64 d, int mode, npy_uint32 rnd,
+                           int *status)
+{
+    npy_uint64 a = d&0x7fffffffffffffffu, x, h, frac;
+    npy_uint16 h_sgn = (npy_uint16) ((d&0x8000000000000000u) >> 48);
+    int s;
+
+    if (a >= 0x7ff0000000000000u) {
+        return half_round_doublebits(d, status);
+    }
+    if (a >= 0x3f10000000000000u) {
+        x = a - 0x3f00000000000000u;
+        s = 42;
+    }
+    else {
+#if HALF_GENERATE_UNDERFLOW
+        if (a != 0) {
+            *status |= HALF_FPE_UNDERFLOW;
+        }
+#endif
+        if ((a >> 52) != 0) {
+            x = (a&0x000fffffffffffffu) + 0x0010000000000000u;
+            s = 1051 - (int)(a >> 52);
+        }
+        else {
+            x = a;
+            s = 1050;
+        }
+    }
+    h = s < 64 ? x >> s : 0;
+    frac = s <= 64 ? x << (64 - s) : (s < 128 ? x >> (s - 64) : 0);
+    if (mode == HALF_ROUNDING_STOCHASTIC && (npy_uint32)(frac >> 32) > rnd) {
+        h++;
+    }
+    if (h >= 0x7c00u) {
+#if HALF_GENERATE_OVERFLOW
+        *status |= HALF_FPE_OVERFLOW;
+#endif
+        h = mode == HALF_ROUNDING_TOWARD_ZERO ? 0x7bffu : 0x7c00u;
+    }
+    return (npy_uint16) (h_sgn + h);
+}
+
+/*
+ * The random bits for stochastic rounding come from a counter based
+ * generator: counter c gives two rounds of the lowbias32 integer hash
+ * (by Chris Wellons) of its low word, under a key made from the seed and
+ * its high word.  Any element's bits are computed without the ones
+ * before it, so they depend on neither the SIMD level nor on how a
+ * conversion is split into calls or threads.
+ */
+static NPY_INLINE npy_uint32
+half_hash32(npy_uint32 x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static NPY_INLINE npy_uint32
+half_random_bits(npy_uint32 c, npy_uint32 k0, npy_uint32 k1)
+{
+    return half_hash32(half_hash32(c + k0) ^ k1);
+}
+
+static void
+half_random_key(npy_uint64 seed, npy_uint64 c, npy_uint32 *k0,
+                npy_uint32 *k1)
+{
+    *k0 = half_hash32((npy_uint32)seed + 0x9e3779b9u);
+    *k1 = half_hash32(*k0 ^ half_hash32((npy_uint32)(seed >> 32) +
+                        half_hash32((npy_uint32)(c >> 32) + 0x7f4a7c15u)));
+}
+
+static NPY_INLINE int
+floatbits_to_halfbits_mode_loop(const npy_uint32 *f, npy_uint16 *h,
+                                npy_intp n, int mode, npy_uint32 c,
+                                npy_uint32 k0, npy_uint32 k1)
+{
+    npy_intp i;
+    int status = 0;
+
+    for (i = 0; i < n; i++) {
+        h[i] = half_round_floatbits_mode(f[i], mode,
+                    mode == HALF_ROUNDING_STOCHASTIC ?
+                    half_random_bits(c + (npy_uint32)i, k0, k1) : 0, &status);
+    }
+    return status;
+}
+
+static NPY_INLINE int
+doublebits_to_halfbits_mode_loop(const npy_uint64 *d, npy_uint16 *h,
+                                 npy_intp n, int mode, npy_uint32 c,
+                                 npy_uint32 k0, npy_uint32 k1)
+{
+    npy_intp i;
+    int status = 0;
+
+    for (i = 0; i < n; i++) {
+        h[i] = half_round_doublebits_mode(d[i], mode,
+                    mode == HALF_ROUNDING_STOCHASTIC ?
+                    half_random_bits(c + (npy_uint32)i, k0, k1) : 0, &status);
+    }
+    return status;
+}
+
+#if HALF_HAVE_X86_SIMD
+
+/*
+ * The SIMD kernels compute x and s per lane as above and round with
+ * variable shifts, which give 0 for counts of the lane width or more
+ * (negative counts included), so both shifts making up the fraction
+ * can be done unconditionally.  There are no SSE2 kernels, which lack
+ * the variable shifts and 32-bit multiplies; that level uses the
+ * scalar loops.
+ */
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m256i
+half_hash32_avx2(__m256i x)
+{
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32(0x7feb352d));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x846ca68bu));
+    return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+}
+
+/* The random bits of the 8 counters from c */
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m256i
+half_random_bits_avx2(npy_uint32 c, npy_uint32 k0, npy_uint32 k1)
+{
+    __m256i x = _mm256_add_epi32(_mm256_set1_epi32((int)(c + k0)),
+                                 _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+    return half_hash32_avx2(_mm256_xor_si256(half_hash32_avx2(x),
+                                             _mm256_set1_epi32((int)k1)));
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m128i
+floatbits_to_halfbits_mode_avx2_8(__m256i f, int mode, __m256i rnd,
+                                  __m256i *ovf, __m256i *unf)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i sbit = _mm256_set1_epi32((int)0x80000000u);
+    __m256i a, e, tiny, x, s, h, frac, over, inf, nan, man;
+
+    a = _mm256_and_si256(f, _mm256_set1_epi32(0x7fffffff));
+    e = _mm256_srli_epi32(a, 23);
+    tiny = _mm256_cmpgt_epi32(_mm256_set1_epi32(0x38800000), a);
+    x = _mm256_or_si256(_mm256_and_si256(a, _mm256_set1_epi32(0x007fffff)),
+            _mm256_andnot_si256(_mm256_cmpeq_epi32(e, zero),
+                                _mm256_set1_epi32(0x00800000)));
+    x = _mm256_blendv_epi8(_mm256_sub_epi32(a, _mm256_set1_epi32(0x38000000)),
+                           x, tiny);
+    s = _mm256_sub_epi32(_mm256_set1_epi32(126),
+                         _mm256_max_epu32(e, _mm256_set1_epi32(1)));
+    s = _mm256_blendv_epi8(_mm256_set1_epi32(13), s, tiny);
+
+    h = _mm256_srlv_epi32(x, s);
+    if (mode == HALF_ROUNDING_STOCHASTIC) {
+        frac = _mm256_or_si256(
+                _mm256_sllv_epi32(x, _mm256_sub_epi32(_mm256_set1_epi32(32), s)),
+                _mm256_srlv_epi32(x, _mm256_sub_epi32(s, _mm256_set1_epi32(32))));
+        /* Unsigned frac > rnd, subtracting the mask adds one */
+        h = _mm256_sub_epi32(h, _mm256_cmpgt_epi32(
+                _mm256_xor_si256(frac, sbit), _mm256_xor_si256(rnd, sbit)));
+    }
+    over = _mm256_cmpgt_epi32(h, _mm256_set1_epi32(0x7bff));
+    h = _mm256_min_epu32(h, _mm256_set1_epi32(
+                mode == HALF_ROUNDING_TOWARD_ZERO ? 0x7bff : 0x7c00));
+
+    inf = _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x7f7fffff));
+    nan = _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x7f800000));
+    man = _mm256_srli_epi32(_mm256_and_si256(a,
+                            _mm256_set1_epi32(0x007fffff)), 13);
+    man = _mm256_sub_epi32(man, _mm256_and_si256(nan,
+                            _mm256_cmpeq_epi32(man, zero)));
+    h = _mm256_blendv_epi8(h, _mm256_or_si256(man,
+                            _mm256_set1_epi32(0x7c00)), inf);
+    h = _mm256_or_si256(h, _mm256_and_si256(_mm256_srli_epi32(f, 16),
+                                            _mm256_set1_epi32(0x8000)));
+
+    *ovf = _mm256_or_si256(*ovf, _mm256_andnot_si256(inf, over));
+    *unf = _mm256_or_si256(*unf, _mm256_andnot_si256(
+                                    _mm256_cmpeq_epi32(a, zero), tiny));
+    return _mm256_castsi256_si128(_mm256_permute4x64_epi64(
+                                    _mm256_packus_epi32(h, h), 0xd8));
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 int
+floatbits_to_halfbits_mode_avx2_loop(const npy_uint32 *f, npy_uint16 *h,
+                                     npy_intp n, int mode, npy_uint32 c,
+                                     npy_uint32 k0, npy_uint32 k1)
+{
+    __m256i ovf = _mm256_setzero_si256(), unf = _mm256_setzero_si256();
+    __m256i rnd = _mm256_setzero_si256();
+    npy_intp i;
+    int status;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        if (mode == HALF_ROUNDING_STOCHASTIC) {
+            rnd = half_random_bits_avx2(c + (npy_uint32)i, k0, k1);
+        }
+        _mm_storeu_si128((__m128i *)(h + i), floatbits_to_halfbits_mode_avx2_8(
+                _mm256_loadu_si256((const __m256i *)(f + i)), mode, rnd,
+                &ovf, &unf));
+    }
+    status = half_flags_status(!_mm256_testz_si256(ovf, ovf),
+                               !_mm256_testz_si256(unf, unf));
+    return status | floatbits_to_halfbits_mode_loop(f + i, h + i, n - i,
+                                    mode, c + (npy_uint32)i, k0, k1);
+}
+
+static HALF_TARGET_AVX2 int
+floatbits_to_halfbits_mode_avx2(const npy_uint32 *f, npy_uint16 *h,
+                                npy_intp n, int mode, npy_uint32 c,
+                                npy_uint32 k0, npy_uint32 k1)
+{
+    if (mode == HALF_ROUNDING_STOCHASTIC) {
+        return floatbits_to_halfbits_mode_avx2_loop(f, h, n,
+                                    HALF_ROUNDING_STOCHASTIC, c, k0, k1);
+    }
+    return floatbits_to_halfbits_mode_avx2_loop(f, h, n,
+                                    HALF_ROUNDING_TOWARD_ZERO, c, k0, k1);
+}
+
+/* rnd holds the random bits zero extended to 64 bits */
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m128i
+doublebits_to_halfbits_mode_avx2_4(__m256i d, int mode, __m256i rnd,
+                                   __m256i *ovf, __m256i *unf)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i a, e, tiny, x, s, h, frac, over, inf, nan, man;
+
+    a = _mm256_and_si256(d, _mm256_set1_epi64x(0x7fffffffffffffffLL));
+    e = _mm256_srli_epi64(a, 52);
+    tiny = _mm256_cmpgt_epi64(_mm256_set1_epi64x(0x3f10000000000000LL), a);
+    x = _mm256_or_si256(_mm256_and_si256(a,
+                            _mm256_set1_epi64x(0x000fffffffffffffLL)),
+            _mm256_andnot_si256(_mm256_cmpeq_epi64(e, zero),
+                            _mm256_set1_epi64x(0x0010000000000000LL)));
+    x = _mm256_blendv_epi8(_mm256_sub_epi64(a,
+                            _mm256_set1_epi64x(0x3f00000000000000LL)), x, tiny);
+    /* 1051 - e, or 1050 for a zero exponent */
+    s = _mm256_add_epi64(_mm256_sub_epi64(_mm256_set1_epi64x(1051), e),
+                         _mm256_cmpeq_epi64(e, zero));
+    s = _mm256_blendv_epi8(_mm256_set1_epi64x(42), s, tiny);
+
+    h = _mm256_srlv_epi64(x, s);
+    if (mode == HALF_ROUNDING_STOCHASTIC) {
+        frac = _mm256_or_si256(
+            _mm256_sllv_epi64(x, _mm256_sub_epi64(_mm256_set1_epi64x(64), s)),
+            _mm256_srlv_epi64(x, _mm256_sub_epi64(s, _mm256_set1_epi64x(64))));
+        h = _mm256_sub_epi64(h, _mm256_cmpgt_epi64(
+                                    _mm256_srli_epi64(frac, 32), rnd));
+    }
+    over = _mm256_cmpgt_epi64(h, _mm256_set1_epi64x(0x7bff));
+    h = _mm256_blendv_epi8(h, _mm256_set1_epi64x(
+                mode == HALF_ROUNDING_TOWARD_ZERO ? 0x7bff : 0x7c00), over);
+
+    inf = _mm256_cmpgt_epi64(a, _mm256_set1_epi64x(0x7fefffffffffffffLL));
+    nan = _mm256_cmpgt_epi64(a, _mm256_set1_epi64x(0x7ff0000000000000LL));
+    man = _mm256_srli_epi64(_mm256_and_si256(a,
+                            _mm256_set1_epi64x(0x000fffffffffffffLL)), 42);
+    man = _mm256_sub_epi64(man, _mm256_and_si256(nan,
+                            _mm256_cmpeq_epi64(man, zero)));
+    h = _mm256_blendv_epi8(h, _mm256_or_si256(man,
+                            _mm256_set1_epi64x(0x7c00)), inf);
+    h = _mm256_or_si256(h, _mm256_and_si256(_mm256_srli_epi64(d, 48),
+                                            _mm256_set1_epi64x(0x8000)));
+
+    *ovf = _mm256_or_si256(*ovf, _mm256_andnot_si256(inf, over));
+    *unf = _mm256_or_si256(*unf, _mm256_andnot_si256(
+                                    _mm256_cmpeq_epi64(a, zero), tiny));
+    return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(h,
+                            _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 int
+doublebits_to_halfbits_mode_avx2_loop(const npy_uint64 *d, npy_uint16 *h,
+                                      npy_intp n, int mode, npy_uint32 c,
+                                      npy_uint32 k0, npy_uint32 k1)
+{
+    __m256i ovf = _mm256_setzero_si256(), unf = _mm256_setzero_si256();
+    __m256i rnd = _mm256_setzero_si256();
+    __m128i r0, r1;
+    npy_intp i;
+    int status;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        if (mode == HALF_ROUNDING_STOCHASTIC) {
+            rnd = half_random_bits_avx2(c + (npy_uint32)i, k0, k1);
+        }
+        r0 = doublebits_to_halfbits_mode_avx2_4(
+                _mm256_loadu_si256((const __m256i *)(d + i)), mode,
+                _mm256_cvtepu32_epi64(_mm256_castsi256_si128(rnd)),
+                &ovf, &unf);
+        r1 = doublebits_to_halfbits_mode_avx2_4(
+                _mm256_loadu_si256((const __m256i *)(d + i + 4)), mode,
+                _mm256_cvtepu32_epi64(_mm256_extracti128_si256(rnd, 1)),
+                &ovf, &unf);
+        _mm_storeu_si128((__m128i *)(h + i), _mm_packus_epi32(r0, r1));
+    }
+    status = half_flags_status(!_mm256_testz_si256(ovf, ovf),
+                               !_mm256_testz_si256(unf, unf));
+    return status | doublebits_to_halfbits_mode_loop(d + i, h + i, n - i,
+                                    mode, c + (npy_uint32)i, k0, k1);
+}
+
+static HALF_TARGET_AVX2 int
+doublebits_to_halfbits_mode_avx2(const npy_uint64 *d, npy_uint16 *h,
+                                 npy_intp n, int mode, npy_uint32 c,
+                                 npy_uint32 k0, npy_uint32 k1)
+{
+    if (mode == HALF_ROUNDING_STOCHASTIC) {
+        return doublebits_to_halfbits_mode_avx2_loop(d, h, n,
+                                    HALF_ROUNDING_STOCHASTIC, c, k0, k1);
+    }
+    return doublebits_to_halfbits_mode_avx2_loop(d, h, n,
+                                    HALF_ROUNDING_TOWARD_ZERO, c, k0, k1);
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX512 __m512i
+half_hash32_avx512(__m512i x)
+{
+    x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 16));
+    x = _mm512_mullo_epi32(x, _mm512_set1_epi32(0x7feb352d));
+    x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 15));
+    x = _mm512_mullo_epi32(x, _mm512_set1_epi32((int)0x846ca68bu));
+    return _mm512_xor_si512(x, _mm512_srli_epi32(x, 16));
+}
+
+/* The random bits of the 16 counters from c */
+static HALF_SIMD_INLINE HALF_TARGET_AVX512 __m512i
+half_random_bits_avx512(npy_uint32 c, npy_uint32 k0, npy_uint32 k1)
+{
+    __m512i x = _mm512_add_epi32(_mm512_set1_epi32((int)(c + k0)),
+                    _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                      8, 9, 10, 11, 12, 13, 14, 15));
+
+    return half_hash32_avx512(_mm512_xor_si512(half_hash32_avx512(x),
+                                               _mm512_set1_epi32((int)k1)));
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX512 __m256i
+floatbits_to_halfbits_mode_avx512_16(__m512i f, int mode, __m512i rnd,
+                                     __mmask16 *ovf, __mmask16 *unf)
+{
+    __m512i a, e, x, s, h, frac, man;
+    __mmask16 tiny, over, inf, nan;
+
+    a = _mm512_and_si512(f, _mm512_set1_epi32(0x7fffffff));
+    e = _mm512_srli_epi32(a, 23);
+    tiny = _mm512_cmplt_epi32_mask(a, _mm512_set1_epi32(0x38800000));
+    x = _mm512_or_si512(_mm512_and_si512(a, _mm512_set1_epi32(0x007fffff)),
+            _mm512_maskz_mov_epi32(_mm512_test_epi32_mask(e, e),
+                                   _mm512_set1_epi32(0x00800000)));
+    x = _mm512_mask_mov_epi32(_mm512_sub_epi32(a,
+                            _mm512_set1_epi32(0x38000000)), tiny, x);
+    s = _mm512_sub_epi32(_mm512_set1_epi32(126),
+                         _mm512_max_epu32(e, _mm512_set1_epi32(1)));
+    s = _mm512_mask_mov_epi32(_mm512_set1_epi32(13), tiny, s);
+
+    h = _mm512_srlv_epi32(x, s);
+    if (mode == HALF_ROUNDING_STOCHASTIC) {
+        frac = _mm512_or_si512(
+                _mm512_sllv_epi32(x, _mm512_sub_epi32(_mm512_set1_epi32(32), s)),
+                _mm512_srlv_epi32(x, _mm512_sub_epi32(s, _mm512_set1_epi32(32))));
+        h = _mm512_mask_add_epi32(h, _mm512_cmpgt_epu32_mask(frac, rnd),
+                                  h, _mm512_set1_epi32(1));
+    }
+    over = _mm512_cmpgt_epi32_mask(h, _mm512_set1_epi32(0x7bff));
+    h = _mm512_min_epu32(h, _mm512_set1_epi32(
+                mode == HALF_ROUNDING_TOWARD_ZERO ? 0x7bff : 0x7c00));
+
+    inf = _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(0x7f7fffff));
+    if (inf) {
+        nan = _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(0x7f800000));
+        man = _mm512_srli_epi32(_mm512_and_si512(a,
+                                _mm512_set1_epi32(0x007fffff)), 13);
+        man = _mm512_mask_mov_epi32(man, nan & _mm512_cmpeq_epi32_mask(man,
+                                _mm512_setzero_si512()), _mm512_set1_epi32(1));
+        h = _mm512_mask_mov_epi32(h, inf, _mm512_or_si512(man,
+                                _mm512_set1_epi32(0x7c00)));
+    }
+    h = _mm512_or_si512(h, _mm512_and_si512(_mm512_srli_epi32(f, 16),
+                                            _mm512_set1_epi32(0x8000)));
+
+    *ovf |= over & ~inf;
+    *unf |= tiny & _mm512_test_epi32_mask(a, a);
+    return _mm512_cvtepi32_epi16(h);
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX512 int
+floatbits_to_halfbits_mode_avx512_loop(const npy_uint32 *f, npy_uint16 *h,
+                                       npy_intp n, int mode, npy_uint32 c,
+                                       npy_uint32 k0, npy_uint32 k1)
+{
+    __mmask16 ovf = 0, unf = 0;
+    __m512i rnd = _mm512_setzero_si512();
+    npy_intp i;
+    int status;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        if (mode == HALF_ROUNDING_STOCHASTIC) {
+            rnd = half_random_bits_avx512(c + (npy_uint32)i, k0, k1);
+        }
+        _mm256_storeu_si256((__m256i *)(h + i),
+                floatbits_to_halfbits_mode_avx512_16(
+                    _mm512_loadu_si512((const void *)(f + i)), mode, rnd,
+                    &ovf, &unf));
+    }
+    status = half_flags_status(ovf != 0, unf != 0);
+    return status | floatbits_to_halfbits_mode_loop(f + i, h + i, n - i,
+                                    mode, c + (npy_uint32)i, k0, k1);
+}
+
+static HALF_TARGET_AVX512 int
+floatbits_to_halfbits_mode_avx512(const npy_uint32 *f, npy_uint16 *h,
+                                  npy_intp n, int mode, npy_uint32 c,
+                                  npy_uint32 k0, npy_uint32 k1)
+{
+    if (mode == HALF_ROUNDING_STOCHASTIC) {
+        return floatbits_to_halfbits_mode_avx512_loop(f, h, n,
+                                    HALF_ROUNDING_STOCHASTIC, c, k0, k1);
+    }
+    return floatbits_to_halfbits_mode_avx512_loop(f, h, n,
+                                    HALF_ROUNDING_TOWARD_ZERO, c, k0, k1);
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX512 __m128i
+doublebits_to_halfbits_mode_avx512_8(__m512i d, int mode, __m512i rnd,
+                                     __mmask8 *ovf, __mmask8 *unf)
+{
+    __m512i a, e, x, s, h, frac, man;
+    __mmask8 tiny, over, inf, nan;
+
+    a = _mm512_and_si512(d, _mm512_set1_epi64(0x7fffffffffffffffLL));
+    e = _mm512_srli_epi64(a, 52);
+    tiny = _mm512_cmplt_epi64_mask(a,
+                            _mm512_set1_epi64(0x3f10000000000000LL));
+    x = _mm512_or_si512(_mm512_and_si512(a,
+                            _mm512_set1_epi64(0x000fffffffffffffLL)),
+            _mm512_maskz_mov_epi64(_mm512_test_epi64_mask(e, e),
+                            _mm512_set1_epi64(0x0010000000000000LL)));
+    x = _mm512_mask_mov_epi64(_mm512_sub_epi64(a,
+                            _mm512_set1_epi64(0x3f00000000000000LL)), tiny, x);
+    s = _mm512_sub_epi64(_mm512_set1_epi64(1051),
+                         _mm512_max_epu64(e, _mm512_set1_epi64(1)));
+    s = _mm512_mask_mov_epi64(_mm512_set1_epi64(42), tiny, s);
+
+    h = _mm512_srlv_epi64(x, s);
+    if (mode == HALF_ROUNDING_STOCHASTIC) {
+        frac = _mm512_or_si512(
+                _mm512_sllv_epi64(x, _mm512_sub_epi64(_mm512_set1_epi64(64), s)),
+                _mm512_srlv_epi64(x, _mm512_sub_epi64(s, _mm512_set1_epi64(64))));
+        h = _mm512_mask_add_epi64(h, _mm512_cmpgt_epu64_mask(
+                        _mm512_srli_epi64(frac, 32), rnd),
+                        h, _mm512_set1_epi64(1));
+    }
+    over = _mm512_cmpgt_epi64_mask(h, _mm512_set1_epi64(0x7bff));
+    h = _mm512_min_epu64(h, _mm512_set1_epi64(
+                mode == HALF_ROUNDING_TOWARD_ZERO ? 0x7bff : 0x7c00));
+
+    inf = _mm512_cmpgt_epi64_mask(a,
+                            _mm512_set1_epi64(0x7fefffffffffffffLL));
+    if (inf) {
+        nan = _mm512_cmpgt_epi64_mask(a,
+                            _mm512_set1_epi64(0x7ff0000000000000LL));
+        man = _mm512_srli_epi64(_mm512_and_si512(a,
+                            _mm512_set1_epi64(0x000fffffffffffffLL)), 42);
+        man = _mm512_mask_mov_epi64(man, nan & _mm512_cmpeq_epi64_mask(man,
+                            _mm512_setzero_si512()), _mm512_set1_epi64(1));
+        h = _mm512_mask_mov_epi64(h, inf, _mm512_or_si512(man,
+                            _mm512_set1_epi64(0x7c00)));
+    }
+    h = _mm512_or_si512(h, _mm512_and_si512(_mm512_srli_epi64(d, 48),
+                                            _mm512_set1_epi64(0x8000)));
+
+    *ovf |= over & ~inf;
+    *unf |= tiny & _mm512_test_epi64_mask(a, a);
+    return _mm512_cvtepi64_epi16(h);
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX512 int
+doublebits_to_halfbits_mode_avx512_loop(const npy_uint64 *d, npy_uint16 *h,
+                                        npy_intp n, int mode, npy_uint32 c,
+                                        npy_uint32 k0, npy_uint32 k1)
+{
+    __mmask8 ovf = 0, unf = 0;
+    __m512i rnd = _mm512_setzero_si512();
+    npy_intp i;
+    int status;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        if (mode == HALF_ROUNDING_STOCHASTIC) {
+            rnd = _mm512_cvtepu32_epi64(half_random_bits_avx2(
+                                        c + (npy_uint32)i, k0, k1));
+        }
+        _mm_storeu_si128((__m128i *)(h + i),
+                doublebits_to_halfbits_mode_avx512_8(
+                    _mm512_loadu_si512((const void *)(d + i)), mode, rnd,
+                    &ovf, &unf));
+    }
+    status = half_flags_status(ovf != 0, unf != 0);
+    return status | doublebits_to_halfbits_mode_loop(d + i, h + i, n - i,
+                                    mode, c + (npy_uint32)i, k0, k1);
+}
+
+static HALF_TARGET_AVX512 int
+doublebits_to_halfbits_mode_avx512(const npy_uint64 *d, npy_uint16 *h,
+                                   npy_intp n, int mode, npy_uint32 c,
+                                   npy_uint32 k0, npy_uint32 k1)
+{
+    if (mode == HALF_ROUNDING_STOCHASTIC) {
+        return doublebits_to_halfbits_mode_avx512_loop(d, h, n,
+                                    HALF_ROUNDING_STOCHASTIC, c, k0, k1);
+    }
+    return doublebits_to_halfbits_mode_avx512_loop(d, h, n,
+                                    HALF_ROUNDING_TOWARD_ZERO, c, k0, k1);
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+/* Converts n values whose counters c + i share their high word */
+static int
+floatbits_to_halfbits_mode_n(const npy_uint32 *f, npy_uint16 *h, npy_intp n,
+                             int mode, npy_uint32 c, npy_uint32 k0,
+                             npy_uint32 k1)
+{
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            return floatbits_to_halfbits_mode_avx512(f, h, n, mode, c, k0, k1);
+        case HALF_SIMD_AVX2:
+            return floatbits_to_halfbits_mode_avx2(f, h, n, mode, c, k0, k1);
+#endif
+        default:
+            if (mode == HALF_ROUNDING_STOCHASTIC) {
+                return floatbits_to_halfbits_mode_loop(f, h, n,
+                                    HALF_ROUNDING_STOCHASTIC, c, k0, k1);
+            }
+            return floatbits_to_halfbits_mode_loop(f, h, n,
+                                    HALF_ROUNDING_TOWARD_ZERO, c, k0, k1);
+    }
+}
+
+static int
+doublebits_to_halfbits_mode_n(const npy_uint64 *d, npy_uint16 *h, npy_intp n,
+                              int mode, npy_uint32 c, npy_uint32 k0,
+                              npy_uint32 k1)
+{
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            return doublebits_to_halfbits_mode_avx512(d, h, n, mode, c, k0, k1);
+        case HALF_SIMD_AVX2:
+            return doublebits_to_halfbits_mode_avx2(d, h, n, mode, c, k0, k1);
+#endif
+        default:
+            if (mode == HALF_ROUNDING_STOCHASTIC) {
+                return doublebits_to_halfbits_mode_loop(d, h, n,
+                                    HALF_ROUNDING_STOCHASTIC, c, k0, k1);
+            }
+            return doublebits_to_halfbits_mode_loop(d, h, n,
+                                    HALF_ROUNDING_TOWARD_ZERO, c, k0, k1);
+    }
+}
+
+/*
+ * Rounding to nearest even goes to the kernels above unchanged.  The
+ * other modes are split where the high word of the counter changes,
+ * which changes the key.
+ */
+void
+floatbits_to_halfbits_round_n(const npy_uint32 *f, npy_uint16 *h, npy_intp n,
+                              int mode, npy_uint64 seed, npy_uint64 start)
+{
+    npy_uint64 len;
+    npy_uint32 k0, k1;
+    int status = 0;
+
+    if (mode != HALF_ROUNDING_TOWARD_ZERO &&
+            mode != HALF_ROUNDING_STOCHASTIC) {
+        floatbits_to_halfbits_n(f, h, n);
+        return;
+    }
+    while (n > 0) {
+        len = 0x100000000u - (npy_uint32)start;
+        if (len > (npy_uint64)n) {
+            len = (npy_uint64)n;
+        }
+        half_random_key(seed, start, &k0, &k1);
+        status |= floatbits_to_halfbits_mode_n(f, h, (npy_intp)len, mode,
+                                               (npy_uint32)start, k0, k1);
+        f += len;
+        h += len;
+        n -= (npy_intp)len;
+        start += len;
+    }
+    half_raise_status(status);
+}
+
+void
+doublebits_to_halfbits_round_n(const npy_uint64 *d, npy_uint16 *h,
+                               npy_intp n, int mode, npy_uint64 seed,
+                               npy_uint64 start)
+{
+    npy_uint64 len;
+    npy_uint32 k0, k1;
+    int status = 0;
+
+    if (mode != HALF_ROUNDING_TOWARD_ZERO &&
+            mode != HALF_ROUNDING_STOCHASTIC) {
+        doublebits_to_halfbits_n(d, h, n);
+        return;
+    }
+    while (n > 0) {
+        len = 0x100000000u - (npy_uint32)start;
+        if (len > (npy_uint64)n) {
+            len = (npy_uint64)n;
+        }
+        half_random_key(seed, start, &k0, &k1);
+        status |= doublebits_to_halfbits_mode_n(d, h, (npy_intp)len, mode,
+                                                (npy_uint32)start, k0, k1);
+        d += len;
+        h += len;
+        n -= (npy_intp)len;
+        start += len;
+    }
+    half_raise_status(status);
+}
+
+
+/*
+ ********************************************************************
+ *                     BULK COMPARISONS                             *
+ ********************************************************************
+ */
+
+/*
+ * The SIMD comparisons map each half to a signed 16-bit key which orders
+ * like the value: the magnitude for positive halves, its negation for
+ * negative ones.  Both signed zeros map to 0.  NaN lanes are masked off
+ * separately.
+ */
+enum {
+    HALF_CMP_EQ,
+    HALF_CMP_NE,
+    HALF_CMP_LT,
+    HALF_CMP_LE
+};
+
+static int
+half_cmp(npy_half h1, npy_half h2, int op)
+{
+    switch (op) {
+        case HALF_CMP_EQ:
+            return half_eq(h1, h2);
+        case HALF_CMP_NE:
+            return half_ne(h1, h2);
+        case HALF_CMP_LT:
+            return half_lt(h1, h2);
+        default:
+            return half_le(h1, h2);
+    }
+}
+
+#if HALF_HAVE_X86_SIMD
+
+static HALF_SIMD_INLINE HALF_TARGET_SSE2 __m128i
+half_cmp_sse2_8(__m128i h1, __m128i h2, int op)
+{
+    const __m128i absmask = _mm_set1_epi16(0x7fff);
+    const __m128i pinf = _mm_set1_epi16(0x7c00);
+    __m128i a1, a2, s1, s2, k1, k2, nan, ret;
+
+    a1 = _mm_and_si128(h1, absmask);
+    a2 = _mm_and_si128(h2, absmask);
+    nan = _mm_or_si128(_mm_cmpgt_epi16(a1, pinf), _mm_cmpgt_epi16(a2, pinf));
+    s1 = _mm_srai_epi16(h1, 15);
+    s2 = _mm_srai_epi16(h2, 15);
+    k1 = _mm_sub_epi16(_mm_xor_si128(a1, s1), s1);
+    k2 = _mm_sub_epi16(_mm_xor_si128(a2, s2), s2);
+
+    switch (op) {
+        case HALF_CMP_EQ:
+            return _mm_andnot_si128(nan, _mm_cmpeq_epi16(k1, k2));
+        case HALF_CMP_NE:
+            return _mm_or_si128(nan, _mm_xor_si128(_mm_cmpeq_epi16(k1, k2),
+                                                   _mm_set1_epi16(-1)));
+        case HALF_CMP_LT:
+            return _mm_andnot_si128(nan, _mm_cmplt_epi16(k1, k2));
+        default:
+            ret = _mm_or_si128(nan, _mm_cmpgt_epi16(k1, k2));
+            return _mm_xor_si128(ret, _mm_set1_epi16(-1));
+    }
+}
+
+static HALF_TARGET_SSE2 void
+half_cmp_sse2(const npy_half *h1, npy_intp s1, const npy_half *h2,
+              npy_intp s2, npy_bool *out, npy_intp n, int op)
+{
+    __m128i b1 = _mm_set1_epi16((short)*h1), b2 = _mm_set1_epi16((short)*h2);
+    __m128i r0, r1;
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        r0 = half_cmp_sse2_8(
+                s1 ? _mm_loadu_si128((const __m128i *)(h1 + i)) : b1,
+                s2 ? _mm_loadu_si128((const __m128i *)(h2 + i)) : b2, op);
+        r1 = half_cmp_sse2_8(
+                s1 ? _mm_loadu_si128((const __m128i *)(h1 + i + 8)) : b1,
+                s2 ? _mm_loadu_si128((const __m128i *)(h2 + i + 8)) : b2, op);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_and_si128(
+                    _mm_packs_epi16(r0, r1), _mm_set1_epi8(1)));
+    }
+    for (; i < n; i++) {
+        out[i] = (npy_bool)half_cmp(h1[i*s1], h2[i*s2], op);
+    }
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m256i
+half_cmp_avx2_16(__m256i h1, __m256i h2, int op)
+{
+    const __m256i absmask = _mm256_set1_epi16(0x7fff);
+    const __m256i pinf = _mm256_set1_epi16(0x7c00);
+    __m256i a1, a2, s1, s2, k1, k2, nan, ret;
+
+    a1 = _mm256_and_si256(h1, absmask);
+    a2 = _mm256_and_si256(h2, absmask);
+    nan = _mm256_or_si256(_mm256_cmpgt_epi16(a1, pinf),
+                          _mm256_cmpgt_epi16(a2, pinf));
+    s1 = _mm256_srai_epi16(h1, 15);
+    s2 = _mm256_srai_epi16(h2, 15);
+    k1 = _mm256_sub_epi16(_mm256_xor_si256(a1, s1), s1);
+    k2 = _mm256_sub_epi16(_mm256_xor_si256(a2, s2), s2);
+
+    switch (op) {
+        case HALF_CMP_EQ:
+            return _mm256_andnot_si256(nan, _mm256_cmpeq_epi16(k1, k2));
+        case HALF_CMP_NE:
+            return _mm256_or_si256(nan, _mm256_xor_si256(
+                    _mm256_cmpeq_epi16(k1, k2), _mm256_set1_epi16(-1)));
+        case HALF_CMP_LT:
+            return _mm256_andnot_si256(nan, _mm256_cmpgt_epi16(k2, k1));
+        default:
+            ret = _mm256_or_si256(nan, _mm256_cmpgt_epi16(k1, k2));
+            return _mm256_xor_si256(ret, _mm256_set1_epi16(-1));
+    }
+}
+
+static HALF_TARGET_AVX2 void
+half_cmp_avx2(const npy_half *h1, npy_intp s1, const npy_half *h2,
+              npy_intp s2, npy_bool *out, npy_intp n, int op)
+{
+    __m256i b1 = _mm256_set1_epi16((short)*h1);
+    __m256i b2 = _mm256_set1_epi16((short)*h2);
+    __m256i r0, r1;
+    npy_intp i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        r0 = half_cmp_avx2_16(
+            s1 ? _mm256_loadu_si256((const __m256i *)(h1 + i)) : b1,
+            s2 ? _mm256_loadu_si256((const __m256i *)(h2 + i)) : b2, op);
+        r1 = half_cmp_avx2_16(
+            s1 ? _mm256_loadu_si256((const __m256i *)(h1 + i + 16)) : b1,
+            s2 ? _mm256_loadu_si256((const __m256i *)(h2 + i + 16)) : b2, op);
+        /* packs works within 128-bit lanes, put the quadwords back */
+        r0 = _mm256_permute4x64_epi64(_mm256_packs_epi16(r0, r1), 0xd8);
+        _mm256_storeu_si256((__m256i *)(out + i),
+                            _mm256_and_si256(r0, _mm256_set1_epi8(1)));
+    }
+    for (; i < n; i++) {
+        out[i] = (npy_bool)half_cmp(h1[i*s1], h2[i*s2], op);
+    }
+}
+
+static HALF_TARGET_AVX512 void
+half_cmp_avx512(const npy_half *h1, npy_intp s1, const npy_half *h2,
+                npy_intp s2, npy_bool *out, npy_intp n, int op)
+{
+    const __m512i absmask = _mm512_set1_epi16(0x7fff);
+    const __m512i pinf = _mm512_set1_epi16(0x7c00);
+    __m512i b1 = _mm512_set1_epi16((short)*h1);
+    __m512i b2 = _mm512_set1_epi16((short)*h2);
+    __m512i v1, v2, a1, a2, k1, k2;
+    __mmask32 nan, ret;
+    npy_intp i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        v1 = s1 ? _mm512_loadu_si512((const void *)(h1 + i)) : b1;
+        v2 = s2 ? _mm512_loadu_si512((const void *)(h2 + i)) : b2;
+        a1 = _mm512_and_si512(v1, absmask);
+        a2 = _mm512_and_si512(v2, absmask);
+        nan = _mm512_cmpgt_epi16_mask(a1, pinf) |
+              _mm512_cmpgt_epi16_mask(a2, pinf);
+        k1 = _mm512_mask_sub_epi16(a1, _mm512_movepi16_mask(v1),
+                                   _mm512_setzero_si512(), a1);
+        k2 = _mm512_mask_sub_epi16(a2, _mm512_movepi16_mask(v2),
+                                   _mm512_setzero_si512(), a2);
+        switch (op) {
+            case HALF_CMP_EQ:
+                ret = _mm512_cmpeq_epi16_mask(k1, k2) & ~nan;
+                break;
+            case HALF_CMP_NE:
+                ret = _mm512_cmpneq_epi16_mask(k1, k2) | nan;
+                break;
+            case HALF_CMP_LT:
+                ret = _mm512_cmplt_epi16_mask(k1, k2) & ~nan;
+                break;
+            default:
+                ret = _mm512_cmple_epi16_mask(k1, k2) & ~nan;
+                break;
+        }
+        _mm256_storeu_si256((__m256i *)(out + i),
+                            _mm256_maskz_set1_epi8(ret, 1));
+    }
+    for (; i < n; i++) {
+        out[i] = (npy_bool)half_cmp(h1[i*s1], h2[i*s2], op);
+    }
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+static void
+half_cmp_n(const npy_half *h1, npy_intp s1, const npy_half *h2, npy_intp s2,
+           npy_bool *out, npy_intp n, int op)
+{
+    npy_intp i;
+
+    if (n <= 0) {
+        return;
+    }
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            half_cmp_avx512(h1, s1, h2, s2, out, n, op);
+            return;
+        case HALF_SIMD_AVX2:
+            half_cmp_avx2(h1, s1, h2, s2, out, n, op);
+            return;
+        case HALF_SIMD_SSE2:
+            half_cmp_sse2(h1, s1, h2, s2, out, n, op);
+            return;
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                out[i] = (npy_bool)half_cmp(h1[i*s1], h2[i*s2], op);
+            }
+    }
+}
+
+void
+half_eq_n(const npy_half *h1, npy_intp s1, const npy_half *h2, npy_intp s2,
+          npy_bool *out, npy_intp n)
+{
+    half_cmp_n(h1, s1, h2, s2, out, n, HALF_CMP_EQ);
+}
+
+void
+half_ne_n(const npy_half *h1, npy_intp s1, const npy_half *h2, npy_intp s2,
+          npy_bool *out, npy_intp n)
+{
+    half_cmp_n(h1, s1, h2, s2, out, n, HALF_CMP_NE);
+}
+
+void
+half_lt_n(const npy_half *h1, npy_intp s1, const npy_half *h2, npy_intp s2,
+          npy_bool *out, npy_intp n)
+{
+    half_cmp_n(h1, s1, h2, s2, out, n, HALF_CMP_LT);
+}
+
+void
+half_le_n(const npy_half *h1, npy_intp s1, const npy_half *h2, npy_intp s2,
+          npy_bool *out, npy_intp n)
+{
+    half_cmp_n(h1, s1, h2, s2, out, n, HALF_CMP_LE);
+}
+
+/*
+ ********************************************************************
+ *                     BULK ARGMAX/ARGMIN                           *
+ ********************************************************************
+ */
+
+/*
+ * The array is scanned in blocks.  Each block is reduced to its extreme
+ * key (see BULK COMPARISONS) and whether it contains a NaN; only the
+ * block holding the result is scanned again to find the first index.
+ */
+#define HALF_ARG_BLOCK 1024
+
+static int
+half_key(npy_half h)
+{
+    return (h & 0x8000u) ? -(int)(h & 0x7fffu) : (int)(h & 0x7fffu);
+}
+
+static int
+half_extreme_block(const npy_half *h, npy_intp n, int want_max, int *ext)
+{
+    npy_intp i;
+    int k, ret = half_key(h[0]), nan = 0;
+
+    for (i = 0; i < n; i++) {
+        k = half_key(h[i]);
+        nan |= (h[i] & 0x7fffu) > 0x7c00u;
+        ret = (want_max ? k > ret : k < ret) ? k : ret;
+    }
+    *ext = ret;
+    return nan;
+}
+
+#if HALF_HAVE_X86_SIMD
+
+static HALF_TARGET_SSE2 int
+half_extreme_sse2(const npy_half *h, npy_intp n, int want_max, int *ext)
+{
+    const __m128i absmask = _mm_set1_epi16(0x7fff);
+    const __m128i pinf = _mm_set1_epi16(0x7c00);
+    __m128i acc = _mm_set1_epi16((short)half_key(h[0]));
+    __m128i nan = _mm_setzero_si128();
+    __m128i v, a, s, k;
+    npy_int16 lanes[8];
+    npy_intp i;
+    int j, tail_ext, tail_nan;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        v = _mm_loadu_si128((const __m128i *)(h + i));
+        a = _mm_and_si128(v, absmask);
+        s = _mm_srai_epi16(v, 15);
+        k = _mm_sub_epi16(_mm_xor_si128(a, s), s);
+        nan = _mm_or_si128(nan, _mm_cmpgt_epi16(a, pinf));
+        acc = want_max ? _mm_max_epi16(acc, k) : _mm_min_epi16(acc, k);
+    }
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    *ext = lanes[0];
+    for (j = 1; j < 8; j++) {
+        *ext = (want_max ? lanes[j] > *ext : lanes[j] < *ext) ? lanes[j] : *ext;
+    }
+    if (i < n) {
+        tail_nan = half_extreme_block(h + i, n - i, want_max, &tail_ext);
+        *ext = (want_max ? tail_ext > *ext : tail_ext < *ext) ? tail_ext : *ext;
+        if (tail_nan) {
+            return 1;
+        }
+    }
+    return _mm_movemask_epi8(nan) != 0;
+}
+
+static HALF_TARGET_AVX2 int
+half_extreme_avx2(const npy_half *h, npy_intp n, int want_max, int *ext)
+{
+    const __m256i absmask = _mm256_set1_epi16(0x7fff);
+    const __m256i pinf = _mm256_set1_epi16(0x7c00);
+    __m256i acc0 = _mm256_set1_epi16((short)half_key(h[0])), acc1 = acc0;
+    __m256i nan = _mm256_setzero_si256();
+    __m256i v0, v1, a0, a1, s0, s1, k0, k1;
+    npy_int16 lanes[16];
+    npy_intp i;
+    int j, tail_ext, tail_nan;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        v0 = _mm256_loadu_si256((const __m256i *)(h + i));
+        v1 = _mm256_loadu_si256((const __m256i *)(h + i + 16));
+        a0 = _mm256_and_si256(v0, absmask);
+        a1 = _mm256_and_si256(v1, absmask);
+        s0 = _mm256_srai_epi16(v0, 15);
+        s1 = _mm256_srai_epi16(v1, 15);
+        k0 = _mm256_sub_epi16(_mm256_xor_si256(a0, s0), s0);
+        k1 = _mm256_sub_epi16(_mm256_xor_si256(a1, s1), s1);
+        nan = _mm256_or_si256(nan, _mm256_or_si256(
+                    _mm256_cmpgt_epi16(a0, pinf), _mm256_cmpgt_epi16(a1, pinf)));
+        if (want_max) {
+            acc0 = _mm256_max_epi16(acc0, k0);
+            acc1 = _mm256_max_epi16(acc1, k1);
+        }
+        else {
+            acc0 = _mm256_min_epi16(acc0, k0);
+            acc1 = _mm256_min_epi16(acc1, k1);
+        }
+    }
+    acc0 = want_max ? _mm256_max_epi16(acc0, acc1) : _mm256_min_epi16(acc0, acc1);
+    _mm256_storeu_si256((__m256i *)lanes, acc0);
+    *ext = lanes[0];
+    for (j = 1; j < 16; j++) {
+        *ext = (want_max ? lanes[j] > *ext : lanes[j] < *ext) ? lanes[j] : *ext;
+    }
+    if (i < n) {
+        tail_nan = half_extreme_block(h + i, n - i, want_max, &tail_ext);
+        *ext = (want_max ? tail_ext > *ext : tail_ext < *ext) ? tail_ext : *ext;
+        if (tail_nan) {
+            return 1;
+        }
+    }
+    return !_mm256_testz_si256(nan, nan);
+}
+
+static HALF_TARGET_AVX512 int
+half_extreme_avx512(const npy_half *h, npy_intp n, int want_max, int *ext)
+{
+    const __m512i absmask = _mm512_set1_epi16(0x7fff);
+    const __m512i pinf = _mm512_set1_epi16(0x7c00);
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i acc0 = _mm512_set1_epi16((short)half_key(h[0])), acc1 = acc0;
+    __m512i v0, v1, a0, a1, k0, k1;
+    __mmask32 nan = 0;
+    npy_int16 lanes[32];
+    npy_intp i;
+    int j, tail_ext, tail_nan;
+
+    for (i = 0; i + 64 <= n; i += 64) {
+        v0 = _mm512_loadu_si512((const void *)(h + i));
+        v1 = _mm512_loadu_si512((const void *)(h + i + 32));
+        a0 = _mm512_and_si512(v0, absmask);
+        a1 = _mm512_and_si512(v1, absmask);
+        k0 = _mm512_mask_sub_epi16(a0, _mm512_movepi16_mask(v0), zero, a0);
+        k1 = _mm512_mask_sub_epi16(a1, _mm512_movepi16_mask(v1), zero, a1);
+        nan |= _mm512_cmpgt_epi16_mask(a0, pinf) |
+               _mm512_cmpgt_epi16_mask(a1, pinf);
+        if (want_max) {
+            acc0 = _mm512_max_epi16(acc0, k0);
+            acc1 = _mm512_max_epi16(acc1, k1);
+        }
+        else {
+            acc0 = _mm512_min_epi16(acc0, k0);
+            acc1 = _mm512_min_epi16(acc1, k1);
+        }
+    }
+    acc0 = want_max ? _mm512_max_epi16(acc0, acc1) : _mm512_min_epi16(acc0, acc1);
+    _mm512_storeu_si512((void *)lanes, acc0);
+    *ext = lanes[0];
+    for (j = 1; j < 32; j++) {
+        *ext = (want_max ? lanes[j] > *ext : lanes[j] < *ext) ? lanes[j] : *ext;
+    }
+    if (i < n) {
+        tail_nan = half_extreme_block(h + i, n - i, want_max, &tail_ext);
+        *ext = (want_max ? tail_ext > *ext : tail_ext < *ext) ? tail_ext : *ext;
+        if (tail_nan) {
+            return 1;
+        }
+    }
+    return nan != 0;
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+static npy_intp
+half_arg_n(const npy_half *h, npy_intp n, int want_max)
+{
+    int (*extreme)(const npy_half *, npy_intp, int, int *);
+    npy_intp i, len, best_i = 0;
+    int ext, best = 0;
+
+    if (n <= 0) {
+        return 0;
+    }
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            extreme = half_extreme_avx512;
+            break;
+        case HALF_SIMD_AVX2:
+            extreme = half_extreme_avx2;
+            break;
+        case HALF_SIMD_SSE2:
+            extreme = half_extreme_sse2;
+            break;
+#endif
+        default:
+            extreme = half_extreme_block;
+    }
+
+    for (i = 0; i < n; i += HALF_ARG_BLOCK) {
+        len = (n - i < HALF_ARG_BLOCK) ? n - i : HALF_ARG_BLOCK;
+        if (extreme(h + i, len, want_max, &ext)) {
+            /* nan encountered, it's maximal (and minimal) */
+            while (!half_isnan(h[i])) {
+                i++;
+            }
+            return i;
+        }
+        if (i == 0 || (want_max ? ext > best : ext < best)) {
+            best = ext;
+            best_i = i;
+        }
+    }
+    while (half_key(h[best_i]) != best) {
+        best_i++;
+    }
+    return best_i;
+}
+
+npy_intp
+half_argmax_n(const npy_half *h, npy_intp n)
+{
+    return half_arg_n(h, n, 1);
+}
+
+npy_intp
+half_argmin_n(const npy_half *h, npy_intp n)
+{
+    return half_arg_n(h, n, 0);
+}
+
+/*
+ ********************************************************************
+ *                     BULK DOT PRODUCT                             *
+ ********************************************************************
+ */
+
+/*
+ * The kernels return the sum of h1[i]*h2[i] accumulated in float32
+ * (dotf) or float64 (dotd).  Without F16C the halves are converted a
+ * block at a time into float buffers first.
+ */
+#define HALF_DOT_BLOCK 256
+#define HALF_DOT_PAIRWISE_BLOCK 256
+
+static double
+half_dot_generic(const npy_half *h1, const npy_half *h2, npy_intp n,
+                 int in_double)
+{
+    float f1[HALF_DOT_BLOCK], f2[HALF_DOT_BLOCK];
+    float facc[8] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    double dacc[8] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    npy_intp i, j, len;
+
+    for (i = 0; i < n; i += HALF_DOT_BLOCK) {
+        len = (n - i < HALF_DOT_BLOCK) ? n - i : HALF_DOT_BLOCK;
+        halfbits_to_floatbits_n(h1 + i, (npy_uint32 *)f1, len);
+        halfbits_to_floatbits_n(h2 + i, (npy_uint32 *)f2, len);
+        for (j = 0; j < len; j++) {
+            if (in_double) {
+                dacc[j & 7] += (double)(f1[j] * f2[j]);
+            }
+            else {
+                facc[j & 7] += f1[j] * f2[j];
+            }
+        }
+    }
+    if (in_double) {
+        return ((dacc[0] + dacc[4]) + (dacc[2] + dacc[6])) +
+               ((dacc[1] + dacc[5]) + (dacc[3] + dacc[7]));
+    }
+    return ((facc[0] + facc[4]) + (facc[2] + facc[6])) +
+           ((facc[1] + facc[5]) + (facc[3] + facc[7]));
+}
+
+static double
+half_dotf_generic(const npy_half *h1, const npy_half *h2, npy_intp n)
+{
+    return half_dot_generic(h1, h2, n, 0);
+}
+
+static double
+half_dotd_generic(const npy_half *h1, const npy_half *h2, npy_intp n)
+{
+    return half_dot_generic(h1, h2, n, 1);
+}
+
+#if HALF_HAVE_X86_SIMD
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 float
+half_hsum_avx2(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v),
+                          _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+    return _mm_cvtss_f32(s);
+}
+
+static HALF_TARGET_AVX2 double
+half_dotf_avx2(const npy_half *h1, const npy_half *h2, npy_intp n)
+{
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    npy_intp i;
+    float ret;
+
+#define HALF_LOADPS(p) _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(p)))
+    for (i = 0; i + 32 <= n; i += 32) {
+        acc0 = _mm256_fmadd_ps(HALF_LOADPS(h1 + i), HALF_LOADPS(h2 + i), acc0);
+        acc1 = _mm256_fmadd_ps(HALF_LOADPS(h1 + i + 8),
+                               HALF_LOADPS(h2 + i + 8), acc1);
+        acc2 = _mm256_fmadd_ps(HALF_LOADPS(h1 + i + 16),
+                               HALF_LOADPS(h2 + i + 16), acc2);
+        acc3 = _mm256_fmadd_ps(HALF_LOADPS(h1 + i + 24),
+                               HALF_LOADPS(h2 + i + 24), acc3);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(HALF_LOADPS(h1 + i), HALF_LOADPS(h2 + i), acc0);
+    }
+#undef HALF_LOADPS
+    ret = half_hsum_avx2(_mm256_add_ps(_mm256_add_ps(acc0, acc2),
+                                       _mm256_add_ps(acc1, acc3)));
+    for (; i < n; i++) {
+        ret += half_to_float(h1[i]) * half_to_float(h2[i]);
+    }
+    return ret;
+}
+
+static HALF_TARGET_AVX2 double
+half_dotd_avx2(const npy_half *h1, const npy_half *h2, npy_intp n)
+{
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    __m256 p0, p1;
+    __m128d s;
+    npy_intp i;
+    double ret;
+
+#define HALF_LOADPS(p) _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(p)))
+    for (i = 0; i + 16 <= n; i += 16) {
+        /* the products are exact, only the sums need double */
+        p0 = _mm256_mul_ps(HALF_LOADPS(h1 + i), HALF_LOADPS(h2 + i));
+        p1 = _mm256_mul_ps(HALF_LOADPS(h1 + i + 8), HALF_LOADPS(h2 + i + 8));
+        acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm256_castps256_ps128(p0)));
+        acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm256_extractf128_ps(p0, 1)));
+        acc2 = _mm256_add_pd(acc2, _mm256_cvtps_pd(_mm256_castps256_ps128(p1)));
+        acc3 = _mm256_add_pd(acc3, _mm256_cvtps_pd(_mm256_extractf128_ps(p1, 1)));
+    }
+#undef HALF_LOADPS
+    acc0 = _mm256_add_pd(_mm256_add_pd(acc0, acc2), _mm256_add_pd(acc1, acc3));
+    s = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+    ret = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+    for (; i < n; i++) {
+        ret += (double)(half_to_float(h1[i]) * half_to_float(h2[i]));
+    }
+    return ret;
+}
+
+static HALF_TARGET_AVX512 double
+half_dotf_avx512(const npy_half *h1, const npy_half *h2, npy_intp n)
+{
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    __mmask16 tail;
+    npy_intp i;
+
+#define HALF_LOADPS(p) _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *)(p)))
+    for (i = 0; i + 64 <= n; i += 64) {
+        acc0 = _mm512_fmadd_ps(HALF_LOADPS(h1 + i), HALF_LOADPS(h2 + i), acc0);
+        acc1 = _mm512_fmadd_ps(HALF_LOADPS(h1 + i + 16),
+                               HALF_LOADPS(h2 + i + 16), acc1);
+        acc2 = _mm512_fmadd_ps(HALF_LOADPS(h1 + i + 32),
+                               HALF_LOADPS(h2 + i + 32), acc2);
+        acc3 = _mm512_fmadd_ps(HALF_LOADPS(h1 + i + 48),
+                               HALF_LOADPS(h2 + i + 48), acc3);
+    }
+#undef HALF_LOADPS
+#define HALF_LOADPS(p) _mm512_cvtph_ps(_mm256_maskz_loadu_epi16(tail, (p)))
+    for (; i < n; i += 16) {
+        /* masked off lanes load as +0.0 */
+        tail = (n - i >= 16) ? (__mmask16)0xffff
+                             : (__mmask16)((1u << (n - i)) - 1);
+        acc0 = _mm512_fmadd_ps(HALF_LOADPS(h1 + i), HALF_LOADPS(h2 + i), acc0);
+    }
+#undef HALF_LOADPS
+    return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(acc0, acc2),
+                                              _mm512_add_ps(acc1, acc3)));
+}
+
+static HALF_TARGET_AVX512 double
+half_dotd_avx512(const npy_half *h1, const npy_half *h2, npy_intp n)
+{
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = acc0;
+    __m512 p;
+    __mmask16 tail;
+    npy_intp i;
+
+#define HALF_LOADPS(p) _mm512_cvtph_ps(_mm256_maskz_loadu_epi16(tail, (p)))
+    for (i = 0; i < n; i += 16) {
+        tail = (n - i >= 16) ? (__mmask16)0xffff
+                             : (__mmask16)((1u << (n - i)) - 1);
+        /* the products are exact, only the sums need double */
+        p = _mm512_mul_ps(HALF_LOADPS(h1 + i), HALF_LOADPS(h2 + i));
+        acc0 = _mm512_add_pd(acc0, _mm512_cvtps_pd(_mm512_castps512_ps256(p)));
+        acc1 = _mm512_add_pd(acc1, _mm512_cvtps_pd(_mm256_castpd_ps(
+                        _mm512_extractf64x4_pd(_mm512_castps_pd(p), 1))));
+    }
+#undef HALF_LOADPS
+    return _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+static double
+half_dot_pairwise(const npy_half *h1, const npy_half *h2, npy_intp n,
+                  double (*dotf)(const npy_half *, const npy_half *, npy_intp))
+{
+    npy_intp m;
+
+    if (n <= HALF_DOT_PAIRWISE_BLOCK) {
+        return dotf(h1, h2, n);
+    }
+    /* split at a multiple of the block size to keep the loads aligned */
+    m = (n / 2) - (n / 2) % HALF_DOT_PAIRWISE_BLOCK;
+    if (m == 0) {
+        m = HALF_DOT_PAIRWISE_BLOCK;
+    }
+    return (float)((float)half_dot_pairwise(h1, h2, m, dotf) +
+                   (float)half_dot_pairwise(h1 + m, h2 + m, n - m, dotf));
+}
+
+double
+half_dot_n(const npy_half *h1, const npy_half *h2, npy_intp n, int accumulate)
+{
+    double (*dotf)(const npy_half *, const npy_half *, npy_intp);
+    double (*dotd)(const npy_half *, const npy_half *, npy_intp);
+
+    if (n <= 0) {
+        return 0.0;
+    }
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            dotf = half_dotf_avx512;
+            dotd = half_dotd_avx512;
+            break;
+        case HALF_SIMD_AVX2:
+            dotf = half_dotf_avx2;
+            dotd = half_dotd_avx2;
+            break;
+#endif
+        default:
+            dotf = half_dotf_generic;
+            dotd = half_dotd_generic;
+    }
+
+    switch (accumulate) {
+        case HALF_DOT_DOUBLE:
+            return dotd(h1, h2, n);
+        case HALF_DOT_PAIRWISE:
+            return half_dot_pairwise(h1, h2, n, dotf);
+        default:
+            return dotf(h1, h2, n);
+    }
+}
+
+/*
+ ********************************************************************
+ *                     MATRIX MULTIPLICATION                        *
+ ********************************************************************
+ */
+
+/*
+ * A blocked GEMM in the usual layout: for each HALF_GEMM_NC wide column
+ * strip of C and each HALF_GEMM_KC deep slice of the inner dimension, B
+ * is packed into float panels HALF_GEMM_NR columns wide, then each
+ * HALF_GEMM_MC row block of A into panels HALF_GEMM_MR rows high.  A
+ * micro-kernel multiplies one A panel by one B panel into an MR x NR
+ * tile of a float copy of the C strip, which is rounded to half at the
+ * end.  Panels and the float strip are zero padded to whole tiles, so
+ * the kernels only see full tiles.  Products with fewer than NR columns
+ * or a single row would be mostly padding and take half_gemm_small.
+ */
+#define HALF_GEMM_MR 6
+#define HALF_GEMM_KC 256
+#define HALF_GEMM_MC 96
+#define HALF_GEMM_NC 512
+
+typedef void (*half_gemm_kernel)(npy_intp kc, const float *a, const float *b,
+                                 float *c, npy_intp ldc);
+
+static void
+half_gemm_kernel_generic(npy_intp kc, const float *a, const float *b,
+                         float *c, npy_intp ldc)
+{
+    float acc[HALF_GEMM_MR][16];
+    npy_intp p;
+    int r, j;
+
+    for (r = 0; r < HALF_GEMM_MR; r++) {
+        for (j = 0; j < 16; j++) {
+            acc[r][j] = 0.0f;
+        }
+    }
+    for (p = 0; p < kc; p++, a += HALF_GEMM_MR, b += 16) {
+        for (r = 0; r < HALF_GEMM_MR; r++) {
+            for (j = 0; j < 16; j++) {
+                acc[r][j] += a[r] * b[j];
+            }
+        }
+    }
+    for (r = 0; r < HALF_GEMM_MR; r++) {
+        for (j = 0; j < 16; j++) {
+            c[r*ldc + j] += acc[r][j];
+        }
+    }
+}
+
+#if HALF_HAVE_X86_SIMD
+
+static HALF_TARGET_AVX2 void
+half_gemm_kernel_avx2(npy_intp kc, const float *a, const float *b,
+                      float *c, npy_intp ldc)
+{
+    __m256 c00 = _mm256_setzero_ps(), c01 = c00, c10 = c00, c11 = c00,
+           c20 = c00, c21 = c00, c30 = c00, c31 = c00,
+           c40 = c00, c41 = c00, c50 = c00, c51 = c00;
+    __m256 b0, b1, av;
+    npy_intp p;
+
+    for (p = 0; p < kc; p++, a += HALF_GEMM_MR, b += 16) {
+        b0 = _mm256_loadu_ps(b);
+        b1 = _mm256_loadu_ps(b + 8);
+#define HALF_GEMM_ROW(r)                                                    \
+        av = _mm256_broadcast_ss(a + r);                                    \
+        c ## r ## 0 = _mm256_fmadd_ps(av, b0, c ## r ## 0);                \
+        c ## r ## 1 = _mm256_fmadd_ps(av, b1, c ## r ## 1)
+        HALF_GEMM_ROW(0); HALF_GEMM_ROW(1); HALF_GEMM_ROW(2);
+        HALF_GEMM_ROW(3); HALF_GEMM_ROW(4); HALF_GEMM_ROW(5);
+#undef HALF_GEMM_ROW
+    }
+#define HALF_GEMM_STORE(r)                                                  \
+    _mm256_storeu_ps(c + r*ldc, _mm256_add_ps(_mm256_loadu_ps(c + r*ldc),   \
+                                              c ## r ## 0));                \
+    _mm256_storeu_ps(c + r*ldc + 8,                                         \
+                     _mm256_add_ps(_mm256_loadu_ps(c + r*ldc + 8), c ## r ## 1))
+    HALF_GEMM_STORE(0); HALF_GEMM_STORE(1); HALF_GEMM_STORE(2);
+    HALF_GEMM_STORE(3); HALF_GEMM_STORE(4); HALF_GEMM_STORE(5);
+#undef HALF_GEMM_STORE
+}
+
+static HALF_TARGET_AVX512 void
+half_gemm_kernel_avx512(npy_intp kc, const float *a, const float *b,
+                        float *c, npy_intp ldc)
+{
+    __m512 c00 = _mm512_setzero_ps(), c01 = c00, c10 = c00, c11 = c00,
+           c20 = c00, c21 = c00, c30 = c00, c31 = c00,
+           c40 = c00, c41 = c00, c50 = c00, c51 = c00;
+    __m512 b0, b1, av;
+    npy_intp p;
+
+    for (p = 0; p < kc; p++, a += HALF_GEMM_MR, b += 32) {
+        b0 = _mm512_loadu_ps(b);
+        b1 = _mm512_loadu_ps(b + 16);
+#define HALF_GEMM_ROW(r)                                                    \
+        av = _mm512_set1_ps(a[r]);                                          \
+        c ## r ## 0 = _mm512_fmadd_ps(av, b0, c ## r ## 0);                 \
+        c ## r ## 1 = _mm512_fmadd_ps(av, b1, c ## r ## 1)
+        HALF_GEMM_ROW(0); HALF_GEMM_ROW(1); HALF_GEMM_ROW(2);
+        HALF_GEMM_ROW(3); HALF_GEMM_ROW(4); HALF_GEMM_ROW(5);
+#undef HALF_GEMM_ROW
+    }
+#define HALF_GEMM_STORE(r)                                                  \
+    _mm512_storeu_ps(c + r*ldc, _mm512_add_ps(_mm512_loadu_ps(c + r*ldc),   \
+                                              c ## r ## 0));                \
+    _mm512_storeu_ps(c + r*ldc + 16,                                        \
+                     _mm512_add_ps(_mm512_loadu_ps(c + r*ldc + 16), c ## r ## 1))
+    HALF_GEMM_STORE(0); HALF_GEMM_STORE(1); HALF_GEMM_STORE(2);
+    HALF_GEMM_STORE(3); HALF_GEMM_STORE(4); HALF_GEMM_STORE(5);
+#undef HALF_GEMM_STORE
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+/* Converts n halves, stride elements apart, to floats */
+static void
+half_gemm_load(const npy_half *h, npy_intp stride, npy_intp n, float *f)
+{
+    npy_intp i;
+
+    if (stride == 1) {
+        halfbits_to_floatbits_n(h, (npy_uint32 *)f, n);
+        return;
+    }
+    for (i = 0; i < n; i++, h += stride) {
+        f[i] = half_to_float(*h);
+    }
+}
+
+static void
+half_gemm_pack_a(npy_intp mc, npy_intp kc, const npy_half *a, npy_intp a_rs,
+                 npy_intp a_cs, float *ap, float *row)
+{
+    npy_intp i, p;
+    int r;
+
+    for (i = 0; i < mc; i += HALF_GEMM_MR, ap += HALF_GEMM_MR*kc) {
+        for (r = 0; r < HALF_GEMM_MR; r++) {
+            if (i + r < mc) {
+                half_gemm_load(a + (i + r)*a_rs, a_cs, kc, row);
+                for (p = 0; p < kc; p++) {
+                    ap[p*HALF_GEMM_MR + r] = row[p];
+                }
+            }
+            else {
+                for (p = 0; p < kc; p++) {
+                    ap[p*HALF_GEMM_MR + r] = 0.0f;
+                }
+            }
+        }
+    }
+}
+
+static void
+half_gemm_pack_b(npy_intp kc, npy_intp nc, int nr, const npy_half *b,
+                 npy_intp b_rs, npy_intp b_cs, float *bp, float *row)
+{
+    npy_intp j, p;
+    int jj;
+
+    for (p = 0; p < kc; p++) {
+        half_gemm_load(b + p*b_rs, b_cs, nc, row);
+        for (j = 0; j < nc; j += nr) {
+            for (jj = 0; jj < nr; jj++) {
+                bp[j*kc + p*nr + jj] = (j + jj < nc) ? row[j + jj] : 0.0f;
+            }
+        }
+    }
+}
+
+/* Rounds the m x n float block cf to C, adding the flags to *status */
+static void
+half_gemm_store(npy_intp m, npy_intp n, float *cf, npy_intp ldc,
+                npy_half *c, npy_intp c_rs, npy_intp c_cs, npy_half *hrow,
+                int *status)
+{
+    npy_intp i, j;
+
+    for (i = 0; i < m; i++) {
+        if (c_cs == 1) {
+            *status |= floatbits_to_halfbits_status_n(
+                    (npy_uint32 *)(cf + i*ldc), c + i*c_rs, n);
+            continue;
+        }
+        *status |= floatbits_to_halfbits_status_n(
+                (npy_uint32 *)(cf + i*ldc), hrow, n);
+        for (j = 0; j < n; j++) {
+            c[i*c_rs + j*c_cs] = hrow[j];
+        }
+    }
+}
+
+/*
+ * The matrix-vector shapes.  Each element of C is a float dot product of
+ * an A row and a B column, copied to contiguous halves when strided.  A
+ * single row of C with B rows contiguous instead sums the B rows scaled
+ * by A, which reads B once in order.  Returns -1 if out of memory.
+ */
+static int
+half_gemm_small(npy_intp m, npy_intp n, npy_intp k,
+                const npy_half *a, npy_intp a_rs, npy_intp a_cs,
+                const npy_half *b, npy_intp b_rs, npy_intp b_cs,
+                npy_half *c, npy_intp c_rs, npy_intp c_cs)
+{
+    const npy_half *ai, *bj;
+    npy_half *bt, *arow, *hrow;
+    float *cf, *row, ap;
+    npy_intp i, j, p;
+    int status = 0;
+
+    if (m == 1 && b_rs != 1) {
+        cf = (float *)malloc(sizeof(float)*2*n + sizeof(npy_half)*n);
+        if (cf == NULL) {
+            return -1;
+        }
+        row = cf + n;
+        hrow = (npy_half *)(row + n);
+        for (j = 0; j < n; j++) {
+            cf[j] = 0.0f;
+        }
+        for (p = 0; p < k; p++) {
+            ap = half_to_float(a[p*a_cs]);
+            half_gemm_load(b + p*b_rs, b_cs, n, row);
+            for (j = 0; j < n; j++) {
+                cf[j] += ap * row[j];
+            }
+        }
+        half_gemm_store(1, n, cf, n, c, c_rs, c_cs, hrow, &status);
+        free(cf);
+        half_raise_status(status);
+        return 0;
+    }
+
+    cf = (float *)malloc(sizeof(float)*m*n + sizeof(npy_half)*
+                         ((b_rs != 1 ? k*n : 0) + k + n));
+    if (cf == NULL) {
+        return -1;
+    }
+    bt = (npy_half *)(cf + m*n);
+    arow = bt + (b_rs != 1 ? k*n : 0);
+    hrow = arow + k;
+    if (b_rs != 1) {
+        for (j = 0; j < n; j++) {
+            for (p = 0; p < k; p++) {
+                bt[j*k + p] = b[p*b_rs + j*b_cs];
+            }
+        }
+    }
+    for (i = 0; i < m; i++) {
+        ai = a + i*a_rs;
+        if (a_cs != 1) {
+            for (p = 0; p < k; p++) {
+                arow[p] = ai[p*a_cs];
+            }
+            ai = arow;
+        }
+        for (j = 0; j < n; j++) {
+            bj = (b_rs == 1) ? b + j*b_cs : bt + j*k;
+            /* a float sum, so exact as a float */
+            cf[i*n + j] = (float)half_dot_n(ai, bj, k, HALF_DOT_FLOAT);
+        }
+    }
+    half_gemm_store(m, n, cf, n, c, c_rs, c_cs, hrow, &status);
+    free(cf);
+    half_raise_status(status);
+    return 0;
+}
+
+/* Used when the packing buffers cannot be allocated */
+static void
+half_gemm_naive(npy_intp m, npy_intp n, npy_intp k,
+                const npy_half *a, npy_intp a_rs, npy_intp a_cs,
+                const npy_half *b, npy_intp b_rs, npy_intp b_cs,
+                npy_half *c, npy_intp c_rs, npy_intp c_cs)
+{
+    npy_intp i, j, p;
+    float tmp;
+
+    for (i = 0; i < m; i++) {
+        for (j = 0; j < n; j++) {
+            tmp = 0.0f;
+            for (p = 0; p < k; p++) {
+                tmp += half_to_float(a[i*a_rs + p*a_cs]) *
+                       half_to_float(b[p*b_rs + j*b_cs]);
+            }
+            c[i*c_rs + j*c_cs] = float_to_half(tmp);
+        }
+    }
+}
+
+void
+half_gemm(npy_intp m, npy_intp n, npy_intp k,
+          const npy_half *a, npy_intp a_rs, npy_intp a_cs,
+          const npy_half *b, npy_intp b_rs, npy_intp b_cs,
+          npy_half *c, npy_intp c_rs, npy_intp c_cs)
+{
+    half_gemm_kernel kernel;
+    float *bp, *ap, *cf, *row;
+    npy_half *hrow;
+    npy_intp ic, jc, pc, ir, jr, i, mc, nc, kc, ldc, mp;
+    int nr, status = 0;
+
+    if (m <= 0 || n <= 0) {
+        return;
+    }
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            kernel = half_gemm_kernel_avx512;
+            nr = 32;
+            break;
+        case HALF_SIMD_AVX2:
+            kernel = half_gemm_kernel_avx2;
+            nr = 16;
+            break;
+#endif
+        default:
+            kernel = half_gemm_kernel_generic;
+            nr = 16;
+    }
+    if (n < nr || m == 1) {
+        if (half_gemm_small(m, n, k, a, a_rs, a_cs, b, b_rs, b_cs,
+                            c, c_rs, c_cs) < 0) {
+            half_gemm_naive(m, n, k, a, a_rs, a_cs, b, b_rs, b_cs,
+                            c, c_rs, c_cs);
+        }
+        return;
+    }
+
+    /* The float strip has whole tiles, as wide as the widest strip */
+    mp = (m + HALF_GEMM_MR - 1) / HALF_GEMM_MR * HALF_GEMM_MR;
+    ldc = (n < HALF_GEMM_NC) ? (n + nr - 1) / nr * nr : HALF_GEMM_NC;
+    bp = (float *)malloc(sizeof(float)*(HALF_GEMM_KC*HALF_GEMM_NC +
+                                        HALF_GEMM_MC*HALF_GEMM_KC +
+                                        mp*ldc + HALF_GEMM_NC) +
+                         sizeof(npy_half)*HALF_GEMM_NC);
+    if (bp == NULL) {
+        half_gemm_naive(m, n, k, a, a_rs, a_cs, b, b_rs, b_cs, c, c_rs, c_cs);
+        return;
+    }
+    ap = bp + HALF_GEMM_KC*HALF_GEMM_NC;
+    cf = ap + HALF_GEMM_MC*HALF_GEMM_KC;
+    row = cf + mp*ldc;
+    hrow = (npy_half *)(row + HALF_GEMM_NC);
+
+    for (jc = 0; jc < n; jc += HALF_GEMM_NC) {
+        nc = (n - jc < HALF_GEMM_NC) ? n - jc : HALF_GEMM_NC;
+        ldc = (nc + nr - 1) / nr * nr;
+        for (i = 0; i < mp*ldc; i++) {
+            cf[i] = 0.0f;
+        }
+        for (pc = 0; pc < k; pc += HALF_GEMM_KC) {
+            kc = (k - pc < HALF_GEMM_KC) ? k - pc : HALF_GEMM_KC;
+            half_gemm_pack_b(kc, nc, nr, b + pc*b_rs + jc*b_cs, b_rs, b_cs,
+                             bp, row);
+            for (ic = 0; ic < m; ic += HALF_GEMM_MC) {
+                mc = (m - ic < HALF_GEMM_MC) ? m - ic : HALF_GEMM_MC;
+                half_gemm_pack_a(mc, kc, a + ic*a_rs + pc*a_cs, a_rs, a_cs,
+                                 ap, row);
+                for (ir = 0; ir < mc; ir += HALF_GEMM_MR) {
+                    for (jr = 0; jr < nc; jr += nr) {
+                        kernel(kc, ap + ir*kc, bp + jr*kc,
+                               cf + (ic + ir)*ldc + jr, ldc);
+                    }
+                }
+            }
+        }
+        half_gemm_store(m, nc, cf, ldc, c + jc*c_cs, c_rs, c_cs, hrow,
+                        &status);
+    }
+    free(bp);
+    half_raise_status(status);
+}
+
+/*
+ ********************************************************************
+ *                     BULK MAXIMUM/MINIMUM                         *
+ ********************************************************************
+ */
+
+/*
+ * Elementwise maximum/minimum like numpy's for floats: the first operand
+ * is kept when the two compare equal or it is a NaN, so NaNs propagate
+ * and -0.0 vs +0.0 keeps the first.  Works on the keys of BULK
+ * COMPARISONS.
+ */
+npy_half
+half_maxmin(npy_half h1, npy_half h2, int want_max)
+{
+    if (half_isnan(h1)) {
+        return h1;
+    }
+    return (want_max ? half_ge(h1, h2) : half_le(h1, h2)) ? h1 : h2;
+}
+
+#if HALF_HAVE_X86_SIMD
+
+static HALF_SIMD_INLINE HALF_TARGET_SSE2 __m128i
+half_maxmin_sse2_8(__m128i h1, __m128i h2, int want_max)
+{
+    const __m128i absmask = _mm_set1_epi16(0x7fff);
+    const __m128i pinf = _mm_set1_epi16(0x7c00);
+    __m128i a1, a2, s1, s2, k1, k2, nan1, nan2, pick1;
+
+    a1 = _mm_and_si128(h1, absmask);
+    a2 = _mm_and_si128(h2, absmask);
+    nan1 = _mm_cmpgt_epi16(a1, pinf);
+    nan2 = _mm_cmpgt_epi16(a2, pinf);
+    s1 = _mm_srai_epi16(h1, 15);
+    s2 = _mm_srai_epi16(h2, 15);
+    k1 = _mm_sub_epi16(_mm_xor_si128(a1, s1), s1);
+    k2 = _mm_sub_epi16(_mm_xor_si128(a2, s2), s2);
+    /* the negation of k2 > k1 (or k1 > k2) is k1 >= k2 (or k1 <= k2) */
+    pick1 = want_max ? _mm_cmpgt_epi16(k2, k1) : _mm_cmpgt_epi16(k1, k2);
+    pick1 = _mm_or_si128(nan1, _mm_andnot_si128(_mm_or_si128(pick1, nan2),
+                                                 _mm_set1_epi16(-1)));
+    return _mm_or_si128(_mm_and_si128(pick1, h1), _mm_andnot_si128(pick1, h2));
+}
+
+static HALF_TARGET_SSE2 void
+half_maxmin_sse2(const npy_half *h1, npy_intp s1, const npy_half *h2,
+                    npy_intp s2, npy_half *out, npy_intp n, int want_max)
+{
+    __m128i b1 = _mm_set1_epi16((short)*h1), b2 = _mm_set1_epi16((short)*h2);
+    npy_intp i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        _mm_storeu_si128((__m128i *)(out + i), half_maxmin_sse2_8(
+                s1 ? _mm_loadu_si128((const __m128i *)(h1 + i)) : b1,
+                s2 ? _mm_loadu_si128((const __m128i *)(h2 + i)) : b2,
+                want_max));
+    }
+    for (; i < n; i++) {
+        out[i] = half_maxmin(h1[i*s1], h2[i*s2], want_max);
+    }
+}
+
+static HALF_TARGET_AVX2 void
+half_maxmin_avx2(const npy_half *h1, npy_intp s1, const npy_half *h2,
+                    npy_intp s2, npy_half *out, npy_intp n, int want_max)
+{
+    const __m256i absmask = _mm256_set1_epi16(0x7fff);
+    const __m256i pinf = _mm256_set1_epi16(0x7c00);
+    __m256i b1 = _mm256_set1_epi16((short)*h1);
+    __m256i b2 = _mm256_set1_epi16((short)*h2);
+    __m256i v1, v2, a1, a2, k1, k2, sg1, sg2, nan1, nan2, pick1;
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        v1 = s1 ? _mm256_loadu_si256((const __m256i *)(h1 + i)) : b1;
+        v2 = s2 ? _mm256_loadu_si256((const __m256i *)(h2 + i)) : b2;
+        a1 = _mm256_and_si256(v1, absmask);
+        a2 = _mm256_and_si256(v2, absmask);
+        nan1 = _mm256_cmpgt_epi16(a1, pinf);
+        nan2 = _mm256_cmpgt_epi16(a2, pinf);
+        sg1 = _mm256_srai_epi16(v1, 15);
+        sg2 = _mm256_srai_epi16(v2, 15);
+        k1 = _mm256_sub_epi16(_mm256_xor_si256(a1, sg1), sg1);
+        k2 = _mm256_sub_epi16(_mm256_xor_si256(a2, sg2), sg2);
+        pick1 = want_max ? _mm256_cmpgt_epi16(k2, k1)
+                         : _mm256_cmpgt_epi16(k1, k2);
+        pick1 = _mm256_or_si256(nan1, _mm256_andnot_si256(
+                    _mm256_or_si256(pick1, nan2), _mm256_set1_epi16(-1)));
+        _mm256_storeu_si256((__m256i *)(out + i),
+                            _mm256_blendv_epi8(v2, v1, pick1));
+    }
+    for (; i < n; i++) {
+        out[i] = half_maxmin(h1[i*s1], h2[i*s2], want_max);
+    }
+}
+
+static HALF_TARGET_AVX512 void
+half_maxmin_avx512(const npy_half *h1, npy_intp s1, const npy_half *h2,
+                      npy_intp s2, npy_half *out, npy_intp n, int want_max)
+{
+    const __m512i absmask = _mm512_set1_epi16(0x7fff);
+    const __m512i pinf = _mm512_set1_epi16(0x7c00);
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i b1 = _mm512_set1_epi16((short)*h1);
+    __m512i b2 = _mm512_set1_epi16((short)*h2);
+    __m512i v1, v2, a1, a2, k1, k2;
+    __mmask32 nan1, nan2, pick1;
+    npy_intp i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        v1 = s1 ? _mm512_loadu_si512((const void *)(h1 + i)) : b1;
+        v2 = s2 ? _mm512_loadu_si512((const void *)(h2 + i)) : b2;
+        a1 = _mm512_and_si512(v1, absmask);
+        a2 = _mm512_and_si512(v2, absmask);
+        nan1 = _mm512_cmpgt_epi16_mask(a1, pinf);
+        nan2 = _mm512_cmpgt_epi16_mask(a2, pinf);
+        k1 = _mm512_mask_sub_epi16(a1, _mm512_movepi16_mask(v1), zero, a1);
+        k2 = _mm512_mask_sub_epi16(a2, _mm512_movepi16_mask(v2), zero, a2);
+        pick1 = want_max ? _mm512_cmpge_epi16_mask(k1, k2)
+                         : _mm512_cmple_epi16_mask(k1, k2);
+        pick1 = nan1 | (pick1 & ~nan2);
+        _mm512_storeu_si512((void *)(out + i),
+                            _mm512_mask_blend_epi16(pick1, v2, v1));
+    }
+    for (; i < n; i++) {
+        out[i] = half_maxmin(h1[i*s1], h2[i*s2], want_max);
+    }
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+static void
+half_maxmin_n(const npy_half *h1, npy_intp s1, const npy_half *h2,
+               npy_intp s2, npy_half *out, npy_intp n, int want_max)
+{
+    npy_intp i;
+
+    if (n <= 0) {
+        return;
+    }
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            half_maxmin_avx512(h1, s1, h2, s2, out, n, want_max);
+            return;
+        case HALF_SIMD_AVX2:
+            half_maxmin_avx2(h1, s1, h2, s2, out, n, want_max);
+            return;
+        case HALF_SIMD_SSE2:
+            half_maxmin_sse2(h1, s1, h2, s2, out, n, want_max);
+            return;
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                out[i] = half_maxmin(h1[i*s1], h2[i*s2], want_max);
+            }
+    }
+}
+
+void
+half_maximum_n(const npy_half *h1, npy_intp s1, const npy_half *h2,
+               npy_intp s2, npy_half *out, npy_intp n)
+{
+    half_maxmin_n(h1, s1, h2, s2, out, n, 1);
+}
+
+void
+half_minimum_n(const npy_half *h1, npy_intp s1, const npy_half *h2,
+               npy_intp s2, npy_half *out, npy_intp n)
+{
+    half_maxmin_n(h1, s1, h2, s2, out, n, 0);
+}
+
+/*
+ ********************************************************************
+ *                     BFLOAT16 CONVERSIONS                         *
+ ********************************************************************
+ */
+
+/*
+ * bfloat16 is the top half of a float: the same exponent range with a
+ * 7 bit mantissa.  Widening is exact.  Narrowing rounds to nearest even
+ * and raises the same flags as the half routines: overflow when a
+ * finite value rounds to inf, underflow when a nonzero value is
+ * subnormal.
+ */
+
+float
+bfloat16_to_float(npy_bfloat16 b)
+{
+    npy_uint32 f = bfloat16bits_to_floatbits(b);
+    float ret;
+
+    memcpy(&ret, &f, sizeof(ret));
+    return ret;
+}
+
+npy_bfloat16
+float_to_bfloat16(float f)
+{
+    npy_uint32 fbits;
+
+    memcpy(&fbits, &f, sizeof(fbits));
+    return floatbits_to_bfloat16bits(fbits);
+}
+
+npy_bfloat16
+double_to_bfloat16(double d)
+{
+    npy_uint64 dbits;
+
+    memcpy(&dbits, &d, sizeof(dbits));
+    return doublebits_to_bfloat16bits(dbits);
+}
+
+npy_uint32
+bfloat16bits_to_floatbits(npy_uint16 b)
+{
+    return ((npy_uint32)b) << 16;
+}
+
+npy_uint64
+bfloat16bits_to_doublebits(npy_uint16 b)
+{
+    npy_uint16 b_exp, b_man;
+    npy_uint64 d_sgn = ((npy_uint64)(b&0x8000u)) << 48;
+    int e;
+
+    b_exp = (b&0x7f80u);
+    b_man = (b&0x007fu);
+    switch (b_exp) {
+        case 0x0000u: /* 0 or subnormal */
+            if (b_man == 0) {
+                return d_sgn;
+            }
+            /* Normalize it */
+            e = 1;
+            while ((b_man&0x0080u) == 0) {
+                b_man <<= 1;
+                e--;
+            }
+            b_man &= 0x007fu;
+            return d_sgn + (((npy_uint64)(e + 896)) << 52) +
+                           (((npy_uint64)b_man) << 45);
+        case 0x7f80u: /* inf or NaN */
+            /* All-ones exponent and a copy of the mantissa */
+            return d_sgn + 0x7ff0000000000000u + (((npy_uint64)b_man) << 45);
+        default: /* normalized */
+            return d_sgn + (((npy_uint64)(b_exp >> 7) + 896) << 52) +
+                           (((npy_uint64)b_man) << 45);
+    }
+}
+
+npy_uint16
+floatbits_to_bfloat16bits(npy_uint32 f)
+{
+    npy_uint32 f_rnd;
+
+    if ((f&0x7fffffffu) > 0x7f800000u) {
+        /* NaN - keep the top of the payload... */
+        npy_uint16 ret = (npy_uint16) (f >> 16);
+        /* ...but make sure it stays a NaN */
+        if ((ret&0x007fu) == 0) {
+            ret++;
+        }
+        return ret;
+    }
+#if HALF_GENERATE_UNDERFLOW
+    if ((f&0x7f800000u) == 0 && (f&0x007fffffu) != 0) {
+        half_raise_status(HALF_FPE_UNDERFLOW);
+    }
+#endif
+    /*
+     * Adding just under half of the dropped ulp, plus the last kept
+     * bit, rounds ties to even.  A carry out of the mantissa increments
+     * the exponent, up to inf at most.
+     */
+#if HALF_ROUND_TIES_TO_EVEN
+    f_rnd = f + 0x7fffu + ((f >> 16)&1u);
+#else
+    f_rnd = f + 0x8000u;
+#endif
+#if HALF_GENERATE_OVERFLOW
+    if ((f_rnd&0x7f800000u) == 0x7f800000u &&
+                                    (f&0x7f800000u) != 0x7f800000u) {
+        half_raise_status(HALF_FPE_OVERFLOW);
+    }
+#endif
+    return (npy_uint16) (f_rnd >> 16);
+}
+
+/*
+ * Rounds a double straight to bfloat16, as rounding to float first
+ * could round twice.
+ */
+npy_uint16
+doublebits_to_bfloat16bits(npy_uint64 d)
+{
+    npy_uint64 d_exp, d_man, rem, halfway;
+    npy_uint16 b_sgn;
+    int shift;
+
+    b_sgn = (npy_uint16) ((d&0x8000000000000000u) >> 48);
+    d_exp = (d&0x7ff0000000000000u) >> 52;
+    d_man = (d&0x000fffffffffffffu);
+
+    if (d_exp == 0x7ff) {
+        if (d_man != 0) {
+            /* NaN - propagate the flag in the mantissa... */
+            npy_uint16 ret = (npy_uint16) (0x7f80u + (d_man >> 45));
+            /* ...but make sure it stays a NaN */
+            if (ret == 0x7f80u) {
+                ret++;
+            }
+            return b_sgn + ret;
+        }
+        return b_sgn + 0x7f80u;
+    }
+
+    /* Exponents 897 to 1150 are normal bfloat16 exponents 1 to 254 */
+    if (d_exp >= 897) {
+        d_man += (d_exp - 896) << 52;
+#if HALF_ROUND_TIES_TO_EVEN
+        d_man += 0x00000fffffffffffu + ((d_man >> 45)&1u);
+#else
+        d_man += 0x0000100000000000u;
+#endif
+        d_man >>= 45;
+        if (d_man >= 0x7f80u) {
+#if HALF_GENERATE_OVERFLOW
+            half_raise_status(HALF_FPE_OVERFLOW);
+#endif
+            return b_sgn + 0x7f80u;
+        }
+        return b_sgn + (npy_uint16)d_man;
+    }
+
+    /* Everything else is a subnormal bfloat16, in units of 2^-133 */
+    if (d_exp == 0 && d_man == 0) {
+        return b_sgn;
+    }
+#if HALF_GENERATE_UNDERFLOW
+    half_raise_status(HALF_FPE_UNDERFLOW);
+#endif
+    if (d_exp == 0) {
+        d_exp = 1;
+    }
+    else {
+        d_man += 0x0010000000000000u;
+    }
+    shift = 942 - (int)d_exp;
+    if (shift > 54) {
+        /* less than half the smallest subnormal */
+        return b_sgn;
+    }
+    rem = d_man & ((((npy_uint64)1) << shift) - 1);
+    halfway = ((npy_uint64)1) << (shift - 1);
+    d_man >>= shift;
+#if HALF_ROUND_TIES_TO_EVEN
+    if (rem > halfway || (rem == halfway && (d_man&1u))) {
+        d_man++;
+    }
+#else
+    if (rem >= halfway) {
+        d_man++;
+    }
+#endif
+    /* Rounding up may carry into the smallest normal, which is right */
+    return b_sgn + (npy_uint16)d_man;
+}
+
+#if HALF_HAVE_X86_SIMD
+
+/*
+ * The SIMD narrowing does the rounding add of the scalar routine on
+ * every lane, then patches the NaN lanes.  The arithmetic shift keeps
+ * the result sign extended for the signed saturating packs.
+ */
+static HALF_SIMD_INLINE HALF_TARGET_SSE2 __m128i
+floatbits_to_bfloat16bits_sse2_4(__m128i f, __m128i *ovf, __m128i *unf)
+{
+    __m128i a, r, nan, man;
+
+    a = _mm_and_si128(f, _mm_set1_epi32(0x7fffffff));
+    r = _mm_add_epi32(f, _mm_add_epi32(_mm_set1_epi32(0x7fff),
+            _mm_and_si128(_mm_srli_epi32(f, 16), _mm_set1_epi32(1))));
+
+    nan = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x7f800000));
+    man = _mm_and_si128(f, _mm_set1_epi32(0x007f0000));
+    man = _mm_or_si128(f, _mm_and_si128(_mm_cmpeq_epi32(man,
+                _mm_setzero_si128()), _mm_set1_epi32(0x00010000)));
+    r = _mm_or_si128(_mm_and_si128(nan, man), _mm_andnot_si128(nan, r));
+
+    *ovf = _mm_or_si128(*ovf, _mm_and_si128(
+                _mm_cmpgt_epi32(a, _mm_set1_epi32(0x7f7f7fff)),
+                _mm_cmplt_epi32(a, _mm_set1_epi32(0x7f800000))));
+    *unf = _mm_or_si128(*unf, _mm_andnot_si128(
+                _mm_cmpeq_epi32(a, _mm_setzero_si128()),
+                _mm_cmplt_epi32(a, _mm_set1_epi32(0x00800000))));
+    return _mm_srai_epi32(r, 16);
+}
+
+static HALF_TARGET_SSE2 void
+floatbits_to_bfloat16bits_sse2(const npy_uint32 *f, npy_uint16 *b, npy_intp n)
+{
+    __m128i ovf = _mm_setzero_si128(), unf = _mm_setzero_si128();
+    __m128i r0, r1;
+    npy_intp i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        r0 = floatbits_to_bfloat16bits_sse2_4(
+                    _mm_loadu_si128((const __m128i *)(f + i)), &ovf, &unf);
+        r1 = floatbits_to_bfloat16bits_sse2_4(
+                    _mm_loadu_si128((const __m128i *)(f + i + 4)), &ovf, &unf);
+        _mm_storeu_si128((__m128i *)(b + i), _mm_packs_epi32(r0, r1));
+    }
+    half_raise_flags(_mm_movemask_epi8(ovf), _mm_movemask_epi8(unf));
+    for (; i < n; i++) {
+        b[i] = floatbits_to_bfloat16bits(f[i]);
+    }
+}
+
+static HALF_TARGET_SSE2 void
+bfloat16bits_to_floatbits_sse2(const npy_uint16 *b, npy_uint32 *f, npy_intp n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v;
+    npy_intp i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        v = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(f + i), _mm_unpacklo_epi16(zero, v));
+        _mm_storeu_si128((__m128i *)(f + i + 4), _mm_unpackhi_epi16(zero, v));
+    }
+    for (; i < n; i++) {
+        f[i] = bfloat16bits_to_floatbits(b[i]);
+    }
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m256i
+floatbits_to_bfloat16bits_avx2_8(__m256i f, __m256i *ovf, __m256i *unf)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i a, r, nan, man;
+
+    a = _mm256_and_si256(f, _mm256_set1_epi32(0x7fffffff));
+    r = _mm256_add_epi32(f, _mm256_add_epi32(_mm256_set1_epi32(0x7fff),
+            _mm256_and_si256(_mm256_srli_epi32(f, 16), _mm256_set1_epi32(1))));
+
+    nan = _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x7f800000));
+    man = _mm256_and_si256(f, _mm256_set1_epi32(0x007f0000));
+    man = _mm256_or_si256(f, _mm256_and_si256(_mm256_cmpeq_epi32(man, zero),
+                                              _mm256_set1_epi32(0x00010000)));
+    r = _mm256_blendv_epi8(r, man, nan);
+
+    *ovf = _mm256_or_si256(*ovf, _mm256_and_si256(
+                _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x7f7f7fff)),
+                _mm256_cmpgt_epi32(_mm256_set1_epi32(0x7f800000), a)));
+    *unf = _mm256_or_si256(*unf, _mm256_andnot_si256(
+                _mm256_cmpeq_epi32(a, zero),
+                _mm256_cmpgt_epi32(_mm256_set1_epi32(0x00800000), a)));
+    return _mm256_srai_epi32(r, 16);
+}
+
+static HALF_TARGET_AVX2 void
+floatbits_to_bfloat16bits_avx2(const npy_uint32 *f, npy_uint16 *b, npy_intp n)
+{
+    __m256i ovf = _mm256_setzero_si256(), unf = _mm256_setzero_si256();
+    __m256i r0, r1;
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        r0 = floatbits_to_bfloat16bits_avx2_8(
+                _mm256_loadu_si256((const __m256i *)(f + i)), &ovf, &unf);
+        r1 = floatbits_to_bfloat16bits_avx2_8(
+                _mm256_loadu_si256((const __m256i *)(f + i + 8)), &ovf, &unf);
+        _mm256_storeu_si256((__m256i *)(b + i), _mm256_permute4x64_epi64(
+                _mm256_packs_epi32(r0, r1), 0xd8));
+    }
+    half_raise_flags(!_mm256_testz_si256(ovf, ovf),
+                     !_mm256_testz_si256(unf, unf));
+    for (; i < n; i++) {
+        b[i] = floatbits_to_bfloat16bits(f[i]);
+    }
+}
+
+static HALF_TARGET_AVX2 void
+bfloat16bits_to_floatbits_avx2(const npy_uint16 *b, npy_uint32 *f, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i *)(f + i), _mm256_slli_epi32(
+                _mm256_cvtepu16_epi32(_mm_loadu_si128(
+                    (const __m128i *)(b + i))), 16));
+    }
+    for (; i < n; i++) {
+        f[i] = bfloat16bits_to_floatbits(b[i]);
+    }
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX512 __m256i
+floatbits_to_bfloat16bits_avx512_16(__m512i x, __mmask16 *ovf,
+                                    __mmask16 *unf)
+{
+    __mmask16 nan;
+    __m512i a, r, man;
+
+    a = _mm512_and_si512(x, _mm512_set1_epi32(0x7fffffff));
+    r = _mm512_add_epi32(x, _mm512_add_epi32(_mm512_set1_epi32(0x7fff),
+            _mm512_and_si512(_mm512_srli_epi32(x, 16), _mm512_set1_epi32(1))));
+    nan = _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(0x7f800000));
+    if (nan) {
+        man = _mm512_mask_or_epi32(x, _mm512_testn_epi32_mask(x,
+                        _mm512_set1_epi32(0x007f0000)),
+                    x, _mm512_set1_epi32(0x00010000));
+        r = _mm512_mask_mov_epi32(r, nan, man);
+    }
+    *ovf |= _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(0x7f7f7fff)) &
+            _mm512_cmplt_epi32_mask(a, _mm512_set1_epi32(0x7f800000));
+    *unf |= _mm512_cmplt_epi32_mask(a, _mm512_set1_epi32(0x00800000)) &
+            _mm512_cmpneq_epi32_mask(a, _mm512_setzero_si512());
+    return _mm512_cvtepi32_epi16(_mm512_srli_epi32(r, 16));
+}
+
+static HALF_TARGET_AVX512 void
+floatbits_to_bfloat16bits_avx512(const npy_uint32 *f, npy_uint16 *b,
+                                 npy_intp n)
+{
+    __mmask16 ovf = 0, unf = 0;
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        _mm256_storeu_si256((__m256i *)(b + i),
+                floatbits_to_bfloat16bits_avx512_16(
+                    _mm512_loadu_si512((const void *)(f + i)), &ovf, &unf));
+    }
+    half_raise_flags(ovf != 0, unf != 0);
+    for (; i < n; i++) {
+        b[i] = floatbits_to_bfloat16bits(f[i]);
+    }
+}
+
+static HALF_TARGET_AVX512 void
+bfloat16bits_to_floatbits_avx512(const npy_uint16 *b, npy_uint32 *f,
+                                 npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        _mm512_storeu_si512((void *)(f + i), _mm512_slli_epi32(
+                _mm512_cvtepu16_epi32(_mm256_loadu_si256(
+                    (const __m256i *)(b + i))), 16));
+    }
+    for (; i < n; i++) {
+        f[i] = bfloat16bits_to_floatbits(b[i]);
+    }
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+void
+floatbits_to_bfloat16bits_n(const npy_uint32 *f, npy_uint16 *b, npy_intp n)
+{
+    npy_intp i;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            floatbits_to_bfloat16bits_avx512(f, b, n);
+            return;
+        case HALF_SIMD_AVX2:
+            floatbits_to_bfloat16bits_avx2(f, b, n);
+            return;
+        case HALF_SIMD_SSE2:
+            floatbits_to_bfloat16bits_sse2(f, b, n);
+            return;
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                b[i] = floatbits_to_bfloat16bits(f[i]);
+            }
+    }
+}
+
+void
+bfloat16bits_to_floatbits_n(const npy_uint16 *b, npy_uint32 *f, npy_intp n)
+{
+    npy_intp i;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            bfloat16bits_to_floatbits_avx512(b, f, n);
+            return;
+        case HALF_SIMD_AVX2:
+            bfloat16bits_to_floatbits_avx2(b, f, n);
+            return;
+        case HALF_SIMD_SSE2:
+            bfloat16bits_to_floatbits_sse2(b, f, n);
+            return;
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                f[i] = bfloat16bits_to_floatbits(b[i]);
+            }
+    }
+}
+
+/*
+ * Direct bfloat16 <-> half conversions.  float32 holds both formats
+ * exactly, so the conversion widens to float32 bits in registers and
+ * rounds once: half to bfloat16 never overflows or underflows (the
+ * half subnormals are normal bfloat16s), bfloat16 to half raises the
+ * flags of floatbits_to_halfbits.  NaN payloads are kept.
+ */
+npy_uint16
+bfloat16bits_to_halfbits(npy_uint16 b)
+{
+    return floatbits_to_halfbits(bfloat16bits_to_floatbits(b));
+}
+
+npy_uint16
+halfbits_to_bfloat16bits(npy_uint16 h)
+{
+    return floatbits_to_bfloat16bits(halfbits_to_floatbits(h));
+}
+
+#if HALF_HAVE_X86_SIMD
+
+static HALF_TARGET_SSE2 void
+bfloat16bits_to_halfbits_sse2(const npy_uint16 *b, npy_uint16 *h, npy_intp n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i ovf = zero, unf = zero;
+    __m128i v, r0, r1;
+    npy_intp i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        v = _mm_loadu_si128((const __m128i *)(b + i));
+        r0 = floatbits_to_halfbits_sse2_4(_mm_unpacklo_epi16(zero, v),
+                                          &ovf, &unf);
+        r1 = floatbits_to_halfbits_sse2_4(_mm_unpackhi_epi16(zero, v),
+                                          &ovf, &unf);
+        _mm_storeu_si128((__m128i *)(h + i), _mm_packs_epi32(r0, r1));
+    }
+    half_raise_flags(_mm_movemask_epi8(ovf), _mm_movemask_epi8(unf));
+    for (; i < n; i++) {
+        h[i] = bfloat16bits_to_halfbits(b[i]);
+    }
+}
+
+static HALF_TARGET_SSE2 void
+halfbits_to_bfloat16bits_sse2(const npy_uint16 *h, npy_uint16 *b, npy_intp n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i ovf = zero, unf = zero;
+    __m128i v, r0, r1;
+    npy_intp i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        v = _mm_loadu_si128((const __m128i *)(h + i));
+        r0 = floatbits_to_bfloat16bits_sse2_4(halfbits_to_floatbits_sse2_4(
+                    _mm_unpacklo_epi16(v, zero)), &ovf, &unf);
+        r1 = floatbits_to_bfloat16bits_sse2_4(halfbits_to_floatbits_sse2_4(
+                    _mm_unpackhi_epi16(v, zero)), &ovf, &unf);
+        _mm_storeu_si128((__m128i *)(b + i), _mm_packs_epi32(r0, r1));
+    }
+    for (; i < n; i++) {
+        b[i] = halfbits_to_bfloat16bits(h[i]);
+    }
+}
+
+static HALF_TARGET_AVX2 void
+bfloat16bits_to_halfbits_avx2(const npy_uint16 *b, npy_uint16 *h, npy_intp n)
+{
+    __m256i ovf = _mm256_setzero_si256(), unf = _mm256_setzero_si256();
+    __m256i v;
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        v = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm_storeu_si128((__m128i *)(h + i), floatbits_to_halfbits_avx2_8(
+                _mm256_slli_epi32(_mm256_cvtepu16_epi32(
+                    _mm256_castsi256_si128(v)), 16), &ovf, &unf));
+        _mm_storeu_si128((__m128i *)(h + i + 8), floatbits_to_halfbits_avx2_8(
+                _mm256_slli_epi32(_mm256_cvtepu16_epi32(
+                    _mm256_extracti128_si256(v, 1)), 16), &ovf, &unf));
+    }
+    half_raise_flags(!_mm256_testz_si256(ovf, ovf),
+                     !_mm256_testz_si256(unf, unf));
+    for (; i < n; i++) {
+        h[i] = bfloat16bits_to_halfbits(b[i]);
+    }
+}
+
+static HALF_TARGET_AVX2 void
+halfbits_to_bfloat16bits_avx2(const npy_uint16 *h, npy_uint16 *b, npy_intp n)
+{
+    __m256i ovf = _mm256_setzero_si256(), unf = _mm256_setzero_si256();
+    __m256i r0, r1;
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        r0 = floatbits_to_bfloat16bits_avx2_8(halfbits_to_floatbits_avx2_8(
+                _mm_loadu_si128((const __m128i *)(h + i))), &ovf, &unf);
+        r1 = floatbits_to_bfloat16bits_avx2_8(halfbits_to_floatbits_avx2_8(
+                _mm_loadu_si128((const __m128i *)(h + i + 8))), &ovf, &unf);
+        _mm256_storeu_si256((__m256i *)(b + i), _mm256_permute4x64_epi64(
+                _mm256_packs_epi32(r0, r1), 0xd8));
+    }
+    for (; i < n; i++) {
+        b[i] = halfbits_to_bfloat16bits(h[i]);
+    }
+}
+
+static HALF_TARGET_AVX512 void
+bfloat16bits_to_halfbits_avx512(const npy_uint16 *b, npy_uint16 *h,
+                                npy_intp n)
+{
+    __mmask16 ovf = 0, unf = 0;
+    __m512i v;
+    npy_intp i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        v = _mm512_loadu_si512((const void *)(b + i));
+        _mm256_storeu_si256((__m256i *)(h + i), floatbits_to_halfbits_avx512_16(
+                _mm512_slli_epi32(_mm512_cvtepu16_epi32(
+                    _mm512_castsi512_si256(v)), 16), &ovf, &unf));
+        _mm256_storeu_si256((__m256i *)(h + i + 16),
+                floatbits_to_halfbits_avx512_16(
+                    _mm512_slli_epi32(_mm512_cvtepu16_epi32(
+                        _mm512_extracti64x4_epi64(v, 1)), 16), &ovf, &unf));
+    }
+    half_raise_flags(ovf != 0, unf != 0);
+    for (; i < n; i++) {
+        h[i] = bfloat16bits_to_halfbits(b[i]);
+    }
+}
+
+static HALF_TARGET_AVX512 void
+halfbits_to_bfloat16bits_avx512(const npy_uint16 *h, npy_uint16 *b,
+                                npy_intp n)
+{
+    __mmask16 ovf = 0, unf = 0;
+    npy_intp i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        _mm256_storeu_si256((__m256i *)(b + i),
+                floatbits_to_bfloat16bits_avx512_16(
+                    halfbits_to_floatbits_avx512_16(_mm256_loadu_si256(
+                        (const __m256i *)(h + i))), &ovf, &unf));
+        _mm256_storeu_si256((__m256i *)(b + i + 16),
+                floatbits_to_bfloat16bits_avx512_16(
+                    halfbits_to_floatbits_avx512_16(_mm256_loadu_si256(
+                        (const __m256i *)(h + i + 16))), &ovf, &unf));
+    }
+    for (; i < n; i++) {
+        b[i] = halfbits_to_bfloat16bits(h[i]);
+    }
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+void
+bfloat16bits_to_halfbits_n(const npy_uint16 *b, npy_uint16 *h, npy_intp n)
+{
+    npy_intp i;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            bfloat16bits_to_halfbits_avx512(b, h, n);
+            return;
+        case HALF_SIMD_AVX2:
+            bfloat16bits_to_halfbits_avx2(b, h, n);
+            return;
+        case HALF_SIMD_SSE2:
+            bfloat16bits_to_halfbits_sse2(b, h, n);
+            return;
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                h[i] = bfloat16bits_to_halfbits(b[i]);
+            }
+    }
+}
+
+void
+halfbits_to_bfloat16bits_n(const npy_uint16 *h, npy_uint16 *b, npy_intp n)
+{
+    const npy_uint32 *table;
+    npy_intp i;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            halfbits_to_bfloat16bits_avx512(h, b, n);
+            return;
+        case HALF_SIMD_AVX2:
+            halfbits_to_bfloat16bits_avx2(h, b, n);
+            return;
+        case HALF_SIMD_SSE2:
+            halfbits_to_bfloat16bits_sse2(h, b, n);
+            return;
+#endif
+        default:
+            table = half_float_table();
+            for (i = 0; i < n; i++) {
+                b[i] = floatbits_to_bfloat16bits(
+                        table ? table[h[i]] : halfbits_to_floatbits(h[i]));
+            }
+    }
+}
+
+/*
+ ********************************************************************
+ *                     FP8 CONVERSIONS                              *
+ ********************************************************************
+ */
+
+/*
+ * The OCP 8-bit formats.  E4M3 (bias 7) has no infinities and a single
+ * NaN pattern, S.1111.111, its largest value is 448.  E5M2 (bias 15) is
+ * the top byte of a half, with infinities and NaNs.  Narrowing rounds to
+ * nearest even.  A finite value out of range gives NaN (E4M3) or inf
+ * (E5M2) and raises overflow, or saturates to the largest finite value
+ * without a flag; infinities are treated the same way.  Underflow is
+ * raised for nonzero values in the subnormal range, as for halves.
+ *
+ * Both are narrowed from float32 by one generic routine, parametrised
+ * on the format, which the compiler specializes.  Halves are widened to
+ * float32 first, which is exact, so they are also rounded only once.
+ */
+#define FP8_SHIFT(e5m2)   ((e5m2) ? 21 : 20)           /* dropped bits */
+#define FP8_REBIAS(e5m2)  ((e5m2) ? 0x38000000u : 0x3c000000u)
+#define FP8_NORMAL(e5m2)  ((e5m2) ? 0x38800000u : 0x3c800000u)
+#define FP8_UNIT(e5m2)    ((e5m2) ? 134 : 141)  /* 150 + log2(min subnormal) */
+#define FP8_MAX(e5m2)     ((e5m2) ? 0x7bu : 0x7eu)
+#define FP8_OVERFLOW(e5m2) ((e5m2) ? 0x7cu : 0x7fu)
+/* The largest float that does not round past the largest finite value */
+#define FP8_LIMIT(e5m2)   ((e5m2) ? 0x476fffffu : 0x43e80000u)
+
+static NPY_INLINE npy_uint8
+floatbits_to_fp8bits(npy_uint32 f, int e5m2, int saturate, int *status)
+{
+    npy_uint32 a = f&0x7fffffffu, r, rem, halfway;
+    npy_uint8 sgn = (npy_uint8) ((f >> 24)&0x80u);
+    int shift;
+
+    if (a > 0x7f800000u) {
+        if (e5m2) {
+            /* NaN - keep the top of the payload, but stay a NaN */
+            r = (a >> 21)&0x3u;
+            return sgn + 0x7cu + (r ? r : 1);
+        }
+        return sgn + 0x7fu;
+    }
+    if (a == 0x7f800000u) {
+        return sgn + (saturate ? FP8_MAX(e5m2) : FP8_OVERFLOW(e5m2));
+    }
+    if (a >= FP8_NORMAL(e5m2)) {
+        r = a - FP8_REBIAS(e5m2);
+        shift = FP8_SHIFT(e5m2);
+#if HALF_ROUND_TIES_TO_EVEN
+        r += (1u << (shift - 1)) - 1 + ((r >> shift)&1u);
+#else
+        r += 1u << (shift - 1);
+#endif
+        r >>= shift;
+        if (r > FP8_MAX(e5m2)) {
+            if (saturate) {
+                return sgn + FP8_MAX(e5m2);
+            }
+            *status |= HALF_FPE_OVERFLOW;
+            return sgn + FP8_OVERFLOW(e5m2);
+        }
+        return sgn + (npy_uint8)r;
+    }
+
+    /* A subnormal or zero result, in units of the smallest subnormal */
+    if (a == 0) {
+        return sgn;
+    }
+    *status |= HALF_FPE_UNDERFLOW;
+    shift = FP8_UNIT(e5m2) - (int)(a >> 23);
+    if ((a >> 23) == 0 || shift > 24) {
+        /* less than half the smallest subnormal */
+        return sgn;
+    }
+    r = (a&0x007fffffu) + 0x00800000u;
+    rem = r & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+    r >>= shift;
+#if HALF_ROUND_TIES_TO_EVEN
+    if (rem > halfway || (rem == halfway && (r&1u))) {
+        r++;
+    }
+#else
+    if (rem >= halfway) {
+        r++;
+    }
+#endif
+    /* Rounding up may carry into the smallest normal, which is right */
+    return sgn + (npy_uint8)r;
+}
+
+npy_uint8
+floatbits_to_e4m3bits(npy_uint32 f, int saturate)
+{
+    int status = 0;
+    npy_uint8 b = floatbits_to_fp8bits(f, 0, saturate, &status);
+
+    half_raise_status(status);
+    return b;
+}
+
+npy_uint8
+floatbits_to_e5m2bits(npy_uint32 f, int saturate)
+{
+    int status = 0;
+    npy_uint8 b = floatbits_to_fp8bits(f, 1, saturate, &status);
+
+    half_raise_status(status);
+    return b;
+}
+
+npy_uint8
+halfbits_to_e4m3bits(npy_uint16 h, int saturate)
+{
+    int status = 0;
+    npy_uint8 b = floatbits_to_fp8bits(halfbits_to_floatbits(h), 0,
+                                       saturate, &status);
+
+    half_raise_status(status);
+    return b;
+}
+
+npy_uint8
+halfbits_to_e5m2bits(npy_uint16 h, int saturate)
+{
+    int status = 0;
+    npy_uint8 b = floatbits_to_fp8bits(halfbits_to_floatbits(h), 1,
+                                       saturate, &status);
+
+    half_raise_status(status);
+    return b;
+}
+
+/* The decoders are inlined into the scalar bulk loops */
+static NPY_INLINE npy_uint32
+e4m3_to_floatbits(npy_uint8 b)
+{
+    npy_uint32 f_sgn = ((npy_uint32)(b&0x80u)) << 24;
+    npy_uint32 b_mag = b&0x7fu;
+    int p;
+
+    if (b_mag == 0x7fu) {
+        return f_sgn + 0x7fc00000u;
+    }
+    if (b_mag >= 0x08u) {
+        return f_sgn + (b_mag << 20) + FP8_REBIAS(0);
+    }
+    if (b_mag == 0) {
+        return f_sgn;
+    }
+    /* Subnormal, b_mag * 2^-9, normalize it */
+    p = (b_mag >= 4) ? 2 : (b_mag >= 2) ? 1 : 0;
+    return f_sgn + (((npy_uint32)(118 + p)) << 23) +
+                   ((b_mag << (23 - p))&0x007fffffu);
+}
+
+/* Every E4M3 value is a normal half, or zero */
+static NPY_INLINE npy_uint16
+e4m3_to_halfbits(npy_uint8 b)
+{
+    npy_uint16 h_sgn = (npy_uint16)((b&0x80u) << 8);
+    npy_uint16 b_mag = b&0x7fu;
+    int p;
+
+    if (b_mag == 0x7fu) {
+        return h_sgn + 0x7e00u;
+    }
+    if (b_mag >= 0x08u) {
+        return h_sgn + (b_mag << 7) + 0x2000u;
+    }
+    if (b_mag == 0) {
+        return h_sgn;
+    }
+    p = (b_mag >= 4) ? 2 : (b_mag >= 2) ? 1 : 0;
+    return h_sgn + ((6 + p) << 10) + ((b_mag << (10 - p))&0x03ffu);
+}
+
+npy_uint32
+e4m3bits_to_floatbits(npy_uint8 b)
+{
+    return e4m3_to_floatbits(b);
+}
+
+npy_uint32
+e5m2bits_to_floatbits(npy_uint8 b)
+{
+    return halfbits_to_floatbits((npy_uint16)(b << 8));
+}
+
+npy_uint16
+e4m3bits_to_halfbits(npy_uint8 b)
+{
+    return e4m3_to_halfbits(b);
+}
+
+npy_uint16
+e5m2bits_to_halfbits(npy_uint8 b)
+{
+    return (npy_uint16)(b << 8);
+}
+
+#if HALF_HAVE_X86_SIMD
+
+/*
+ * Float to FP8, the scalar routine on 8 lanes.  Subnormal results are
+ * rounded by the FPU, by adding a float whose ulp is the smallest
+ * subnormal, as in floatbits_to_halfbits_sse2_4.
+ */
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m256i
+floatbits_to_fp8bits_avx2_8(__m256i f, int e5m2, int saturate,
+                            __m256i *ovf, __m256i *unf)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m128i shift = _mm_cvtsi32_si128(FP8_SHIFT(e5m2));
+    const float magic = e5m2 ? 128.0f : 16384.0f;
+    __m256i a, sgn, r, sub, tiny, over, nan, man;
+
+    a = _mm256_and_si256(f, _mm256_set1_epi32(0x7fffffff));
+    sgn = _mm256_and_si256(_mm256_srli_epi32(f, 24), _mm256_set1_epi32(0x80));
+
+    r = _mm256_sub_epi32(a, _mm256_set1_epi32(FP8_REBIAS(e5m2)));
+    r = _mm256_add_epi32(r, _mm256_add_epi32(
+            _mm256_set1_epi32((1 << (FP8_SHIFT(e5m2) - 1)) - 1),
+            _mm256_and_si256(_mm256_srl_epi32(r, shift),
+                             _mm256_set1_epi32(1))));
+    r = _mm256_srl_epi32(r, shift);
+
+    tiny = _mm256_cmpgt_epi32(_mm256_set1_epi32(FP8_NORMAL(e5m2)), a);
+    sub = _mm256_castps_si256(_mm256_add_ps(_mm256_castsi256_ps(
+                _mm256_and_si256(tiny, a)), _mm256_set1_ps(magic)));
+    sub = _mm256_sub_epi32(sub, _mm256_castps_si256(_mm256_set1_ps(magic)));
+    r = _mm256_blendv_epi8(r, sub, tiny);
+
+    over = _mm256_cmpgt_epi32(a, _mm256_set1_epi32(FP8_LIMIT(e5m2)));
+    r = _mm256_blendv_epi8(r, _mm256_set1_epi32(saturate ? FP8_MAX(e5m2)
+                                                : FP8_OVERFLOW(e5m2)), over);
+    nan = _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x7f800000));
+    if (e5m2) {
+        man = _mm256_and_si256(_mm256_srli_epi32(a, 21), _mm256_set1_epi32(3));
+        man = _mm256_sub_epi32(man, _mm256_cmpeq_epi32(man, zero));
+        man = _mm256_or_si256(man, _mm256_set1_epi32(0x7c));
+    }
+    else {
+        man = _mm256_set1_epi32(0x7f);
+    }
+    r = _mm256_blendv_epi8(r, man, nan);
+
+    if (!saturate) {
+        *ovf = _mm256_or_si256(*ovf, _mm256_and_si256(over,
+                    _mm256_cmpgt_epi32(_mm256_set1_epi32(0x7f800000), a)));
+    }
+    *unf = _mm256_or_si256(*unf, _mm256_andnot_si256(
+                _mm256_cmpeq_epi32(a, zero), tiny));
+    return _mm256_or_si256(r, sgn);
+}
+
+/* The low bytes of 8 32-bit lanes */
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m128i
+fp8_pack_avx2(__m256i r)
+{
+    r = _mm256_shuffle_epi8(r, _mm256_setr_epi8(
+            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    r = _mm256_permutevar8x32_epi32(r, _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1));
+    return _mm256_castsi256_si128(r);
+}
+
+/* E4M3 to float, subnormals are converted from integers and scaled */
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m256i
+e4m3bits_to_floatbits_avx2_8(__m256i b)
+{
+    __m256i mag, r, sub;
+
+    mag = _mm256_and_si256(b, _mm256_set1_epi32(0x7f));
+    r = _mm256_add_epi32(_mm256_slli_epi32(mag, 20),
+                         _mm256_set1_epi32(FP8_REBIAS(0)));
+    sub = _mm256_castps_si256(_mm256_mul_ps(_mm256_cvtepi32_ps(mag),
+                                            _mm256_set1_ps(1.0f/512)));
+    r = _mm256_blendv_epi8(r, sub, _mm256_cmpgt_epi32(
+                _mm256_set1_epi32(8), mag));
+    r = _mm256_blendv_epi8(r, _mm256_set1_epi32(0x7fc00000),
+                _mm256_cmpeq_epi32(mag, _mm256_set1_epi32(0x7f)));
+    return _mm256_or_si256(r, _mm256_slli_epi32(
+                _mm256_and_si256(b, _mm256_set1_epi32(0x80)), 24));
+}
+
+static HALF_TARGET_AVX2 void
+floatbits_to_fp8bits_avx2(const npy_uint32 *f, npy_uint8 *b, npy_intp n,
+                          int e5m2, int saturate)
+{
+    __m256i ovf = _mm256_setzero_si256(), unf = _mm256_setzero_si256();
+    npy_intp i;
+    int status = 0;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        _mm_storel_epi64((__m128i *)(b + i), fp8_pack_avx2(
+                floatbits_to_fp8bits_avx2_8(_mm256_loadu_si256(
+                    (const __m256i *)(f + i)), e5m2, saturate, &ovf, &unf)));
+    }
+    for (; i < n; i++) {
+        b[i] = floatbits_to_fp8bits(f[i], e5m2, saturate, &status);
+    }
+    half_raise_status(status | half_flags_status(
+            !_mm256_testz_si256(ovf, ovf), !_mm256_testz_si256(unf, unf)));
+}
+
+static HALF_TARGET_AVX2 void
+halfbits_to_fp8bits_avx2(const npy_uint16 *h, npy_uint8 *b, npy_intp n,
+                         int e5m2, int saturate)
+{
+    __m256i ovf = _mm256_setzero_si256(), unf = _mm256_setzero_si256();
+    npy_intp i;
+    int status = 0;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        _mm_storel_epi64((__m128i *)(b + i), fp8_pack_avx2(
+                floatbits_to_fp8bits_avx2_8(halfbits_to_floatbits_avx2_8(
+                    _mm_loadu_si128((const __m128i *)(h + i))),
+                    e5m2, saturate, &ovf, &unf)));
+    }
+    for (; i < n; i++) {
+        b[i] = floatbits_to_fp8bits(halfbits_to_floatbits(h[i]),
+                                    e5m2, saturate, &status);
+    }
+    half_raise_status(status | half_flags_status(
+            !_mm256_testz_si256(ovf, ovf), !_mm256_testz_si256(unf, unf)));
+}
+
+static HALF_TARGET_AVX2 void
+e4m3bits_to_floatbits_avx2(const npy_uint8 *b, npy_uint32 *f, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i *)(f + i), e4m3bits_to_floatbits_avx2_8(
+                _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+                    (const __m128i *)(b + i)))));
+    }
+    for (; i < n; i++) {
+        f[i] = e4m3_to_floatbits(b[i]);
+    }
+}
+
+/*
+ * E4M3 to half on 16-bit lanes.  The seven subnormals are normal halves
+ * with a zero low byte, their high bytes are looked up with a shuffle.
+ */
+static HALF_SIMD_INLINE HALF_TARGET_AVX2 __m256i
+e4m3bits_to_halfbits_avx2_16(__m256i b)
+{
+    const __m256i sub = _mm256_setr_epi8(
+            0, 0x18, 0x1c, 0x1e, 0x20, 0x21, 0x22, 0x23, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0x18, 0x1c, 0x1e, 0x20, 0x21, 0x22, 0x23, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m256i mag, r;
+
+    mag = _mm256_and_si256(b, _mm256_set1_epi16(0x7f));
+    r = _mm256_add_epi16(_mm256_slli_epi16(mag, 7), _mm256_set1_epi16(0x2000));
+    r = _mm256_blendv_epi8(r, _mm256_slli_epi16(_mm256_shuffle_epi8(sub, mag), 8),
+                           _mm256_cmpgt_epi16(_mm256_set1_epi16(8), mag));
+    r = _mm256_blendv_epi8(r, _mm256_set1_epi16(0x7e00),
+                           _mm256_cmpeq_epi16(mag, _mm256_set1_epi16(0x7f)));
+    return _mm256_or_si256(r, _mm256_slli_epi16(
+                _mm256_and_si256(b, _mm256_set1_epi16(0x80)), 8));
+}
+
+static HALF_TARGET_AVX2 void
+e4m3bits_to_halfbits_avx2(const npy_uint8 *b, npy_uint16 *h, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        _mm256_storeu_si256((__m256i *)(h + i), e4m3bits_to_halfbits_avx2_16(
+                _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                    (const __m128i *)(b + i)))));
+    }
+    for (; i < n; i++) {
+        h[i] = e4m3_to_halfbits(b[i]);
+    }
+}
+
+static HALF_TARGET_AVX2 void
+e5m2bits_to_floatbits_avx2(const npy_uint8 *b, npy_uint32 *f, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i *)(f + i), halfbits_to_floatbits_avx2_8(
+                _mm_slli_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64(
+                    (const __m128i *)(b + i))), 8)));
+    }
+    for (; i < n; i++) {
+        f[i] = e5m2bits_to_floatbits(b[i]);
+    }
+}
+
+static HALF_TARGET_AVX2 void
+e5m2bits_to_halfbits_avx2(const npy_uint8 *b, npy_uint16 *h, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        _mm256_storeu_si256((__m256i *)(h + i), _mm256_slli_epi16(
+                _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                    (const __m128i *)(b + i))), 8));
+    }
+    for (; i < n; i++) {
+        h[i] = (npy_uint16)(b[i] << 8);
+    }
+}
+
+/* Float to FP8, AVX-512.  Same scheme as the AVX2 kernel, 16 lanes. */
+static HALF_SIMD_INLINE HALF_TARGET_AVX512 __m128i
+floatbits_to_fp8bits_avx512_16(__m512i f, int e5m2, int saturate,
+                               __mmask16 *ovf, __mmask16 *unf)
+{
+    const float magic = e5m2 ? 128.0f : 16384.0f;
+    __m512i a, r, sub, man;
+    __mmask16 tiny, over, nan;
+
+    a = _mm512_and_si512(f, _mm512_set1_epi32(0x7fffffff));
+    r = _mm512_sub_epi32(a, _mm512_set1_epi32(FP8_REBIAS(e5m2)));
+    r = _mm512_add_epi32(r, _mm512_add_epi32(
+            _mm512_set1_epi32((1 << (FP8_SHIFT(e5m2) - 1)) - 1),
+            _mm512_and_si512(_mm512_srli_epi32(r, FP8_SHIFT(e5m2)),
+                             _mm512_set1_epi32(1))));
+    r = _mm512_srli_epi32(r, FP8_SHIFT(e5m2));
+
+    tiny = _mm512_cmplt_epi32_mask(a, _mm512_set1_epi32(FP8_NORMAL(e5m2)));
+    sub = _mm512_castps_si512(_mm512_add_ps(_mm512_castsi512_ps(
+                _mm512_maskz_mov_epi32(tiny, a)), _mm512_set1_ps(magic)));
+    sub = _mm512_sub_epi32(sub, _mm512_castps_si512(_mm512_set1_ps(magic)));
+    r = _mm512_mask_mov_epi32(r, tiny, sub);
+
+    over = _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(FP8_LIMIT(e5m2)));
+    r = _mm512_mask_mov_epi32(r, over, _mm512_set1_epi32(
+                saturate ? FP8_MAX(e5m2) : FP8_OVERFLOW(e5m2)));
+    nan = _mm512_cmpgt_epi32_mask(a, _mm512_set1_epi32(0x7f800000));
+    if (nan) {
+        if (e5m2) {
+            man = _mm512_and_si512(_mm512_srli_epi32(a, 21),
+                                   _mm512_set1_epi32(3));
+            man = _mm512_mask_mov_epi32(man, _mm512_testn_epi32_mask(man, man),
+                                        _mm512_set1_epi32(1));
+            man = _mm512_or_si512(man, _mm512_set1_epi32(0x7c));
+        }
+        else {
+            man = _mm512_set1_epi32(0x7f);
+        }
+        r = _mm512_mask_mov_epi32(r, nan, man);
+    }
+
+    if (!saturate) {
+        *ovf |= over & _mm512_cmplt_epi32_mask(a,
+                                    _mm512_set1_epi32(0x7f800000));
+    }
+    *unf |= tiny & _mm512_test_epi32_mask(a, a);
+    r = _mm512_or_si512(r, _mm512_and_si512(_mm512_srli_epi32(f, 24),
+                                            _mm512_set1_epi32(0x80)));
+    return _mm512_cvtepi32_epi8(r);
+}
+
+static HALF_SIMD_INLINE HALF_TARGET_AVX512 __m512i
+e4m3bits_to_floatbits_avx512_16(__m512i b)
+{
+    __m512i mag, r, sub;
+
+    mag = _mm512_and_si512(b, _mm512_set1_epi32(0x7f));
+    r = _mm512_add_epi32(_mm512_slli_epi32(mag, 20),
+                         _mm512_set1_epi32(FP8_REBIAS(0)));
+    sub = _mm512_castps_si512(_mm512_mul_ps(_mm512_cvtepi32_ps(mag),
+                                            _mm512_set1_ps(1.0f/512)));
+    r = _mm512_mask_mov_epi32(r, _mm512_cmplt_epi32_mask(mag,
+                                        _mm512_set1_epi32(8)), sub);
+    r = _mm512_mask_mov_epi32(r, _mm512_cmpeq_epi32_mask(mag,
+                                        _mm512_set1_epi32(0x7f)),
+                              _mm512_set1_epi32(0x7fc00000));
+    return _mm512_or_si512(r, _mm512_slli_epi32(
+                _mm512_and_si512(b, _mm512_set1_epi32(0x80)), 24));
+}
+
+static HALF_TARGET_AVX512 void
+floatbits_to_fp8bits_avx512(const npy_uint32 *f, npy_uint8 *b, npy_intp n,
+                            int e5m2, int saturate)
+{
+    __mmask16 ovf = 0, unf = 0;
+    npy_intp i;
+    int status = 0;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        _mm_storeu_si128((__m128i *)(b + i), floatbits_to_fp8bits_avx512_16(
+                _mm512_loadu_si512((const void *)(f + i)),
+                e5m2, saturate, &ovf, &unf));
+    }
+    for (; i < n; i++) {
+        b[i] = floatbits_to_fp8bits(f[i], e5m2, saturate, &status);
+    }
+    half_raise_status(status | half_flags_status(ovf != 0, unf != 0));
+}
+
+static HALF_TARGET_AVX512 void
+halfbits_to_fp8bits_avx512(const npy_uint16 *h, npy_uint8 *b, npy_intp n,
+                           int e5m2, int saturate)
+{
+    __mmask16 ovf = 0, unf = 0;
+    npy_intp i;
+    int status = 0;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        _mm_storeu_si128((__m128i *)(b + i), floatbits_to_fp8bits_avx512_16(
+                halfbits_to_floatbits_avx512_16(_mm256_loadu_si256(
+                    (const __m256i *)(h + i))), e5m2, saturate, &ovf, &unf));
+    }
+    for (; i < n; i++) {
+        b[i] = floatbits_to_fp8bits(halfbits_to_floatbits(h[i]),
+                                    e5m2, saturate, &status);
+    }
+    half_raise_status(status | half_flags_status(ovf != 0, unf != 0));
+}
+
+static HALF_TARGET_AVX512 void
+e4m3bits_to_floatbits_avx512(const npy_uint8 *b, npy_uint32 *f, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        _mm512_storeu_si512((void *)(f + i), e4m3bits_to_floatbits_avx512_16(
+                _mm512_cvtepu8_epi32(_mm_loadu_si128(
+                    (const __m128i *)(b + i)))));
+    }
+    for (; i < n; i++) {
+        f[i] = e4m3_to_floatbits(b[i]);
+    }
+}
+
+static HALF_TARGET_AVX512 void
+e4m3bits_to_halfbits_avx512(const npy_uint8 *b, npy_uint16 *h, npy_intp n)
+{
+    const __m512i sub = _mm512_broadcast_i32x4(_mm_setr_epi8(
+            0, 0x18, 0x1c, 0x1e, 0x20, 0x21, 0x22, 0x23, 0, 0, 0, 0, 0, 0, 0, 0));
+    __m512i x, mag, r;
+    npy_intp i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        x = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)(b + i)));
+        mag = _mm512_and_si512(x, _mm512_set1_epi16(0x7f));
+        r = _mm512_add_epi16(_mm512_slli_epi16(mag, 7),
+                             _mm512_set1_epi16(0x2000));
+        r = _mm512_mask_mov_epi16(r, _mm512_cmplt_epi16_mask(mag,
+                    _mm512_set1_epi16(8)),
+                _mm512_slli_epi16(_mm512_shuffle_epi8(sub, mag), 8));
+        r = _mm512_mask_mov_epi16(r, _mm512_cmpeq_epi16_mask(mag,
+                    _mm512_set1_epi16(0x7f)), _mm512_set1_epi16(0x7e00));
+        r = _mm512_or_si512(r, _mm512_slli_epi16(
+                _mm512_and_si512(x, _mm512_set1_epi16(0x80)), 8));
+        _mm512_storeu_si512((void *)(h + i), r);
+    }
+    for (; i < n; i++) {
+        h[i] = e4m3_to_halfbits(b[i]);
+    }
+}
+
+static HALF_TARGET_AVX512 void
+e5m2bits_to_floatbits_avx512(const npy_uint8 *b, npy_uint32 *f, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        _mm512_storeu_si512((void *)(f + i), halfbits_to_floatbits_avx512_16(
+                _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(
+                    (const __m128i *)(b + i))), 8)));
+    }
+    for (; i < n; i++) {
+        f[i] = e5m2bits_to_floatbits(b[i]);
+    }
+}
+
+static HALF_TARGET_AVX512 void
+e5m2bits_to_halfbits_avx512(const npy_uint8 *b, npy_uint16 *h, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        _mm512_storeu_si512((void *)(h + i), _mm512_slli_epi16(
+                _mm512_cvtepu8_epi16(_mm256_loadu_si256(
+                    (const __m256i *)(b + i))), 8));
+    }
+    for (; i < n; i++) {
+        h[i] = (npy_uint16)(b[i] << 8);
+    }
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+/*
+ * The FP8 dispatchers.  There are no SSE2 kernels, the SSE2 level uses
+ * the scalar routines.
+ */
+static void
+floatbits_to_fp8bits_n(const npy_uint32 *f, npy_uint8 *b, npy_intp n,
+                       int e5m2, int saturate)
+{
+    npy_intp i;
+    int status = 0;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            floatbits_to_fp8bits_avx512(f, b, n, e5m2, saturate);
+            return;
+        case HALF_SIMD_AVX2:
+            floatbits_to_fp8bits_avx2(f, b, n, e5m2, saturate);
+            return;
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                b[i] = floatbits_to_fp8bits(f[i], e5m2, saturate, &status);
+            }
+            half_raise_status(status);
+    }
+}
+
+static void
+halfbits_to_fp8bits_n(const npy_uint16 *h, npy_uint8 *b, npy_intp n,
+                      int e5m2, int saturate)
+{
+    const npy_uint32 *table;
+    npy_intp i;
+    int status = 0;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            halfbits_to_fp8bits_avx512(h, b, n, e5m2, saturate);
+            return;
+        case HALF_SIMD_AVX2:
+            halfbits_to_fp8bits_avx2(h, b, n, e5m2, saturate);
+            return;
+#endif
+        default:
+            table = half_float_table();
+            for (i = 0; i < n; i++) {
+                b[i] = floatbits_to_fp8bits(table ? table[h[i]]
+                                : halfbits_to_floatbits(h[i]), e5m2, saturate,
+                                &status);
+            }
+            half_raise_status(status);
+    }
+}
+
+void
+floatbits_to_e4m3bits_n(const npy_uint32 *f, npy_uint8 *b, npy_intp n,
+                        int saturate)
+{
+    floatbits_to_fp8bits_n(f, b, n, 0, saturate);
+}
+
+void
+floatbits_to_e5m2bits_n(const npy_uint32 *f, npy_uint8 *b, npy_intp n,
+                        int saturate)
+{
+    floatbits_to_fp8bits_n(f, b, n, 1, saturate);
+}
+
+void
+halfbits_to_e4m3bits_n(const npy_uint16 *h, npy_uint8 *b, npy_intp n,
+                       int saturate)
+{
+    halfbits_to_fp8bits_n(h, b, n, 0, saturate);
+}
+
+void
+halfbits_to_e5m2bits_n(const npy_uint16 *h, npy_uint8 *b, npy_intp n,
+                       int saturate)
+{
+    halfbits_to_fp8bits_n(h, b, n, 1, saturate);
+}
+
+void
+e4m3bits_to_floatbits_n(const npy_uint8 *b, npy_uint32 *f, npy_intp n)
+{
+    npy_intp i;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            e4m3bits_to_floatbits_avx512(b, f, n);
+            return;
+        case HALF_SIMD_AVX2:
+            e4m3bits_to_floatbits_avx2(b, f, n);
+            return;
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                f[i] = e4m3_to_floatbits(b[i]);
+            }
+    }
+}
+
+void
+e5m2bits_to_floatbits_n(const npy_uint8 *b, npy_uint32 *f, npy_intp n)
+{
+    const npy_uint32 *table;
+    npy_intp i;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            e5m2bits_to_floatbits_avx512(b, f, n);
+            return;
+        case HALF_SIMD_AVX2:
+            e5m2bits_to_floatbits_avx2(b, f, n);
+            return;
+#endif
+        default:
+            table = half_float_table();
+            for (i = 0; i < n; i++) {
+                f[i] = table ? table[b[i] << 8] : e5m2bits_to_floatbits(b[i]);
+            }
+    }
+}
+
+void
+e4m3bits_to_halfbits_n(const npy_uint8 *b, npy_uint16 *h, npy_intp n)
+{
+    npy_intp i;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            e4m3bits_to_halfbits_avx512(b, h, n);
+            return;
+        case HALF_SIMD_AVX2:
+            e4m3bits_to_halfbits_avx2(b, h, n);
+            return;
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                h[i] = e4m3_to_halfbits(b[i]);
+            }
+    }
+}
+
+void
+e5m2bits_to_halfbits_n(const npy_uint8 *b, npy_uint16 *h, npy_intp n)
+{
+    npy_intp i;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            e5m2bits_to_halfbits_avx512(b, h, n);
+            return;
+        case HALF_SIMD_AVX2:
+            e5m2bits_to_halfbits_avx2(b, h, n);
+            return;
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                h[i] = (npy_uint16)(b[i] << 8);
+            }
+    }
+}
+
+/*
+ * Byte swapping, with whole vectors loaded before they are stored, so the
+ * swap may be done in place.
+ */
+#if HALF_HAVE_X86_SIMD
+
+static HALF_TARGET_SSE2 void
+half_byteswap_sse2(const npy_uint16 *src, npy_uint16 *dst, npy_intp n)
+{
+    npy_intp i;
+    __m128i a;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        a = _mm_loadu_si128((const __m128i *)(src + i));
+        a = _mm_or_si128(_mm_slli_epi16(a, 8), _mm_srli_epi16(a, 8));
+        _mm_storeu_si128((__m128i *)(dst + i), a);
+    }
+    for (; i < n; i++) {
+        dst[i] = (npy_uint16)((src[i] << 8) | (src[i] >> 8));
+    }
+}
+
+static HALF_TARGET_AVX2 void
+half_byteswap_avx2(const npy_uint16 *src, npy_uint16 *dst, npy_intp n)
+{
+    const __m256i swap = _mm256_setr_epi8(
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    npy_intp i;
+    __m256i a, b;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        a = _mm256_loadu_si256((const __m256i *)(src + i));
+        b = _mm256_loadu_si256((const __m256i *)(src + i + 16));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_shuffle_epi8(a, swap));
+        _mm256_storeu_si256((__m256i *)(dst + i + 16),
+                            _mm256_shuffle_epi8(b, swap));
+    }
+    half_byteswap_sse2(src + i, dst + i, n - i);
+}
+
+static HALF_TARGET_AVX512 void
+half_byteswap_avx512(const npy_uint16 *src, npy_uint16 *dst, npy_intp n)
+{
+    const __m512i swap = _mm512_broadcast_i32x4(_mm_setr_epi8(
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+    npy_intp i;
+    __m512i a;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        a = _mm512_loadu_si512((const void *)(src + i));
+        _mm512_storeu_si512((void *)(dst + i), _mm512_shuffle_epi8(a, swap));
+    }
+    if (i < n) {
+        __mmask32 m = (__mmask32)((1ULL << (n - i)) - 1);
+        a = _mm512_maskz_loadu_epi16(m, src + i);
+        _mm512_mask_storeu_epi16(dst + i, m, _mm512_shuffle_epi8(a, swap));
+    }
+}
+
+#endif /* HALF_HAVE_X86_SIMD */
+
+void
+half_byteswap_n(const npy_uint16 *src, npy_uint16 *dst, npy_intp n)
+{
+    npy_intp i;
+
+    switch (half_simd_level()) {
+#if HALF_HAVE_X86_SIMD
+        case HALF_SIMD_AVX512:
+            half_byteswap_avx512(src, dst, n);
+            return;
+        case HALF_SIMD_AVX2:
+            half_byteswap_avx2(src, dst, n);
+            return;
+        case HALF_SIMD_SSE2:
+            half_byteswap_sse2(src, dst, n);
+            return;
+#endif
+        default:
+            for (i = 0; i < n; i++) {
+                dst[i] = (npy_uint16)((src[i] << 8) | (src[i] >> 8));
+            }
+    }
+}
+
+/*
+ ********************************************************************
+ *                     DECIMAL PARSING                              *
+ ********************************************************************
+ */
+
+/*
+ * A decimal value D is scaled to X = D * 2^25, in units of half the
+ * smallest subnormal, where every rounding boundary of a half is an
+ * integer, and finite halves are below 65520 * 2^25 < 2^42.  With up to
+ * 19 significant digits D = w * 10^e is scaled exactly in 64-bit
+ * integers.  Longer numbers are scaled digit by digit: the boundaries
+ * have at most 31 significant digits, so the first 40 digits and a sticky
+ * bit for the rest decide every rounding.
+ */
+#define HALF_PARSE_FAST   19
+#define HALF_PARSE_DIGITS 40
+
+static const npy_uint64 half_pow5[28] = {
+    1ULL, 5ULL, 25ULL,
+    125ULL, 625ULL, 3125ULL,
+    15625ULL, 78125ULL, 390625ULL,
+    1953125ULL, 9765625ULL, 48828125ULL,
+    244140625ULL, 1220703125ULL, 6103515625ULL,
+    30517578125ULL, 152587890625ULL, 762939453125ULL,
+    3814697265625ULL, 19073486328125ULL, 95367431640625ULL,
+    476837158203125ULL, 2384185791015625ULL, 11920928955078125ULL,
+    59604644775390625ULL, 298023223876953125ULL, 1490116119384765625ULL,
+    7450580596923828125ULL
+};
+
+static const double half_pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * Rounds X, with the sticky bit for any fraction below it, to half bits.
+ * Overflow and underflow go to *status like the conversions above.
+ */
+static npy_uint16
+half_round_scaled(npy_uint64 x, int sticky, int *status)
+{
+    npy_uint64 q, rem, mid;
+    int s = 1, step;
+
+    if (x >= ((npy_uint64)65520 << 25)) {
+        *status |= HALF_FPE_OVERFLOW;
+        return 0x7c00u;
+    }
+    if (x < 0x800 && (x != 0 || sticky)) {
+        *status |= HALF_FPE_UNDERFLOW;
+    }
+    /* The smallest s with x >> s below 0x800, at most 31 as x < 2^42 */
+    for (step = 16; step > 0; step >>= 1) {
+        if ((x >> (s + step - 1)) >= 0x800) {
+            s += step;
+        }
+    }
+    q = x >> s;
+    rem = x & (((npy_uint64)1 << s) - 1);
+    mid = (npy_uint64)1 << (s - 1);
+#if HALF_ROUND_TIES_TO_EVEN
+    if (rem > mid || (rem == mid && (sticky || (q & 1)))) {
+        q++;
+    }
+#else
+    if (rem >= mid) {
+        q++;
+    }
+#endif
+    /* s - 1 is the exponent field, a carry out of q increments it */
+    return (npy_uint16)(((s - 1) << 10) + q);
+}
+
+/* D = w * 10^e, with w != 0, -26 <= e and D < 10^5 */
+static npy_uint16
+half_scale_fast(npy_uint64 w, int e, int *status)
+{
+    npy_uint64 x, r, p5;
+    int p, sticky;
+
+    if (e >= 0) {
+        while (e-- > 0) {
+            w *= 10;
+        }
+        return half_round_scaled(w << 25, 0, status);
+    }
+    p = -e;
+    if (p <= 22 && w <= ((npy_uint64)1 << 53)) {
+        /*
+         * w / 10^p is correctly rounded in double.  Rounding is monotonic,
+         * so it lands on the wrong side of no integer boundary and only a
+         * result that is an integer needs the exact path below.
+         */
+        double d = (double)w / half_pow10[p] * 33554432.0;
+
+        x = (npy_uint64)d;
+        if ((double)x != d) {
+            return half_round_scaled(x, 1, status);
+        }
+    }
+    p5 = half_pow5[p];
+    if (p <= 25) {
+        /* w * 2^(25-p) / 5^p, with w % 5^p * 2^(25-p) < 5^25 * 2^25 */
+        x = (w / p5) << (25 - p);
+        r = (w % p5) << (25 - p);
+        x += r / p5;
+        sticky = (r % p5) != 0;
+    }
+    else {
+        x = w / p5;
+        sticky = (w % p5) != 0 || (x & ((1u << (p - 25)) - 1)) != 0;
+        x >>= p - 25;
+    }
+    return half_round_scaled(x, sticky, status);
+}
+
+/* D = 0.d[0]...d[n-1] * 10^k, with HALF_PARSE_FAST < n and -7 <= k <= 5 */
+static npy_uint16
+half_scale_digits(const char *d, int n, int k, int sticky, int *status)
+{
+    char res[HALF_PARSE_DIGITS + 8];
+    npy_uint64 carry = 0, cur, x = 0;
+    int i;
+
+    /* 2^25 < 10^8 adds at most 8 digits */
+    for (i = n - 1; i >= 0; i--) {
+        cur = (npy_uint64)d[i] * 33554432u + carry;
+        res[i + 8] = (char)(cur % 10);
+        carry = cur / 10;
+    }
+    for (i = 7; i >= 0; i--) {
+        res[i] = (char)(carry % 10);
+        carry /= 10;
+    }
+    /* The first 8 + k digits are the integer part */
+    for (i = 0; i < 8 + k; i++) {
+        x = x * 10 + res[i];
+    }
+    for (; i < n + 8; i++) {
+        sticky |= res[i];
+    }
+    return half_round_scaled(x, sticky != 0, status);
+}
+
+/* The length of word at p, ignoring case, or 0 if it is not there */
+static int
+half_match_word(const char *p, const char *word)
+{
+    int i;
+
+    for (i = 0; word[i] != '\0'; i++) {
+        if ((p[i] | 0x20) != word[i]) {
+            return 0;
+        }
+    }
+    return i;
+}
+
+/* Parses a number at p without leading whitespace, see half_strtoh */
+static npy_half
+half_parse_number(const char *p, const char **endptr, int *status)
+{
+    const char *start = p, *q;
+    char digits[HALF_PARSE_DIGITS];
+    npy_uint64 w = 0;
+    npy_uint16 sign = 0;
+    npy_intp nd = 0, last = 0;
+    long k = 0, exp = 0;
+    int any = 0, point = 0, sticky = 0, len, esign = 1;
+
+    if (*p == '-' || *p == '+') {
+        sign = (*p == '-') ? 0x8000u : 0;
+        p++;
+    }
+    for (;; p++) {
+        if (*p >= '0' && *p <= '9') {
+            any = 1;
+            if (nd == 0 && *p == '0') {
+                /* leading zeros only move the point */
+                k -= point;
+                continue;
+            }
+            if (nd < HALF_PARSE_FAST) {
+                w = w * 10 + (npy_uint64)(*p - '0');
+            }
+            if (nd < HALF_PARSE_DIGITS) {
+                digits[nd] = (char)(*p - '0');
+            }
+            else if (*p != '0') {
+                sticky = 1;
+            }
+            nd++;
+            if (*p != '0') {
+                last = nd;
+            }
+            k += !point;
+        }
+        else if (*p == '.' && !point) {
+            point = 1;
+        }
+        else {
+            break;
+        }
+    }
+    if (!any) {
+        p = start + (*start == '-' || *start == '+');
+        if ((len = half_match_word(p, "inf")) != 0) {
+            p += len;
+            p += half_match_word(p, "inity");
+            *endptr = p;
+            return sign | 0x7c00u;
+        }
+        if ((len = half_match_word(p, "nan")) != 0) {
+            p += len;
+            if (*p == '(') {
+                for (len = 1; (p[len] >= '0' && p[len] <= '9') ||
+                        ((p[len] | 0x20) >= 'a' && (p[len] | 0x20) <= 'z') ||
+                        p[len] == '_'; len++) {
+                }
+                if (p[len] == ')') {
+                    p += len + 1;
+                }
+            }
+            *endptr = p;
+            return sign | 0x7e00u;
+        }
+        *endptr = start;
+        return 0;
+    }
+    if (*p == 'e' || *p == 'E') {
+        q = p + 1;
+        if (*q == '-' || *q == '+') {
+            esign = (*q == '-') ? -1 : 1;
+            q++;
+        }
+        if (*q >= '0' && *q <= '9') {
+            for (; *q >= '0' && *q <= '9'; q++) {
+                if (exp < 100000) {
+                    exp = exp * 10 + (*q - '0');
+                }
+            }
+            k += esign * exp;
+            p = q;
+        }
+    }
+    *endptr = p;
+
+    if (last == 0) {
+        return sign;
+    }
+    if (k > 5) {
+        return sign | half_round_scaled((npy_uint64)1 << 62, 0, status);
+    }
+    if (k < -7) {
+        return sign | half_round_scaled(0, 1, status);
+    }
+    if (last <= HALF_PARSE_FAST) {
+        nd = nd < HALF_PARSE_FAST ? nd : HALF_PARSE_FAST;
+        return sign | half_scale_fast(w, (int)(k - nd), status);
+    }
+    nd = nd < HALF_PARSE_DIGITS ? nd : HALF_PARSE_DIGITS;
+    return sign | half_scale_digits(digits, (int)nd, (int)k, sticky, status);
+}
+
+npy_half
+half_strtoh(const char *str, char **endptr)
+{
+    const char *p = str, *end;
+    npy_half h;
+    int status = 0;
+
+    while (*p == ' ' || (*p >= '\t' && *p <= '\r')) {
+        p++;
+    }
+    h = half_parse_number(p, &end, &status);
+    *endptr = (char *)(end == p ? str : end);
+    half_raise_status(status);
+    return h;
+}
+
+npy_intp
+half_parse_column(const char *text, char delimiter, npy_intp column,
+                  npy_half *out)
+{
+    const char *p = text, *end;
+    npy_intp n = 0, line, i;
+    int status = 0;
+
+    for (line = 0; *p != '\0'; line++) {
+        for (end = p; *end == ' ' || *end == '\t' || *end == '\r'; end++) {
+        }
+        if (*end == '\n' || *end == '\0') {
+            /* blank line */
+            p = *end ? end + 1 : end;
+            continue;
+        }
+        for (i = 0; i < column; i++) {
+            while (*p != delimiter && *p != '\n' && *p != '\0') {
+                p++;
+            }
+            if (*p != delimiter) {
+                return -1 - line;
+            }
+            p++;
+        }
+        while ((*p == ' ' || *p == '\t') && *p != delimiter) {
+            p++;
+        }
+        out[n] = half_parse_number(p, &end, &status);
+        if (end == p) {
+            return -1 - line;
+        }
+        for (p = end; (*p == ' ' || *p == '\t' || *p == '\r') &&
+                *p != delimiter; p++) {
+        }
+        if (*p != delimiter && *p != '\n' && *p != '\0') {
+            return -1 - line;
+        }
+        n++;
+        while (*p != '\n' && *p != '\0') {
+            p++;
+        }
+        if (*p == '\n') {
+            p++;
+        }
+    }
+    half_raise_status(status);
+    return n;
+}
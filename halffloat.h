@@ -29,9 +29,27 @@
 #ifndef __HALF_H__
 #define __HALF_H__
 
+#ifdef HALF_STANDALONE
+/* The conversion routines alone, without Python or NumPy */
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int8_t npy_int8;
+typedef uint8_t npy_uint8;
+typedef int16_t npy_int16;
+typedef uint16_t npy_uint16;
+typedef int32_t npy_int32;
+typedef uint32_t npy_uint32;
+typedef int64_t npy_int64;
+typedef uint64_t npy_uint64;
+typedef ptrdiff_t npy_intp;
+typedef unsigned char npy_bool;
+#define NPY_INLINE inline
+#else
 #include <Python.h>
 #include <numpy/ndarrayobject.h>
 #include <numpy/npy_math.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -91,6 +109,234 @@ npy_uint16 doublebits_to_halfbits(npy_uint64 d);
 npy_uint32 halfbits_to_floatbits(npy_uint16 h);
 npy_uint64 halfbits_to_doublebits(npy_uint16 h);
 
+/*
+ * Bulk bit-level conversions of n contiguous values.  These give the
+ * same bits as the routines above, and run the best SIMD implementation
+ * available on the CPU.
+ */
+void floatbits_to_halfbits_n(const npy_uint32 *f, npy_uint16 *h, npy_intp n);
+void halfbits_to_floatbits_n(const npy_uint16 *h, npy_uint32 *f, npy_intp n);
+void doublebits_to_halfbits_n(const npy_uint64 *d, npy_uint16 *h, npy_intp n);
+void halfbits_to_doublebits_n(const npy_uint16 *h, npy_uint64 *d, npy_intp n);
+
+/*
+ * bfloat16 routines.  bfloat16 is the top 16 bits of a float; narrowing
+ * rounds to nearest even and preserves NaN payloads like the half
+ * routines.  The bulk versions run the best SIMD implementation.
+ */
+typedef npy_uint16 npy_bfloat16;
+
+float bfloat16_to_float(npy_bfloat16 b);
+npy_bfloat16 float_to_bfloat16(float f);
+npy_bfloat16 double_to_bfloat16(double d);
+npy_uint32 bfloat16bits_to_floatbits(npy_uint16 b);
+npy_uint64 bfloat16bits_to_doublebits(npy_uint16 b);
+npy_uint16 floatbits_to_bfloat16bits(npy_uint32 f);
+npy_uint16 doublebits_to_bfloat16bits(npy_uint64 d);
+void floatbits_to_bfloat16bits_n(const npy_uint32 *f, npy_uint16 *b,
+                                 npy_intp n);
+void bfloat16bits_to_floatbits_n(const npy_uint16 *b, npy_uint32 *f,
+                                 npy_intp n);
+
+/*
+ * Direct bfloat16 <-> half conversions, rounding once to nearest even.
+ * Half to bfloat16 is always in range; bfloat16 to half raises the same
+ * flags as floatbits_to_halfbits.
+ */
+npy_uint16 bfloat16bits_to_halfbits(npy_uint16 b);
+npy_uint16 halfbits_to_bfloat16bits(npy_uint16 h);
+void bfloat16bits_to_halfbits_n(const npy_uint16 *b, npy_uint16 *h,
+                                npy_intp n);
+void halfbits_to_bfloat16bits_n(const npy_uint16 *h, npy_uint16 *b,
+                                npy_intp n);
+
+/*
+ * FP8 routines for the OCP E4M3 (no infinities, largest value 448) and
+ * E5M2 (the top byte of a half) formats.  Narrowing rounds to nearest
+ * even.  With saturate nonzero, values out of range and infinities give
+ * the largest finite value; otherwise they give NaN (E4M3) or inf (E5M2)
+ * and out of range finite values raise overflow.  Widening is exact.
+ */
+#define HALF_FP8_NONSATURATING 0
+#define HALF_FP8_SATURATING    1
+
+npy_uint8 floatbits_to_e4m3bits(npy_uint32 f, int saturate);
+npy_uint8 floatbits_to_e5m2bits(npy_uint32 f, int saturate);
+npy_uint8 halfbits_to_e4m3bits(npy_uint16 h, int saturate);
+npy_uint8 halfbits_to_e5m2bits(npy_uint16 h, int saturate);
+npy_uint32 e4m3bits_to_floatbits(npy_uint8 b);
+npy_uint32 e5m2bits_to_floatbits(npy_uint8 b);
+npy_uint16 e4m3bits_to_halfbits(npy_uint8 b);
+npy_uint16 e5m2bits_to_halfbits(npy_uint8 b);
+void floatbits_to_e4m3bits_n(const npy_uint32 *f, npy_uint8 *b, npy_intp n,
+                             int saturate);
+void floatbits_to_e5m2bits_n(const npy_uint32 *f, npy_uint8 *b, npy_intp n,
+                             int saturate);
+void halfbits_to_e4m3bits_n(const npy_uint16 *h, npy_uint8 *b, npy_intp n,
+                            int saturate);
+void halfbits_to_e5m2bits_n(const npy_uint16 *h, npy_uint8 *b, npy_intp n,
+                            int saturate);
+void e4m3bits_to_floatbits_n(const npy_uint8 *b, npy_uint32 *f, npy_intp n);
+void e5m2bits_to_floatbits_n(const npy_uint8 *b, npy_uint32 *f, npy_intp n);
+void e4m3bits_to_halfbits_n(const npy_uint8 *b, npy_uint16 *h, npy_intp n);
+void e5m2bits_to_halfbits_n(const npy_uint8 *b, npy_uint16 *h, npy_intp n);
+
+/*
+ * Byte swaps n contiguous 16-bit values for non-native byte order
+ * arrays.  src and dst may be the same buffer, but must not otherwise
+ * overlap.
+ */
+void half_byteswap_n(const npy_uint16 *src, npy_uint16 *dst, npy_intp n);
+
+/*
+ * Locale independent parsing of decimal text, rounded once to the nearest
+ * half.  half_strtoh accepts what strtod does apart from hexadecimal:
+ * leading whitespace, a sign, digits with an optional point and exponent,
+ * or inf, infinity and nan in any case.  *endptr is set past the number,
+ * or to str if there is none.  Out of range values raise the same flags
+ * as double_to_half, and half_parse_column raises each at most once.
+ *
+ * half_parse_column parses field column (from 0) of each line of the NUL
+ * terminated text into out, which needs room for one value per line.
+ * Fields are split at delimiter and may be padded with spaces or tabs,
+ * and blank lines are skipped.  Returns the number of values, or
+ * -1 - line for the first line (from 0) whose field is not a number.
+ */
+npy_half half_strtoh(const char *str, char **endptr);
+npy_intp half_parse_column(const char *text, char delimiter, npy_intp column,
+                           npy_half *out);
+
+/*
+ * Tables with the float/double bits of all 65536 halves, built on first
+ * use.  They are returned only when table lookups are selected for
+ * decoding, otherwise (or if they cannot be allocated) NULL is returned.
+ * HALF_DECODE_AUTO selects them without F16C, except for the SSE2 bulk
+ * half to float decode.  HALF_DECODE_TABLE always selects them, also
+ * instead of the SIMD kernels.
+ */
+#define HALF_DECODE_AUTO  0
+#define HALF_DECODE_BITS  1
+#define HALF_DECODE_TABLE 2
+
+int half_decode_mode(void);
+int half_set_decode_mode(int mode);
+const npy_uint32 *half_float_table(void);
+const npy_uint64 *half_double_table(void);
+
+/*
+ * Bulk comparisons of n pairs, writing 0 or 1 to out.  The strides are
+ * in elements and must be 0 (a broadcast scalar) or 1.  Greater than
+ * comparisons are done by swapping the operands.
+ */
+void half_eq_n(const npy_half *h1, npy_intp s1, const npy_half *h2, npy_intp s2,
+               npy_bool *out, npy_intp n);
+void half_ne_n(const npy_half *h1, npy_intp s1, const npy_half *h2, npy_intp s2,
+               npy_bool *out, npy_intp n);
+void half_lt_n(const npy_half *h1, npy_intp s1, const npy_half *h2, npy_intp s2,
+               npy_bool *out, npy_intp n);
+void half_le_n(const npy_half *h1, npy_intp s1, const npy_half *h2, npy_intp s2,
+               npy_bool *out, npy_intp n);
+
+/*
+ * Bulk elementwise maximum/minimum, with strides as above.  NaNs
+ * propagate, and of two equal values (such as -0.0 and +0.0) the first
+ * is returned.  half_maxmin does the same for one pair, the maximum if
+ * want_max is nonzero.
+ */
+npy_half half_maxmin(npy_half h1, npy_half h2, int want_max);
+void half_maximum_n(const npy_half *h1, npy_intp s1, const npy_half *h2,
+                    npy_intp s2, npy_half *out, npy_intp n);
+void half_minimum_n(const npy_half *h1, npy_intp s1, const npy_half *h2,
+                    npy_intp s2, npy_half *out, npy_intp n);
+
+/*
+ * Index of the first maximum/minimum of n contiguous halves, or of the
+ * first NaN if there is one.  Signed zeros compare equal.
+ */
+npy_intp half_argmax_n(const npy_half *h, npy_intp n);
+npy_intp half_argmin_n(const npy_half *h, npy_intp n);
+
+/*
+ * Dot product of n contiguous pairs.  The products are exact in float32;
+ * HALF_DOT_FLOAT sums them in float32 with several accumulators,
+ * HALF_DOT_PAIRWISE sums float32 partial sums of short blocks pairwise,
+ * and HALF_DOT_DOUBLE sums them in float64.
+ */
+#define HALF_DOT_FLOAT    0
+#define HALF_DOT_PAIRWISE 1
+#define HALF_DOT_DOUBLE   2
+
+double half_dot_n(const npy_half *h1, const npy_half *h2, npy_intp n,
+                  int accumulate);
+
+/*
+ * C = A B for an m x k matrix A and a k x n matrix B.  Each matrix is
+ * given by a pointer and its row and column strides in elements.  The
+ * products are summed in float32 and C is rounded to half once.
+ */
+void half_gemm(npy_intp m, npy_intp n, npy_intp k,
+               const npy_half *a, npy_intp a_rs, npy_intp a_cs,
+               const npy_half *b, npy_intp b_rs, npy_intp b_cs,
+               npy_half *c, npy_intp c_rs, npy_intp c_cs);
+
+/*
+ * SIMD levels for the bulk routines.  half_set_simd_level caps the
+ * level used (a negative value restores the detected one) and returns
+ * the level actually selected.
+ */
+#define HALF_SIMD_NONE   0
+#define HALF_SIMD_SSE2   1
+#define HALF_SIMD_AVX2   2  /* AVX2 + F16C + FMA */
+#define HALF_SIMD_AVX512 3  /* AVX-512 F/BW/VL */
+
+int half_simd_level(void);
+int half_set_simd_level(int level);
+
+/*
+ * Floating point exceptions of the half, bfloat16 and FP8 conversions.  The
+ * bulk ones collect overflow and underflow over the whole call and, in
+ * HALF_FPE_RAISE mode, raise each flag at most once at the end for NumPy's
+ * error state; in HALF_FPE_IGNORE mode neither they nor the scalar ones
+ * raise anything.  The *_status_n versions raise
+ * nothing and return the HALF_FPE_* bits instead.  The conversions never
+ * signal invalid: NaNs convert quietly.
+ */
+#define HALF_FPE_RAISE      0
+#define HALF_FPE_IGNORE     1
+
+#define HALF_FPE_OVERFLOW   1
+#define HALF_FPE_UNDERFLOW  2
+
+int half_fpe_mode(void);
+int half_set_fpe_mode(int mode);
+int floatbits_to_halfbits_status_n(const npy_uint32 *f, npy_uint16 *h,
+                                   npy_intp n);
+int doublebits_to_halfbits_status_n(const npy_uint64 *d, npy_uint16 *h,
+                                    npy_intp n);
+
+/*
+ * Bulk float/double to half conversions with a rounding mode chosen per
+ * call.  HALF_ROUNDING_NEAREST_EVEN gives the bits of the *_n routines
+ * above.  HALF_ROUNDING_TOWARD_ZERO truncates, and gives the largest
+ * finite half for finite values above it.  HALF_ROUNDING_STOCHASTIC
+ * rounds up with a probability equal to the fraction of an ulp dropped,
+ * resolved to 2^-32.  Element i takes its random bits from counter
+ * start + i of the stream selected by seed, so the results depend only
+ * on the seed and the counters: a conversion split into pieces at
+ * start, start + n0, ... gives the same bits as one call.  Overflow and
+ * underflow are reported as by the *_n routines.
+ */
+#define HALF_ROUNDING_NEAREST_EVEN 0
+#define HALF_ROUNDING_TOWARD_ZERO  1
+#define HALF_ROUNDING_STOCHASTIC   2
+
+void floatbits_to_halfbits_round_n(const npy_uint32 *f, npy_uint16 *h,
+                                   npy_intp n, int mode, npy_uint64 seed,
+                                   npy_uint64 start);
+void doublebits_to_halfbits_round_n(const npy_uint64 *d, npy_uint16 *h,
+                                    npy_intp n, int mode, npy_uint64 seed,
+                                    npy_uint64 start);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,48 +29,63 @@
 
 #include <Python.h>
 #include <numpy/arrayobject.h>
+#include <numpy/ufuncobject.h>
 #include <numpy/npy_math.h>
 
 #define NPY_PY3K 1
 
 #include "halffloat.h"
 
+#ifndef _WIN32
+#define HALF_HAVE_THREADS 1
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#else
+#define HALF_HAVE_THREADS 0
+#endif
 
 
 
 
-#if 0
 
-// Python type for PyBfloat16 objects.
-PyTypeObject bfloat16_type = {
-    PyVarObject_HEAD_INIT(nullptr, 0) "bfloat16",  // tp_name
-    sizeof(PyBfloat16),                            // tp_basicsize
-    0,                                             // tp_itemsize
-    nullptr,                                       // tp_dealloc
+typedef struct {
+        PyObject_HEAD
+        npy_bfloat16 obval;
+} PyBfloat16ScalarObject;
+
+// Python type for bfloat16 scalars.  The slots are filled in by
+// PyInit_numpy_xhalf, like those of xfloat16.
+PyTypeObject PyBfloat16ArrType_Type = {
+    PyVarObject_HEAD_INIT(nullptr, 0) "half.bfloat16",  // tp_name
+    sizeof(PyBfloat16ScalarObject),                 // tp_basicsize
+    0,                                              // tp_itemsize
+    nullptr,                                        // tp_dealloc
 #if PY_VERSION_HEX < 0x03080000
     nullptr,  // tp_print
 #else
     0,  // tp_vectorcall_offset
 #endif
-    nullptr,               // tp_getattr
-    nullptr,               // tp_setattr
-    nullptr,               // tp_compare / tp_reserved
-    PyBfloat16_Repr,       // tp_repr
-    &PyBfloat16_AsNumber,  // tp_as_number
-    nullptr,               // tp_as_sequence
-    nullptr,               // tp_as_mapping
-    PyBfloat16_Hash,       // tp_hash
-    nullptr,               // tp_call
-    PyBfloat16_Str,        // tp_str
-    nullptr,               // tp_getattro
-    nullptr,               // tp_setattro
-    nullptr,               // tp_as_buffer
-                           // tp_flags
-    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    nullptr,  // tp_getattr
+    nullptr,  // tp_setattr
+    nullptr,  // tp_compare / tp_reserved
+    nullptr,  // tp_repr
+    nullptr,  // tp_as_number
+    nullptr,  // tp_as_sequence
+    nullptr,  // tp_as_mapping
+    nullptr,  // tp_hash
+    nullptr,  // tp_call
+    nullptr,  // tp_str
+    nullptr,  // tp_getattro
+    nullptr,  // tp_setattro
+    nullptr,  // tp_as_buffer
+    0,        // tp_flags
     "bfloat16 floating-point values",  // tp_doc
     nullptr,                           // tp_traverse
     nullptr,                           // tp_clear
-    PyBfloat16_RichCompare,            // tp_richcompare
+    nullptr,                           // tp_richcompare
     0,                                 // tp_weaklistoffset
     nullptr,                           // tp_iter
     nullptr,                           // tp_iternext
@@ -84,7 +99,7 @@ PyTypeObject bfloat16_type = {
     0,                                 // tp_dictoffset
     nullptr,                           // tp_init
     nullptr,                           // tp_alloc
-    PyBfloat16_New,                    // tp_new
+    nullptr,                           // tp_new
     nullptr,                           // tp_free
     nullptr,                           // tp_is_gc
     nullptr,                           // tp_bases
@@ -98,12 +113,12 @@ PyTypeObject bfloat16_type = {
 
 // Numpy support
 
-PyArray_ArrFuncs NPyBfloat16_ArrFuncs;
+static PyArray_ArrFuncs NPyBfloat16_ArrFuncs;
 
 PyArray_Descr NPyBfloat16_Descr = {
     PyObject_HEAD_INIT(nullptr)  //
                                  /*typeobj=*/
-    (&bfloat16_type),
+    (&PyBfloat16ArrType_Type),
     // We must register bfloat16 with a kind other than "f", because numpy
     // considers two types with the same kind and size to be equal, but
     // float16 != bfloat16.
@@ -114,10 +129,13 @@ PyArray_Descr NPyBfloat16_Descr = {
     // character is unique.
     /*type=*/'E',
     /*byteorder=*/'=',
-    /*flags=*/NPY_NEEDS_PYAPI | NPY_USE_GETITEM | NPY_USE_SETITEM,
+    // No NPY_NEEDS_PYAPI: only getitem/setitem touch Python objects, and
+    // numpy always calls those with the GIL held.  Casts and ufunc loops
+    // then run with the GIL released.
+    /*flags=*/NPY_USE_GETITEM | NPY_USE_SETITEM,
     /*type_num=*/0,
-    /*elsize=*/sizeof(bfloat16),
-    /*alignment=*/alignof(bfloat16),
+    /*elsize=*/sizeof(npy_bfloat16),
+    /*alignment=*/sizeof(npy_bfloat16),
     /*subarray=*/nullptr,
     /*fields=*/nullptr,
     /*names=*/nullptr,
@@ -126,7 +144,67 @@ PyArray_Descr NPyBfloat16_Descr = {
     /*c_metadata=*/nullptr,
     /*hash=*/-1,  // -1 means "not computed yet".
 };
-#endif
+
+typedef struct {
+        PyObject_HEAD
+        npy_uint8 obval;
+} PyFloat8ScalarObject;
+
+// Python types for the FP8 scalars.  The other slots are filled in by
+// PyInit_numpy_xhalf.
+PyTypeObject PyE4M3ArrType_Type = {
+    PyVarObject_HEAD_INIT(nullptr, 0) "half.float8_e4m3fn",  // tp_name
+    sizeof(PyFloat8ScalarObject),                      // tp_basicsize
+};
+
+PyTypeObject PyE5M2ArrType_Type = {
+    PyVarObject_HEAD_INIT(nullptr, 0) "half.float8_e5m2",  // tp_name
+    sizeof(PyFloat8ScalarObject),                    // tp_basicsize
+};
+
+static PyArray_ArrFuncs NPyE4M3_ArrFuncs;
+static PyArray_ArrFuncs NPyE5M2_ArrFuncs;
+
+// Registered with kind "V" for the same reason as bfloat16.
+PyArray_Descr NPyE4M3_Descr = {
+    PyObject_HEAD_INIT(nullptr)  //
+                                 /*typeobj=*/
+    (&PyE4M3ArrType_Type),
+    /*kind=*/'V',
+    /*type=*/'4',
+    /*byteorder=*/'|',
+    /*flags=*/NPY_USE_GETITEM | NPY_USE_SETITEM,
+    /*type_num=*/0,
+    /*elsize=*/1,
+    /*alignment=*/1,
+    /*subarray=*/nullptr,
+    /*fields=*/nullptr,
+    /*names=*/nullptr,
+    /*f=*/&NPyE4M3_ArrFuncs,
+    /*metadata=*/nullptr,
+    /*c_metadata=*/nullptr,
+    /*hash=*/-1,  // -1 means "not computed yet".
+};
+
+PyArray_Descr NPyE5M2_Descr = {
+    PyObject_HEAD_INIT(nullptr)  //
+                                 /*typeobj=*/
+    (&PyE5M2ArrType_Type),
+    /*kind=*/'V',
+    /*type=*/'5',
+    /*byteorder=*/'|',
+    /*flags=*/NPY_USE_GETITEM | NPY_USE_SETITEM,
+    /*type_num=*/0,
+    /*elsize=*/1,
+    /*alignment=*/1,
+    /*subarray=*/nullptr,
+    /*fields=*/nullptr,
+    /*names=*/nullptr,
+    /*f=*/&NPyE5M2_ArrFuncs,
+    /*metadata=*/nullptr,
+    /*c_metadata=*/nullptr,
+    /*hash=*/-1,  // -1 means "not computed yet".
+};
 
 
 
@@ -218,7 +296,10 @@ PyArray_Descr xfloat16_Descr = {
     // character is unique.
     /*type=*/'j', /*'E',*/
     /*byteorder=*/'=',
-    /*flags=*/NPY_NEEDS_PYAPI | NPY_USE_GETITEM | NPY_USE_SETITEM,
+    // No NPY_NEEDS_PYAPI: only getitem/setitem touch Python objects, and
+    // numpy always calls those with the GIL held.  Casts and ufunc loops
+    // then run with the GIL released.
+    /*flags=*/NPY_USE_GETITEM | NPY_USE_SETITEM,
     /*type_num=*/0,
     /*elsize=*/sizeof(npy_half),
     /*alignment=*/sizeof(npy_half), /*alignof(npy_half),*/
@@ -270,20 +351,163 @@ MyPyFloat_AsHalf(PyObject *obj)
     return double_to_half(d);
 }
 
+/*
+ * The scalar types construct Python floats, as PyArray_Scalar calls
+ * getitem for them.  A single float or int argument, the common case in
+ * Python loops, is rounded directly by the constructors, without the
+ * argument parsing and the round trip through PyArray_Scalar.  Returns 1
+ * with the value in d, 0 for any other arguments, and -1 on error.
+ */
+static int
+scalar_arg_as_double(PyObject *args, double *d)
+{
+    PyObject *obj;
+
+    if (PyTuple_GET_SIZE(args) != 1) {
+        return 0;
+    }
+    obj = PyTuple_GET_ITEM(args, 0);
+    if (PyFloat_CheckExact(obj)) {
+        *d = PyFloat_AS_DOUBLE(obj);
+        return 1;
+    }
+    if (PyLong_CheckExact(obj)) {
+        *d = PyLong_AsDouble(obj);
+        return (*d == -1.0 && PyErr_Occurred()) ? -1 : 1;
+    }
+    return 0;
+}
+
+/*
+ * One element of a 16-bit array that may be unaligned or byteswapped,
+ * loaded or stored inline rather than through copyswap.
+ */
+static NPY_INLINE npy_uint16
+half_load_item(const char *ip, PyArrayObject *ap)
+{
+    npy_uint16 v;
+
+    memcpy(&v, ip, sizeof(v));
+    if (ap != NULL && !PyArray_ISNOTSWAPPED(ap)) {
+        v = (npy_uint16)((v << 8) | (v >> 8));
+    }
+    return v;
+}
+
+static NPY_INLINE void
+half_store_item(char *op, npy_uint16 v, PyArrayObject *ap)
+{
+    if (ap != NULL && !PyArray_ISNOTSWAPPED(ap)) {
+        v = (npy_uint16)((v << 8) | (v >> 8));
+    }
+    memcpy(op, &v, sizeof(v));
+}
+
+/*
+ * copyswap for xfloat16 and bfloat16.  numpy goes through copyswapn for
+ * every cast, ufunc or copy of a non-native array, so contiguous aligned
+ * data is swapped with the SIMD half_byteswap_n.
+ */
+static void
+HALF_copyswapn(void *dst, npy_intp dstride, void *src, npy_intp sstride,
+               npy_intp n, int swap, void *NPY_UNUSED(arr))
+{
+    char *d = (char *)dst, *s = (char *)src;
+    npy_uint16 v;
+    npy_intp i;
+
+    if (src == NULL) {
+        if (!swap) {
+            return;
+        }
+        s = d;
+        sstride = dstride;
+    }
+    if (dstride == 2 && sstride == 2) {
+        if (!swap) {
+            memmove(d, s, n * 2);
+            return;
+        }
+        if ((((npy_uintp)d | (npy_uintp)s) & 1) == 0) {
+            half_byteswap_n((npy_uint16 *)s, (npy_uint16 *)d, n);
+            return;
+        }
+    }
+    for (i = 0; i < n; i++, d += dstride, s += sstride) {
+        memcpy(&v, s, sizeof(v));
+        if (swap) {
+            v = (npy_uint16)((v << 8) | (v >> 8));
+        }
+        memcpy(d, &v, sizeof(v));
+    }
+}
+
+static void
+HALF_copyswap(void *dst, void *src, int swap, void *NPY_UNUSED(arr))
+{
+    npy_uint16 v;
+
+    if (src == NULL) {
+        if (!swap) {
+            return;
+        }
+        src = dst;
+    }
+    memcpy(&v, src, sizeof(v));
+    if (swap) {
+        v = (npy_uint16)((v << 8) | (v >> 8));
+    }
+    memcpy(dst, &v, sizeof(v));
+}
+
+/*
+ * getitem returns the Python float of a bit pattern from a cache, creating
+ * it on first use, so that iterating over an array or tolist only takes
+ * references instead of allocating a float per element.  A cache holds at
+ * most one float per value, 2MB for all of the 16-bit values.  getitem is
+ * always called with the GIL held, which protects the caches.
+ */
+typedef double (*scalar_decode_func)(npy_uint32 bits);
+
 static PyObject *
-HALF_getitem(char *ip, PyArrayObject *ap)
+scalar_cached_float(PyObject ***cache, npy_intp size, npy_uint32 bits,
+                    scalar_decode_func decode)
 {
-    npy_half t1;
-    double t2;
+    PyObject *f;
 
-    if ((ap == NULL) || PyArray_ISBEHAVED_RO(ap)) {
-        t1 = *((npy_half *)ip);
+    if (*cache == NULL) {
+        *cache = (PyObject **)calloc(size, sizeof(PyObject *));
+        if (*cache == NULL) {
+            return PyFloat_FromDouble(decode(bits));
+        }
     }
-    else {
-        ap->descr->f->copyswap(&t1, ip, !PyArray_ISNOTSWAPPED(ap), ap);
+    f = (*cache)[bits];
+    if (f == NULL) {
+        f = PyFloat_FromDouble(decode(bits));
+        if (f == NULL) {
+            return NULL;
+        }
+        (*cache)[bits] = f;
     }
-    t2 = half_to_double(t1);
-    return PyFloat_FromDouble(t2);
+    Py_INCREF(f);
+    return f;
+}
+
+static PyObject **half_float_cache = NULL;
+
+static double
+half_decode(npy_uint32 bits)
+{
+    return half_to_double((npy_half)bits);
+}
+
+static PyObject *
+HALF_getitem(char *ip, PyArrayObject *ap)
+{
+    npy_half t1;
+
+    t1 = half_load_item(ip, ap);
+    return scalar_cached_float(&half_float_cache, 0x10000, t1, half_decode);
 }
 
 static int HALF_setitem(PyObject *op, char *ov, PyArrayObject *ap)
@@ -304,11 +528,7 @@ static int HALF_setitem(PyObject *op, char *ov, PyArrayObject *ap)
         }
         return -1;
     }
-    if (ap == NULL || PyArray_ISBEHAVED(ap))
-        *((npy_half *)ov)=temp;
-    else {
-        ap->descr->f->copyswap(ov, &temp, !PyArray_ISNOTSWAPPED(ap), ap);
-    }
+    half_store_item(ov, temp, ap);
     return 0;
 
 }
@@ -323,10 +543,11 @@ HALF_compare (npy_half *pa, npy_half *pb, PyArrayObject *NPY_UNUSED(ap))
     anan = half_isnan(a);
     bnan = half_isnan(b);
 
+    /* NaNs sort to the end, like for the builtin floats */
     if (anan) {
-        ret = bnan ? 0 : -1;
+        ret = bnan ? 0 : 1;
     } else if (bnan) {
-        ret = 1;
+        ret = -1;
     } else if(half_lt_nonan(a, b)) {
         ret = -1;
     } else if(half_lt_nonan(b, a)) {
@@ -341,83 +562,415 @@ HALF_compare (npy_half *pa, npy_half *pb, PyArrayObject *NPY_UNUSED(ap))
 static int
 HALF_argmax(npy_half *ip, npy_intp n, npy_intp *max_ind, PyArrayObject *NPY_UNUSED(aip))
 {
-    npy_intp i;
-    npy_half mp = *ip;
+    /* nans are maximal, the first one is returned */
+    *max_ind = half_argmax_n(ip, n);
+    return 0;
+}
 
-    *max_ind = 0;
+static int
+HALF_argmin(npy_half *ip, npy_intp n, npy_intp *min_ind, PyArrayObject *NPY_UNUSED(aip))
+{
+    /* nans are minimal too, like argmin() of the builtin floats */
+    *min_ind = half_argmin_n(ip, n);
+    return 0;
+}
 
-    if (half_isnan(mp)) {
-        /* nan encountered; it's maximal */
-        return 0;
+/*
+ * Sorting.  The halves are sorted on unsigned keys in the order of
+ * HALF_compare: -0.0 and +0.0 are equal and NaNs come last.  Short
+ * arrays are insertion sorted, long ones are counting sorted over the
+ * 65536 bit patterns, and the stable sorts are LSD radix sorts of the
+ * two key bytes.
+ */
+#define HALF_SMALL_SORT 16
+#define HALF_COUNTING_SORT 0x10000
+
+static NPY_INLINE npy_uint16
+half_sort_key(npy_half h)
+{
+    npy_uint16 a = h&0x7fffu;
+
+    if (a > 0x7c00u) {
+        return 0xffffu;
     }
+    return (h&0x8000u) ? (npy_uint16)(0x8000u - a) : (npy_uint16)(0x8000u + a);
+}
+
+static void
+half_insertion_sort(npy_half *v, npy_intp n)
+{
+    npy_intp i, j;
+    npy_half h;
 
     for (i = 1; i < n; i++) {
-        ip++;
-        /*
-         * Propagate nans, similarly as max() and min()
-         */
-        if (!(half_le(*ip, mp))) {  /* negated, for correct nan handling */
-            mp = *ip;
-            *max_ind = i;
-            if (half_isnan(mp)) {
-                /* nan encountered, it's maximal */
-                break;
+        h = v[i];
+        for (j = i; j > 0 && half_sort_key(v[j-1]) > half_sort_key(h); j--) {
+            v[j] = v[j-1];
+        }
+        v[j] = h;
+    }
+}
+
+static int
+half_counting_sort(npy_half *v, npy_intp n)
+{
+    npy_intp *count, i, c;
+    npy_uint32 b;
+
+    count = (npy_intp *)calloc(0x10000, sizeof(npy_intp));
+    if (count == NULL) {
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        count[v[i]]++;
+    }
+    /* -inf up to -0.0, then +0.0 up to +inf, then the NaNs */
+    for (b = 0xfc00u; b >= 0x8000u; b--) {
+        for (c = count[b]; c > 0; c--) {
+            *v++ = (npy_half)b;
+        }
+    }
+    for (b = 0; b <= 0x7c00u; b++) {
+        for (c = count[b]; c > 0; c--) {
+            *v++ = (npy_half)b;
+        }
+    }
+    for (b = 0x7c01u; b < 0x10000u; b++) {
+        if ((b&0x7fffu) <= 0x7c00u) {
+            continue;
+        }
+        for (c = count[b]; c > 0; c--) {
+            *v++ = (npy_half)b;
+        }
+    }
+    free(count);
+    return 0;
+}
+
+/* Turns the byte counts into starting offsets */
+static void
+half_radix_offsets(npy_intp *count)
+{
+    npy_intp i, sum = 0, c;
+
+    for (i = 0; i < 256; i++) {
+        c = count[i];
+        count[i] = sum;
+        sum += c;
+    }
+}
+
+static int
+half_radix_sort(npy_half *v, npy_intp n)
+{
+    npy_intp count[2][256], i;
+    npy_half *tmp;
+    npy_uint16 k;
+
+    tmp = (npy_half *)malloc(n * sizeof(npy_half));
+    if (tmp == NULL) {
+        return -1;
+    }
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < n; i++) {
+        k = half_sort_key(v[i]);
+        count[0][k&0xff]++;
+        count[1][k >> 8]++;
+    }
+    half_radix_offsets(count[0]);
+    half_radix_offsets(count[1]);
+    for (i = 0; i < n; i++) {
+        tmp[count[0][half_sort_key(v[i])&0xff]++] = v[i];
+    }
+    for (i = 0; i < n; i++) {
+        v[count[1][half_sort_key(tmp[i]) >> 8]++] = tmp[i];
+    }
+    free(tmp);
+    return 0;
+}
+
+/*
+ * The keys are packed above the indices in a scratch buffer while
+ * sorting, which leaves 48 bits for the indices.  The buffer holds both
+ * passes, as npy_intp may be too narrow for a packed key.
+ */
+static int
+half_radix_argsort(npy_half *v, npy_intp *tosort, npy_intp n)
+{
+    npy_intp count[2][256], i;
+    npy_uint64 *a, *tmp;
+    npy_uint16 k;
+
+    a = (npy_uint64 *)malloc(2 * n * sizeof(npy_uint64));
+    if (a == NULL) {
+        return -1;
+    }
+    tmp = a + n;
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < n; i++) {
+        k = half_sort_key(v[tosort[i]]);
+        count[0][k&0xff]++;
+        count[1][k >> 8]++;
+        a[i] = ((npy_uint64)k << 48) | (npy_uint64)tosort[i];
+    }
+    half_radix_offsets(count[0]);
+    half_radix_offsets(count[1]);
+    for (i = 0; i < n; i++) {
+        tmp[count[0][(a[i] >> 48)&0xff]++] = a[i];
+    }
+    for (i = 0; i < n; i++) {
+        tosort[count[1][tmp[i] >> 56]++] =
+                (npy_intp)(tmp[i]&0xffffffffffffULL);
+    }
+    free(a);
+    return 0;
+}
+
+static int
+HALF_quicksort(npy_half *v, npy_intp n, void *NPY_UNUSED(varr))
+{
+    if (n <= HALF_SMALL_SORT) {
+        half_insertion_sort(v, n);
+        return 0;
+    }
+    if (n >= HALF_COUNTING_SORT) {
+        return half_counting_sort(v, n);
+    }
+    return half_radix_sort(v, n);
+}
+
+static int
+HALF_mergesort(npy_half *v, npy_intp n, void *NPY_UNUSED(varr))
+{
+    /* insertion sort is stable, and so is the radix sort */
+    if (n <= HALF_SMALL_SORT) {
+        half_insertion_sort(v, n);
+        return 0;
+    }
+    return half_radix_sort(v, n);
+}
+
+static int
+HALF_argsort(npy_half *v, npy_intp *tosort, npy_intp n,
+             void *NPY_UNUSED(varr))
+{
+    npy_intp i, j, t;
+    npy_uint16 k;
+
+    if (n <= HALF_SMALL_SORT) {
+        for (i = 1; i < n; i++) {
+            t = tosort[i];
+            k = half_sort_key(v[t]);
+            for (j = i; j > 0 && half_sort_key(v[tosort[j-1]]) > k; j--) {
+                tosort[j] = tosort[j-1];
             }
+            tosort[j] = t;
+        }
+        return 0;
+    }
+    return half_radix_argsort(v, tosort, n);
+}
+
+/*
+ * Partitions a row of n halves, or its indices when idx is given, like
+ * np.partition: the elements at the sorted kth positions are in place,
+ * with nothing greater before them and nothing smaller after.  Long rows
+ * are selected with a histogram of the 16-bit keys.  The distinct keys of
+ * the kth elements split the keys into groups, and one scatter pass puts
+ * every element into its group.  Short rows are sorted.  kth must be
+ * sorted.  The scratch space is a row in buf, 65536 entries in count and
+ * group, and nkth in keys and 2*nkth+1 in off.
+ */
+static int
+half_partition_row(npy_half *v, npy_intp n, const npy_intp *kth,
+                   npy_intp nkth, npy_intp *idx, void *buf, npy_intp *count,
+                   npy_uint16 *group, npy_uint16 *keys, npy_intp *off)
+{
+    npy_intp i, j, m, cum, c;
+    npy_uint32 k;
+
+    if (n < HALF_COUNTING_SORT || nkth > 0x7fff) {
+        if (idx == NULL) {
+            return HALF_quicksort(v, n, NULL);
+        }
+        for (i = 0; i < n; i++) {
+            idx[i] = i;
+        }
+        return HALF_argsort(v, idx, n, NULL);
+    }
+
+    memset(count, 0, 0x10000 * sizeof(npy_intp));
+    for (i = 0; i < n; i++) {
+        count[half_sort_key(v[i])]++;
+    }
+    /* The distinct keys of the kth elements */
+    m = 0;
+    cum = 0;
+    k = 0;
+    for (j = 0; j < nkth; j++) {
+        while (cum + count[k] <= kth[j]) {
+            cum += count[k++];
+        }
+        if (m == 0 || keys[m-1] != k) {
+            keys[m++] = (npy_uint16)k;
+        }
+    }
+    /* Keys between the jth and the next one go to group 2j, the jth to 2j+1 */
+    memset(off, 0, (2*m + 1) * sizeof(npy_intp));
+    for (k = 0, j = 0; k < 0x10000u; k++) {
+        if (j < m && k == keys[j]) {
+            group[k] = (npy_uint16)(2*j + 1);
+            j++;
+        }
+        else {
+            group[k] = (npy_uint16)(2*j);
+        }
+        off[group[k]] += count[k];
+    }
+    for (j = 0, cum = 0; j < 2*m + 1; j++) {
+        c = off[j];
+        off[j] = cum;
+        cum += c;
+    }
+    if (idx == NULL) {
+        for (i = 0; i < n; i++) {
+            ((npy_half *)buf)[off[group[half_sort_key(v[i])]]++] = v[i];
+        }
+        memcpy(v, buf, n * sizeof(npy_half));
+    }
+    else {
+        for (i = 0; i < n; i++) {
+            idx[off[group[half_sort_key(v[i])]]++] = i;
         }
     }
     return 0;
 }
 
+/* How HALF_dot accumulates, see half_dot_n */
+static int half_dot_accumulate = HALF_DOT_PAIRWISE;
+
+#define HALF_DOT_GATHER 1024
+
 static void
 HALF_dot(char *ip1, npy_intp is1, char *ip2, npy_intp is2, char *op, npy_intp n,
            void *NPY_UNUSED(ignore))
 {
-    float tmp = 0.0f;
-    npy_intp i;
+    npy_half buf1[HALF_DOT_GATHER], buf2[HALF_DOT_GATHER];
+    npy_intp i, block, nblock = 0, k;
+    float part[64], sum = 0.0f;
+    double tmp = 0.0, dot;
+    int top = 0;
 
-    for (i = 0; i < n; i++, ip1 += is1, ip2 += is2) {
-        tmp += half_to_float(*((npy_half *)ip1)) *
-               half_to_float(*((npy_half *)ip2));
+    if (is1 == sizeof(npy_half) && is2 == sizeof(npy_half)) {
+        tmp = half_dot_n((npy_half *)ip1, (npy_half *)ip2, n,
+                         half_dot_accumulate);
+    }
+    else {
+        /*
+         * gather strided operands so they run through the same kernels,
+         * and sum the blocks the way the mode sums within them
+         */
+        while (n > 0) {
+            block = n < HALF_DOT_GATHER ? n : HALF_DOT_GATHER;
+            for (i = 0; i < block; i++, ip1 += is1, ip2 += is2) {
+                buf1[i] = *((npy_half *)ip1);
+                buf2[i] = *((npy_half *)ip2);
+            }
+            dot = half_dot_n(buf1, buf2, block, half_dot_accumulate);
+            if (half_dot_accumulate == HALF_DOT_DOUBLE) {
+                tmp += dot;
+            }
+            else if (half_dot_accumulate == HALF_DOT_PAIRWISE) {
+                /* a binary counter of partial sums, one per level */
+                sum = (float)dot;
+                for (k = nblock++; k & 1; k >>= 1) {
+                    sum = part[--top] + sum;
+                }
+                part[top++] = sum;
+            }
+            else {
+                sum += (float)dot;
+            }
+            n -= block;
+        }
+        if (half_dot_accumulate == HALF_DOT_PAIRWISE) {
+            for (sum = 0.0f; top > 0; ) {
+                sum = part[--top] + sum;
+            }
+        }
+        if (half_dot_accumulate != HALF_DOT_DOUBLE) {
+            tmp = sum;
+        }
     }
-    *((npy_half *)op) = float_to_half(tmp);
+    *((npy_half *)op) = double_to_half(tmp);
 }
 
 /*
- * NumPyOS isn't exported, so skipping scan and fromstr
+ * Text parsing with half_strtoh, as NumPyOS_ascii_strtod isn't exported.
+ * scan reads all the characters that can be part of a number, and leaves
+ * the first other one in the stream.  Tokens longer than HALF_SCAN_LENGTH
+ * move to a buffer on the heap.
+ */
+#define HALF_SCAN_LENGTH 64
+
 static int
-HALF_scan(FILE *fp, npy_half *ip, void *NPY_UNUSED(ignore), PyArray_Descr *NPY_UNUSED(ignored))
+HALF_scan(FILE *fp, npy_half *ip, void *NPY_UNUSED(ignore),
+          PyArray_Descr *NPY_UNUSED(ignored))
 {
-    double result;
-    int ret;
+    char stack[HALF_SCAN_LENGTH + 1], *buf = stack, *grown, *end;
+    size_t n = 0, size = sizeof(stack);
+    int c, ret = 1;
 
-    ret = NumPyOS_ascii_ftolf(fp, &result);
-    *ip = double_to_half(result);
+    do {
+        c = getc(fp);
+    } while (c == ' ' || (c >= '\t' && c <= '\r'));
+    if (c == EOF) {
+        return EOF;
+    }
+    while (c != EOF &&
+           ((c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.' ||
+            strchr("eEiInNfFaAtTyY", c) != NULL)) {
+        if (n + 1 == size) {
+            grown = (char *)(buf == stack ? malloc(2*size)
+                                          : realloc(buf, 2*size));
+            if (grown == NULL) {
+                ret = 0;
+                break;
+            }
+            if (buf == stack) {
+                memcpy(grown, stack, n);
+            }
+            buf = grown;
+            size *= 2;
+        }
+        buf[n++] = (char)c;
+        c = getc(fp);
+    }
+    if (c != EOF) {
+        ungetc(c, fp);
+    }
+    buf[n] = '\0';
+    *ip = half_strtoh(buf, &end);
+    /* a token cut short by a failed allocation doesn't match */
+    ret = ret && end != buf;
+    if (buf != stack) {
+        free(buf);
+    }
     return ret;
 }
 
 static int
-HALF_fromstr(char *str, npy_half *ip, char **endptr, PyArray_Descr *NPY_UNUSED(ignore))
+HALF_fromstr(char *str, npy_half *ip, char **endptr,
+             PyArray_Descr *NPY_UNUSED(ignore))
 {
-    double result;
-
-    result = NumPyOS_ascii_strtod(str, endptr);
-    *ip = double_to_half(result);
+    *ip = half_strtoh(str, endptr);
     return 0;
 }
-*/
 
 static npy_bool
 HALF_nonzero (char *ip, PyArrayObject *ap)
 {
-    if (ap == NULL || PyArray_ISBEHAVED_RO(ap)) {
-        npy_half *ptmp = (npy_half *)ip;
-        return (npy_bool) (((*ptmp)&0x7fff) != 0);
-    }
-    else {
-        npy_half tmp;
-        ap->descr->f->copyswap(&tmp, ip, !PyArray_ISNOTSWAPPED(ap), ap);
-        return (npy_bool) ((tmp&0x7fff) != 0);
-    }
+    return (npy_bool) ((half_load_item(ip, ap)&0x7fff) != 0);
 }
 
 static void
@@ -444,33 +997,340 @@ HALF_fillwithscalar(npy_half *buffer, npy_intp length, npy_half *value, void *NP
     }
 }
 
-static void
-HALF_to_FLOAT(npy_half *ip, npy_uint32 *op, npy_intp n,
-               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
-{
-    while (n--) {
-        *op++ = halfbits_to_floatbits(*ip++);
-    }
+/*
+ * A pool of worker threads for large loops.  half_parallel_run splits
+ * [0, n) into one part per thread, in multiples of HALF_PARALLEL_ALIGN
+ * elements, runs the first part itself and the rest on the workers,
+ * which are started on first use.  Loops shorter than
+ * HALF_PARALLEL_GRAIN elements per thread run serially, as does anything
+ * started while the pool is busy, including the parts themselves.  The
+ * GIL is released while the parts run, and the FP status the workers
+ * raise is passed back to the calling thread, where numpy checks it.
+ * The default thread count is OMP_NUM_THREADS when that is set, and
+ * otherwise the number of CPUs the process may run on.
+ */
+#define HALF_MAX_THREADS 64
+#define HALF_PARALLEL_GRAIN 65536
+#define HALF_PARALLEL_ALIGN 64
+
+typedef void (*half_part_func)(void *ctx, npy_intp start, npy_intp len);
+
+static int half_num_threads = 0;  /* 0 until set or first used */
+
+static int
+half_cpu_count(void)
+{
+#if HALF_HAVE_THREADS
+    const char *env = getenv("OMP_NUM_THREADS");
+    long ncpu = 0;
+#ifdef CPU_COUNT
+    cpu_set_t set;
+#endif
+
+    if (env != NULL) {
+        /* of a nested list like "4,2" the first level is ours */
+        ncpu = strtol(env, NULL, 10);
+    }
+#ifdef CPU_COUNT
+    if (ncpu < 1 && sched_getaffinity(0, sizeof(set), &set) == 0) {
+        ncpu = CPU_COUNT(&set);
+    }
+#endif
+    if (ncpu < 1) {
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (ncpu < 1) {
+        return 1;
+    }
+    return ncpu > HALF_MAX_THREADS ? HALF_MAX_THREADS : (int)ncpu;
+#else
+    return 1;
+#endif
+}
+
+static int
+half_get_num_threads(void)
+{
+    if (half_num_threads == 0) {
+        half_num_threads = half_cpu_count();
+    }
+    return half_num_threads;
+}
+
+#if HALF_HAVE_THREADS
+
+static struct {
+    pthread_mutex_t busy;       /* held by the thread running a job */
+    pthread_mutex_t lock;       /* protects the fields below */
+    pthread_cond_t work, done;
+    int nworkers;
+    unsigned long generation;   /* bumped for each job */
+    half_part_func func;
+    void *ctx;
+    npy_intp n, chunk;
+    int nparts, pending, fpstatus;
+} half_pool = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    0, 0, NULL, NULL, 0, 0, 0, 0, 0
+};
+
+static void
+half_pool_run_part(int part)
+{
+    npy_intp start = part*half_pool.chunk;
+    npy_intp len = half_pool.n - start;
+
+    if (len > half_pool.chunk) {
+        len = half_pool.chunk;
+    }
+    half_pool.func(half_pool.ctx, start, len);
+}
+
+static void *
+half_pool_worker(void *arg)
+{
+    int part = (int)(npy_intp)arg + 1, status;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&half_pool.lock);
+    for (;;) {
+        while (half_pool.generation == seen) {
+            pthread_cond_wait(&half_pool.work, &half_pool.lock);
+        }
+        seen = half_pool.generation;
+        if (part >= half_pool.nparts) {
+            continue;
+        }
+        pthread_mutex_unlock(&half_pool.lock);
+
+        npy_clear_floatstatus_barrier((char *)&status);
+        half_pool_run_part(part);
+        status = npy_get_floatstatus_barrier((char *)&status);
+
+        pthread_mutex_lock(&half_pool.lock);
+        half_pool.fpstatus |= status;
+        if (--half_pool.pending == 0) {
+            pthread_cond_signal(&half_pool.done);
+        }
+    }
+    return NULL;
+}
+
+/* The workers do not survive a fork, the child starts a new pool */
+static void
+half_pool_atfork_child(void)
+{
+    pthread_mutex_init(&half_pool.busy, NULL);
+    pthread_mutex_init(&half_pool.lock, NULL);
+    pthread_cond_init(&half_pool.work, NULL);
+    pthread_cond_init(&half_pool.done, NULL);
+    half_pool.nworkers = 0;
+}
+
+static int
+half_parallel_run(npy_intp n, half_part_func func, void *ctx)
+{
+    NPY_BEGIN_THREADS_DEF;
+    pthread_t thread;
+    npy_intp chunk;
+    int nparts, status, holds_gil;
+
+    nparts = half_get_num_threads();
+    if (n / HALF_PARALLEL_GRAIN < nparts) {
+        nparts = (int)(n / HALF_PARALLEL_GRAIN);
+    }
+    if (nparts < 2 || pthread_mutex_trylock(&half_pool.busy) != 0) {
+        return 0;
+    }
+    chunk = (n + nparts - 1) / nparts;
+    chunk += HALF_PARALLEL_ALIGN - 1 - (chunk - 1) % HALF_PARALLEL_ALIGN;
+    nparts = (int)((n + chunk - 1) / chunk);
+
+    holds_gil = PyGILState_Check();
+    if (holds_gil) {
+        NPY_BEGIN_THREADS;
+    }
+    pthread_mutex_lock(&half_pool.lock);
+    while (half_pool.nworkers < nparts - 1) {
+        if (pthread_create(&thread, NULL, half_pool_worker,
+                           (void *)(npy_intp)half_pool.nworkers) != 0) {
+            break;
+        }
+        pthread_detach(thread);
+        half_pool.nworkers++;
+    }
+    if (nparts > half_pool.nworkers + 1) {
+        /* not enough workers could be started, run it all here */
+        chunk = n;
+        nparts = 1;
+    }
+    half_pool.func = func;
+    half_pool.ctx = ctx;
+    half_pool.n = n;
+    half_pool.chunk = chunk;
+    half_pool.nparts = nparts;
+    half_pool.pending = nparts - 1;
+    half_pool.fpstatus = 0;
+    half_pool.generation++;
+    pthread_cond_broadcast(&half_pool.work);
+    pthread_mutex_unlock(&half_pool.lock);
+
+    half_pool_run_part(0);
+
+    pthread_mutex_lock(&half_pool.lock);
+    while (half_pool.pending > 0) {
+        pthread_cond_wait(&half_pool.done, &half_pool.lock);
+    }
+    status = half_pool.fpstatus;
+    pthread_mutex_unlock(&half_pool.lock);
+    pthread_mutex_unlock(&half_pool.busy);
+    if (holds_gil) {
+        NPY_END_THREADS;
+    }
+
+    if (status & NPY_FPE_DIVIDEBYZERO) {
+        npy_set_floatstatus_divbyzero();
+    }
+    if (status & NPY_FPE_OVERFLOW) {
+        npy_set_floatstatus_overflow();
+    }
+    if (status & NPY_FPE_UNDERFLOW) {
+        npy_set_floatstatus_underflow();
+    }
+    if (status & NPY_FPE_INVALID) {
+        npy_set_floatstatus_invalid();
+    }
+    return 1;
+}
+
+#else
+
+static int
+half_parallel_run(npy_intp NPY_UNUSED(n), half_part_func NPY_UNUSED(func),
+                  void *NPY_UNUSED(ctx))
+{
+    return 0;
+}
+
+#endif /* HALF_HAVE_THREADS */
+
+/* Splits a cast between the threads, see half_parallel_run */
+typedef struct {
+    PyArray_VectorUnaryFunc *cast;
+    char *ip, *op;
+    npy_intp is, os;
+} half_cast_ctx;
+
+static void
+half_cast_part(void *ctx, npy_intp start, npy_intp len)
+{
+    half_cast_ctx *c = (half_cast_ctx *)ctx;
+
+    c->cast(c->ip + start*c->is, c->op + start*c->os, len, NULL, NULL);
+}
+
+static int
+half_cast_parallel(PyArray_VectorUnaryFunc *cast, void *ip, npy_intp is,
+                   void *op, npy_intp os, npy_intp n)
+{
+    half_cast_ctx ctx;
+
+    ctx.cast = cast;
+    ctx.ip = (char *)ip;
+    ctx.op = (char *)op;
+    ctx.is = is;
+    ctx.os = os;
+    return half_parallel_run(n, half_cast_part, &ctx);
+}
+
+/* Splits a 1-d ufunc loop between the threads, see half_parallel_run */
+typedef struct {
+    PyUFuncGenericFunction loop;
+    char **args;
+    npy_intp const *steps;
+    int nargs;
+} half_loop_ctx;
+
+static void
+half_loop_part(void *ctx, npy_intp start, npy_intp len)
+{
+    half_loop_ctx *c = (half_loop_ctx *)ctx;
+    char *args[3];
+    int i;
+
+    for (i = 0; i < c->nargs; i++) {
+        args[i] = c->args[i] + start*c->steps[i];
+    }
+    c->loop(args, &len, c->steps, NULL);
+}
+
+static int
+half_loop_parallel(PyUFuncGenericFunction loop, char **args,
+                   npy_intp const *dimensions, npy_intp const *steps,
+                   int nargs)
+{
+    half_loop_ctx ctx;
+
+    /* reductions write to the same element throughout */
+    if (steps[nargs - 1] == 0) {
+        return 0;
+    }
+    ctx.loop = loop;
+    ctx.args = args;
+    ctx.steps = steps;
+    ctx.nargs = nargs;
+    return half_parallel_run(dimensions[0], half_loop_part, &ctx);
+}
+
+/*
+ * The casts gather a block at a time into a contiguous buffer when the
+ * other side is strided or wider, so they can use the bulk conversions.
+ */
+#define HALF_CAST_BLOCK 512
+
+static void
+HALF_to_FLOAT(npy_half *ip, npy_uint32 *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)HALF_to_FLOAT,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    halfbits_to_floatbits_n(ip, op, n);
 }
 
 static void
 HALF_to_DOUBLE(npy_half *ip, npy_uint64 *op, npy_intp n,
                PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
 {
-    while (n--) {
-        *op++ = halfbits_to_doublebits(*ip++);
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)HALF_to_DOUBLE,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
     }
+    halfbits_to_doublebits_n(ip, op, n);
 }
 
 static void
 HALF_to_LONGDOUBLE(npy_half *ip, npy_longdouble *op, npy_intp n,
                PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
 {
-    npy_uint32 temp;
+    double buf[HALF_CAST_BLOCK];
+    npy_intp i, block;
 
-    while (n--) {
-        temp = halfbits_to_floatbits(*ip++);
-        *op++ = *((double*)&temp);
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)HALF_to_LONGDOUBLE,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    while (n > 0) {
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;
+        halfbits_to_doublebits_n(ip, (npy_uint64 *)buf, block);
+        for (i = 0; i < block; i++) {
+            op[i] = buf[i];
+        }
+        ip += block;
+        op += block;
+        n -= block;
     }
 }
 
@@ -478,9 +1338,23 @@ static void
 HALF_to_CFLOAT(npy_half *ip, npy_uint32 *op, npy_intp n,
                PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
 {
-    while (n--) {
-        *op++ = halfbits_to_floatbits(*ip++);
-        *op++ = 0;
+    npy_uint32 buf[HALF_CAST_BLOCK];
+    npy_intp i, block;
+
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)HALF_to_CFLOAT,
+                           ip, sizeof(*ip), op, 2*sizeof(*op), n)) {
+        return;
+    }
+    while (n > 0) {
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;
+        halfbits_to_floatbits_n(ip, buf, block);
+        for (i = 0; i < block; i++) {
+            op[2*i] = buf[i];
+            op[2*i + 1] = 0;
+        }
+        ip += block;
+        op += 2*block;
+        n -= block;
     }
 }
 
@@ -488,9 +1362,23 @@ static void
 HALF_to_CDOUBLE(npy_half *ip, npy_uint64 *op, npy_intp n,
                PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
 {
-    while (n--) {
-        *op++ = halfbits_to_doublebits(*ip++);
-        *op++ = 0;
+    npy_uint64 buf[HALF_CAST_BLOCK];
+    npy_intp i, block;
+
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)HALF_to_CDOUBLE,
+                           ip, sizeof(*ip), op, 2*sizeof(*op), n)) {
+        return;
+    }
+    while (n > 0) {
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;
+        halfbits_to_doublebits_n(ip, buf, block);
+        for (i = 0; i < block; i++) {
+            op[2*i] = buf[i];
+            op[2*i + 1] = 0;
+        }
+        ip += block;
+        op += 2*block;
+        n -= block;
     }
 }
 
@@ -498,12 +1386,23 @@ static void
 HALF_to_CLONGDOUBLE(npy_half *ip, npy_longdouble *op, npy_intp n,
                PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
 {
-    npy_uint32 temp;
+    double buf[HALF_CAST_BLOCK];
+    npy_intp i, block;
 
-    while (n--) {
-        temp = halfbits_to_floatbits(*ip++);
-        *op++ = *((float*)&temp);
-        *op++ = 0.0;
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)HALF_to_CLONGDOUBLE,
+                           ip, sizeof(*ip), op, 2*sizeof(*op), n)) {
+        return;
+    }
+    while (n > 0) {
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;
+        halfbits_to_doublebits_n(ip, (npy_uint64 *)buf, block);
+        for (i = 0; i < block; i++) {
+            op[2*i] = buf[i];
+            op[2*i + 1] = 0.0;
+        }
+        ip += block;
+        op += 2*block;
+        n -= block;
     }
 }
 
@@ -512,11 +1411,22 @@ static void                                                                    \
 HALF_to_ ## TYPE(npy_half *ip, type *op, npy_intp n,                           \
                PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
 {                                                                              \
-    npy_uint32 temp;                                                           \
+    float buf[HALF_CAST_BLOCK];                                                \
+    npy_intp i, block;                                                         \
                                                                                \
-    while (n--) {                                                              \
-        temp = halfbits_to_floatbits(*ip++);                                   \
-        *op++ = (type)*((float*)&temp);                                        \
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)HALF_to_ ## TYPE, ip,    \
+                           sizeof(*ip), op, sizeof(*op), n)) {                 \
+        return;                                                                \
+    }                                                                          \
+    while (n > 0) {                                                            \
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;                     \
+        halfbits_to_floatbits_n(ip, (npy_uint32 *)buf, block);                 \
+        for (i = 0; i < block; i++) {                                          \
+            op[i] = (type)buf[i];                                              \
+        }                                                                      \
+        ip += block;                                                           \
+        op += block;                                                           \
+        n -= block;                                                            \
     }                                                                          \
 }
 
@@ -536,183 +1446,2354 @@ static void
 FLOAT_to_HALF(npy_uint32 *ip, npy_half *op, npy_intp n,
                PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
 {
-    while (n--) {
-        *op++ = floatbits_to_halfbits(*ip++);
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)FLOAT_to_HALF,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
     }
+    floatbits_to_halfbits_n(ip, op, n);
 }
  
 static void
 DOUBLE_to_HALF(npy_uint64 *ip, npy_half *op, npy_intp n,
                PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
 {
-    while (n--) {
-        *op++ = doublebits_to_halfbits(*ip++);
-    }
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)DOUBLE_to_HALF,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    doublebits_to_halfbits_n(ip, op, n);
+}
+
+static void
+LONGDOUBLE_to_HALF(npy_longdouble *ip, npy_half *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    double buf[HALF_CAST_BLOCK];
+    npy_intp i, block;
+
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)LONGDOUBLE_to_HALF,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    while (n > 0) {
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;
+        for (i = 0; i < block; i++) {
+            buf[i] = (double)ip[i];
+        }
+        doublebits_to_halfbits_n((npy_uint64 *)buf, op, block);
+        ip += block;
+        op += block;
+        n -= block;
+    }
+}
+
+static void
+CFLOAT_to_HALF(npy_uint32 *ip, npy_half *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    npy_uint32 buf[HALF_CAST_BLOCK];
+    npy_intp i, block;
+
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)CFLOAT_to_HALF,
+                           ip, 2*sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    while (n > 0) {
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;
+        for (i = 0; i < block; i++) {
+            buf[i] = ip[2*i];
+        }
+        floatbits_to_halfbits_n(buf, op, block);
+        ip += 2*block;
+        op += block;
+        n -= block;
+    }
+}
+
+static void
+CDOUBLE_to_HALF(npy_uint64 *ip, npy_half *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    npy_uint64 buf[HALF_CAST_BLOCK];
+    npy_intp i, block;
+
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)CDOUBLE_to_HALF,
+                           ip, 2*sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    while (n > 0) {
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;
+        for (i = 0; i < block; i++) {
+            buf[i] = ip[2*i];
+        }
+        doublebits_to_halfbits_n(buf, op, block);
+        ip += 2*block;
+        op += block;
+        n -= block;
+    }
+}
+
+static void
+CLONGDOUBLE_to_HALF(npy_longdouble *ip, npy_half *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    double buf[HALF_CAST_BLOCK];
+    npy_intp i, block;
+
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)CLONGDOUBLE_to_HALF,
+                           ip, 2*sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    while (n > 0) {
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;
+        for (i = 0; i < block; i++) {
+            buf[i] = (double)ip[2*i];
+        }
+        doublebits_to_halfbits_n((npy_uint64 *)buf, op, block);
+        ip += 2*block;
+        op += block;
+        n -= block;
+    }
+}
+
+
+#define MAKE_T_TO_HALF(TYPE, type)                                             \
+static void                                                                    \
+TYPE ## _to_HALF(type *ip, npy_half *op, npy_intp n,                           \
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
+{                                                                              \
+    float buf[HALF_CAST_BLOCK];                                                \
+    npy_intp i, block;                                                         \
+                                                                               \
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)TYPE ## _to_HALF, ip,    \
+                           sizeof(*ip), op, sizeof(*op), n)) {                 \
+        return;                                                                \
+    }                                                                          \
+    while (n > 0) {                                                            \
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;                     \
+        for (i = 0; i < block; i++) {                                          \
+            buf[i] = (float)ip[i];                                             \
+        }                                                                      \
+        floatbits_to_halfbits_n((npy_uint32 *)buf, op, block);                 \
+        ip += block;                                                           \
+        op += block;                                                           \
+        n -= block;                                                            \
+    }                                                                          \
+}
+
+MAKE_T_TO_HALF(BOOL, npy_bool);
+MAKE_T_TO_HALF(BYTE, npy_byte);
+MAKE_T_TO_HALF(UBYTE, npy_ubyte);
+MAKE_T_TO_HALF(SHORT, npy_short);
+MAKE_T_TO_HALF(USHORT, npy_ushort);
+MAKE_T_TO_HALF(INT, npy_int);
+MAKE_T_TO_HALF(UINT, npy_uint);
+MAKE_T_TO_HALF(LONG, npy_long);
+MAKE_T_TO_HALF(ULONG, npy_ulong);
+MAKE_T_TO_HALF(LONGLONG, npy_longlong);
+MAKE_T_TO_HALF(ULONGLONG, npy_ulonglong);
+
+
+/*
+ * Arithmetic ufunc loops.  The operands are widened a block at a time
+ * with the bulk conversions, combined in float32, and each result is
+ * narrowed once, so no full size float32 temporaries are needed.  The
+ * blocks are float arrays; bits computed here are stored with memcpy.
+ */
+#define HALF_LOOP_BLOCK 256
+
+static void
+half_load_block(char *ip, npy_intp is, npy_intp n, float *out)
+{
+    const npy_uint32 *table;
+    npy_half buf[HALF_LOOP_BLOCK];
+    npy_intp i;
+
+    if (is == sizeof(npy_half)) {
+        halfbits_to_floatbits_n((npy_half *)ip, (npy_uint32 *)out, n);
+    }
+    else if (is == 0) {
+        float value = half_to_float(*(npy_half *)ip);
+        for (i = 0; i < n; i++) {
+            out[i] = value;
+        }
+    }
+    else if ((table = half_float_table()) != NULL) {
+        for (i = 0; i < n; i++, ip += is) {
+            memcpy(&out[i], &table[*(npy_half *)ip], sizeof(float));
+        }
+    }
+    else {
+        for (i = 0; i < n; i++, ip += is) {
+            buf[i] = *(npy_half *)ip;
+        }
+        halfbits_to_floatbits_n(buf, (npy_uint32 *)out, n);
+    }
+}
+
+static void
+half_store_block(float *in, npy_intp n, char *op, npy_intp os)
+{
+    npy_half buf[HALF_LOOP_BLOCK];
+    npy_intp i;
+
+    if (os == sizeof(npy_half)) {
+        floatbits_to_halfbits_n((npy_uint32 *)in, (npy_half *)op, n);
+    }
+    else {
+        floatbits_to_halfbits_n((npy_uint32 *)in, buf, n);
+        for (i = 0; i < n; i++, op += os) {
+            *(npy_half *)op = buf[i];
+        }
+    }
+}
+
+/*
+ * Reductions are passed the initial value and the operand, and
+ * accumulate the operand in float32, pairwise, for sums and in float64
+ * for products, narrowing once at the end.  load widens the operand
+ * (halves or bfloat16s) to float32 a block at a time.
+ */
+typedef void (half_load_func)(char *ip, npy_intp is, npy_intp n,
+                              float *out);
+
+static float
+half_sum(half_load_func *load, char *ip, npy_intp is, npy_intp n)
+{
+    float buf[HALF_LOOP_BLOCK], r[8];
+    npy_intp i, n2;
+    int j;
+
+    if (n > HALF_LOOP_BLOCK) {
+        n2 = n / 2;
+        n2 -= n2 % 8;
+        return half_sum(load, ip, is, n2) +
+               half_sum(load, ip + n2*is, is, n - n2);
+    }
+    load(ip, is, n, buf);
+    for (j = 0; j < 8; j++) {
+        r[j] = 0.0f;
+    }
+    for (i = 0; i + 8 <= n; i += 8) {
+        for (j = 0; j < 8; j++) {
+            r[j] += buf[i + j];
+        }
+    }
+    for (j = 0; i < n; i++, j++) {
+        r[j] += buf[i];
+    }
+    return ((r[0] + r[1]) + (r[2] + r[3])) + ((r[4] + r[5]) + (r[6] + r[7]));
+}
+
+static double
+half_prod(half_load_func *load, char *ip, npy_intp is, npy_intp n)
+{
+    float buf[HALF_LOOP_BLOCK];
+    double r[8], ret = 1.0;
+    npy_intp i, block;
+    int j;
+
+    while (n > 0) {
+        block = n < HALF_LOOP_BLOCK ? n : HALF_LOOP_BLOCK;
+        load(ip, is, block, buf);
+        for (j = 0; j < 8; j++) {
+            r[j] = 1.0;
+        }
+        for (i = 0; i + 8 <= block; i += 8) {
+            for (j = 0; j < 8; j++) {
+                r[j] *= buf[i + j];
+            }
+        }
+        for (j = 0; i < block; i++, j++) {
+            r[j] *= buf[i];
+        }
+        ret *= ((r[0] * r[1]) * (r[2] * r[3])) * ((r[4] * r[5]) * (r[6] * r[7]));
+        ip += block*is;
+        n -= block;
+    }
+    return ret;
+}
+
+static npy_half
+half_reduce_add(npy_half acc, char *ip, npy_intp is, npy_intp n)
+{
+    return float_to_half(half_to_float(acc) + half_sum(half_load_block, ip, is, n));
+}
+
+static npy_half
+half_reduce_subtract(npy_half acc, char *ip, npy_intp is, npy_intp n)
+{
+    return float_to_half(half_to_float(acc) - half_sum(half_load_block, ip, is, n));
+}
+
+static npy_half
+half_reduce_multiply(npy_half acc, char *ip, npy_intp is, npy_intp n)
+{
+    return double_to_half(half_to_double(acc) * half_prod(half_load_block, ip, is, n));
+}
+
+static npy_half
+half_reduce_divide(npy_half acc, char *ip, npy_intp is, npy_intp n)
+{
+    return double_to_half(half_to_double(acc) / half_prod(half_load_block, ip, is, n));
+}
+
+#define MAKE_BINARY_LOOP(FUNC, OP, REDUCE, LOAD, STORE)                        \
+static void                                                                    \
+FUNC(char **args, npy_intp const *dimensions, npy_intp const *steps,           \
+     void *NPY_UNUSED(data))                                                   \
+{                                                                              \
+    char *ip1 = args[0], *ip2 = args[1], *op = args[2];                        \
+    npy_intp is1 = steps[0], is2 = steps[1], os = steps[2];                    \
+    npy_intp n = dimensions[0], i, block;                                      \
+    float a[HALF_LOOP_BLOCK], b[HALF_LOOP_BLOCK];                              \
+                                                                               \
+    if (half_loop_parallel(FUNC, args, dimensions, steps, 3)) {                \
+        return;                                                                \
+    }                                                                          \
+    if (ip1 == op && is1 == 0 && os == 0) {                                    \
+        *(npy_uint16 *)op = REDUCE(*(npy_uint16 *)op, ip2, is2, n);            \
+        return;                                                                \
+    }                                                                          \
+    while (n > 0) {                                                            \
+        block = n < HALF_LOOP_BLOCK ? n : HALF_LOOP_BLOCK;                     \
+        LOAD(ip1, is1, block, a);                                              \
+        LOAD(ip2, is2, block, b);                                              \
+        for (i = 0; i < block; i++) {                                          \
+            a[i] = a[i] OP b[i];                                               \
+        }                                                                      \
+        STORE(a, block, op, os);                                               \
+        ip1 += block*is1;                                                      \
+        ip2 += block*is2;                                                      \
+        op += block*os;                                                        \
+        n -= block;                                                            \
+    }                                                                          \
+}
+
+#define MAKE_HALF_BINARY_LOOP(NAME, OP)                                        \
+    MAKE_BINARY_LOOP(HALF_ ## NAME, OP, half_reduce_ ## NAME,                  \
+                     half_load_block, half_store_block)
+
+MAKE_HALF_BINARY_LOOP(add, +);
+MAKE_HALF_BINARY_LOOP(subtract, -);
+MAKE_HALF_BINARY_LOOP(multiply, *);
+MAKE_HALF_BINARY_LOOP(divide, /);
+
+
+/*
+ * Comparison ufunc loops, on the bit patterns with the SIMD bulk
+ * comparisons.  Strided operands are gathered a block at a time.
+ */
+static npy_half *
+half_compare_block(char *ip, npy_intp is, npy_intp n, npy_half *buf,
+                   npy_intp *stride)
+{
+    npy_intp i;
+
+    if (is == 0 || is == sizeof(npy_half)) {
+        *stride = is / (npy_intp)sizeof(npy_half);
+        return (npy_half *)ip;
+    }
+    for (i = 0; i < n; i++, ip += is) {
+        buf[i] = *(npy_half *)ip;
+    }
+    *stride = 1;
+    return buf;
+}
+
+#define MAKE_HALF_COMPARE_LOOP(NAME, BULK, A, B)                               \
+static void                                                                    \
+HALF_ ## NAME(char **args, npy_intp const *dimensions, npy_intp const *steps,  \
+              void *NPY_UNUSED(data))                                          \
+{                                                                              \
+    char *ip1 = args[A], *ip2 = args[B], *op = args[2];                        \
+    npy_intp is1 = steps[A], is2 = steps[B], os = steps[2];                    \
+    npy_intp n = dimensions[0], i, block, s1, s2;                              \
+    npy_half buf1[HALF_LOOP_BLOCK], buf2[HALF_LOOP_BLOCK];                     \
+    npy_bool bufo[HALF_LOOP_BLOCK];                                            \
+    npy_half *p1, *p2;                                                         \
+                                                                               \
+    if (half_loop_parallel(HALF_ ## NAME, args, dimensions, steps, 3)) {       \
+        return;                                                                \
+    }                                                                          \
+    while (n > 0) {                                                            \
+        block = n < HALF_LOOP_BLOCK ? n : HALF_LOOP_BLOCK;                     \
+        p1 = half_compare_block(ip1, is1, block, buf1, &s1);                   \
+        p2 = half_compare_block(ip2, is2, block, buf2, &s2);                   \
+        if (os == 1) {                                                         \
+            BULK(p1, s1, p2, s2, (npy_bool *)op, block);                       \
+        }                                                                      \
+        else {                                                                 \
+            BULK(p1, s1, p2, s2, bufo, block);                                 \
+            for (i = 0; i < block; i++) {                                      \
+                *(npy_bool *)(op + i*os) = bufo[i];                            \
+            }                                                                  \
+        }                                                                      \
+        ip1 += block*is1;                                                      \
+        ip2 += block*is2;                                                      \
+        op += block*os;                                                        \
+        n -= block;                                                            \
+    }                                                                          \
+}
+
+MAKE_HALF_COMPARE_LOOP(equal, half_eq_n, 0, 1);
+MAKE_HALF_COMPARE_LOOP(not_equal, half_ne_n, 0, 1);
+MAKE_HALF_COMPARE_LOOP(less, half_lt_n, 0, 1);
+MAKE_HALF_COMPARE_LOOP(less_equal, half_le_n, 0, 1);
+MAKE_HALF_COMPARE_LOOP(greater, half_lt_n, 1, 0);
+MAKE_HALF_COMPARE_LOOP(greater_equal, half_le_n, 1, 0);
+
+/*
+ * maximum/minimum loops.  Reductions look for the extreme value of each
+ * block with half_argmax_n/half_argmin_n (of the whole run when it is
+ * contiguous), which find the first NaN just like the elementwise loops
+ * propagate it.
+ */
+#define MAKE_HALF_MAXMIN_LOOP(NAME, BULK, ARG, WANT_MAX)                       \
+static void                                                                    \
+HALF_ ## NAME(char **args, npy_intp const *dimensions, npy_intp const *steps,  \
+              void *NPY_UNUSED(data))                                          \
+{                                                                              \
+    char *ip1 = args[0], *ip2 = args[1], *op = args[2];                        \
+    npy_intp is1 = steps[0], is2 = steps[1], os = steps[2];                    \
+    npy_intp n = dimensions[0], i, block, s1, s2;                              \
+    npy_half buf1[HALF_LOOP_BLOCK], buf2[HALF_LOOP_BLOCK];                     \
+    npy_half bufo[HALF_LOOP_BLOCK];                                            \
+    npy_half *p1, *p2, acc;                                                    \
+                                                                               \
+    if (half_loop_parallel(HALF_ ## NAME, args, dimensions, steps, 3)) {       \
+        return;                                                                \
+    }                                                                          \
+    if (ip1 == op && is1 == 0 && os == 0) {                                    \
+        acc = *(npy_half *)op;                                                 \
+        while (n > 0 && !half_isnan(acc)) {                                    \
+            block = n < HALF_LOOP_BLOCK ? n : HALF_LOOP_BLOCK;                 \
+            if (is2 == sizeof(npy_half)) {                                     \
+                block = n;                                                     \
+            }                                                                  \
+            p2 = half_compare_block(ip2, is2, block, buf2, &s2);               \
+            acc = half_maxmin(acc, p2[s2 ? ARG(p2, block) : 0], WANT_MAX);     \
+            ip2 += block*is2;                                                  \
+            n -= block;                                                        \
+        }                                                                      \
+        *(npy_half *)op = acc;                                                 \
+        return;                                                                \
+    }                                                                          \
+    while (n > 0) {                                                            \
+        block = n < HALF_LOOP_BLOCK ? n : HALF_LOOP_BLOCK;                     \
+        p1 = half_compare_block(ip1, is1, block, buf1, &s1);                   \
+        p2 = half_compare_block(ip2, is2, block, buf2, &s2);                   \
+        if (os == sizeof(npy_half)) {                                          \
+            BULK(p1, s1, p2, s2, (npy_half *)op, block);                       \
+        }                                                                      \
+        else {                                                                 \
+            BULK(p1, s1, p2, s2, bufo, block);                                 \
+            for (i = 0; i < block; i++) {                                      \
+                *(npy_half *)(op + i*os) = bufo[i];                            \
+            }                                                                  \
+        }                                                                      \
+        ip1 += block*is1;                                                      \
+        ip2 += block*is2;                                                      \
+        op += block*os;                                                        \
+        n -= block;                                                            \
+    }                                                                          \
+}
+
+MAKE_HALF_MAXMIN_LOOP(maximum, half_maximum_n, half_argmax_n, 1);
+MAKE_HALF_MAXMIN_LOOP(minimum, half_minimum_n, half_argmin_n, 0);
+
+/*
+ * The matmul gufunc loop, (m,k),(k,n)->(m,n).  Strides that are not a
+ * whole number of elements cannot be passed to half_gemm and are
+ * handled element by element.
+ */
+static void
+HALF_matmul(char **args, npy_intp const *dimensions, npy_intp const *steps,
+            void *NPY_UNUSED(data))
+{
+    npy_intp dOuter = dimensions[0], m = dimensions[1], k = dimensions[2];
+    npy_intp n = dimensions[3], iOuter, i, j, p, e = sizeof(npy_half);
+    npy_intp a_rs = steps[3], a_cs = steps[4], b_rs = steps[5];
+    npy_intp b_cs = steps[6], c_rs = steps[7], c_cs = steps[8];
+    char *ip1 = args[0], *ip2 = args[1], *op = args[2];
+    npy_half h1, h2;
+    float tmp;
+
+    for (iOuter = 0; iOuter < dOuter; iOuter++,
+            ip1 += steps[0], ip2 += steps[1], op += steps[2]) {
+        if (a_rs % e == 0 && a_cs % e == 0 && b_rs % e == 0 &&
+                b_cs % e == 0 && c_rs % e == 0 && c_cs % e == 0) {
+            half_gemm(m, n, k, (npy_half *)ip1, a_rs / e, a_cs / e,
+                      (npy_half *)ip2, b_rs / e, b_cs / e,
+                      (npy_half *)op, c_rs / e, c_cs / e);
+            continue;
+        }
+        for (i = 0; i < m; i++) {
+            for (j = 0; j < n; j++) {
+                tmp = 0.0f;
+                for (p = 0; p < k; p++) {
+                    memcpy(&h1, ip1 + i*a_rs + p*a_cs, sizeof(h1));
+                    memcpy(&h2, ip2 + p*b_rs + j*b_cs, sizeof(h2));
+                    tmp += half_to_float(h1) * half_to_float(h2);
+                }
+                h1 = float_to_half(tmp);
+                memcpy(op + i*c_rs + j*c_cs, &h1, sizeof(h1));
+            }
+        }
+    }
+}
+
+
+/*
+ * bfloat16 array functions, casts and ufunc loops.  They widen to
+ * float32 a block at a time like the xfloat16 ones; comparisons and
+ * maximum/minimum work on the bits.
+ */
+static npy_bfloat16
+MyPyFloat_AsBfloat16(PyObject *obj)
+{
+    double d;
+    PyObject *num;
+
+    if (obj == Py_None) {
+        d = NPY_NAN;
+    } else {
+        num = PyNumber_Float(obj);
+        if (num == NULL) {
+            d = NPY_NAN;
+        } else {
+            d = PyFloat_AsDouble(num);
+            Py_DECREF(num);
+        }
+    }
+    return double_to_bfloat16(d);
+}
+
+static PyObject **bfloat16_float_cache = NULL;
+
+static double
+bfloat16_decode(npy_uint32 bits)
+{
+    return bfloat16_to_float((npy_bfloat16)bits);
+}
+
+static PyObject *
+BFLOAT16_getitem(char *ip, PyArrayObject *ap)
+{
+    npy_bfloat16 t1;
+
+    t1 = half_load_item(ip, ap);
+    return scalar_cached_float(&bfloat16_float_cache, 0x10000, t1,
+                               bfloat16_decode);
+}
+
+static int
+BFLOAT16_setitem(PyObject *op, char *ov, PyArrayObject *ap)
+{
+    npy_bfloat16 temp; /* ensures alignment */
+
+    if (PyObject_TypeCheck(op, &PyBfloat16ArrType_Type)) {
+        temp = ((PyBfloat16ScalarObject *)op)->obval;
+    }
+    else {
+        temp = MyPyFloat_AsBfloat16(op);
+    }
+    if (PyErr_Occurred()) {
+        if (PySequence_Check(op)) {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_ValueError,
+                    "setting an array element with a sequence.");
+        }
+        return -1;
+    }
+    half_store_item(ov, temp, ap);
+    return 0;
+}
+
+static NPY_INLINE int
+bfloat16_isnan(npy_bfloat16 b)
+{
+    return (b&0x7fffu) > 0x7f80u;
+}
+
+/* Orders the non-NaN values like the floats, with -0.0 == +0.0 */
+static NPY_INLINE int
+bfloat16_key(npy_bfloat16 b)
+{
+    return (b&0x8000u) ? -(int)(b&0x7fffu) : (int)b;
+}
+
+static NPY_INLINE int
+bfloat16_eq(npy_bfloat16 b1, npy_bfloat16 b2)
+{
+    return !bfloat16_isnan(b1) && !bfloat16_isnan(b2) &&
+           bfloat16_key(b1) == bfloat16_key(b2);
+}
+
+static NPY_INLINE int
+bfloat16_ne(npy_bfloat16 b1, npy_bfloat16 b2)
+{
+    return !bfloat16_eq(b1, b2);
+}
+
+static NPY_INLINE int
+bfloat16_lt(npy_bfloat16 b1, npy_bfloat16 b2)
+{
+    return !bfloat16_isnan(b1) && !bfloat16_isnan(b2) &&
+           bfloat16_key(b1) < bfloat16_key(b2);
+}
+
+static NPY_INLINE int
+bfloat16_le(npy_bfloat16 b1, npy_bfloat16 b2)
+{
+    return !bfloat16_isnan(b1) && !bfloat16_isnan(b2) &&
+           bfloat16_key(b1) <= bfloat16_key(b2);
+}
+
+static NPY_INLINE int
+bfloat16_gt(npy_bfloat16 b1, npy_bfloat16 b2)
+{
+    return bfloat16_lt(b2, b1);
+}
+
+static NPY_INLINE int
+bfloat16_ge(npy_bfloat16 b1, npy_bfloat16 b2)
+{
+    return bfloat16_le(b2, b1);
+}
+
+static int
+BFLOAT16_compare(npy_bfloat16 *pa, npy_bfloat16 *pb,
+                 PyArrayObject *NPY_UNUSED(ap))
+{
+    npy_bfloat16 a = *pa, b = *pb;
+    npy_bool anan, bnan;
+
+    anan = bfloat16_isnan(a);
+    bnan = bfloat16_isnan(b);
+    if (anan || bnan) {
+        /* nans sort to the end */
+        return anan ? (bnan ? 0 : 1) : -1;
+    }
+    return (bfloat16_key(a) > bfloat16_key(b)) -
+           (bfloat16_key(a) < bfloat16_key(b));
+}
+
+static npy_intp
+bfloat16_arg(npy_bfloat16 *ip, npy_intp n, int want_max)
+{
+    npy_intp i, best_i = 0;
+    int best;
+
+    if (n <= 0) {
+        return 0;
+    }
+    best = bfloat16_key(ip[0]);
+    for (i = 0; i < n; i++) {
+        /* nans are maximal (and minimal), the first one is returned */
+        if (bfloat16_isnan(ip[i])) {
+            return i;
+        }
+        if (want_max ? bfloat16_key(ip[i]) > best
+                     : bfloat16_key(ip[i]) < best) {
+            best = bfloat16_key(ip[i]);
+            best_i = i;
+        }
+    }
+    return best_i;
+}
+
+static int
+BFLOAT16_argmax(npy_bfloat16 *ip, npy_intp n, npy_intp *max_ind,
+                PyArrayObject *NPY_UNUSED(aip))
+{
+    *max_ind = bfloat16_arg(ip, n, 1);
+    return 0;
+}
+
+static int
+BFLOAT16_argmin(npy_bfloat16 *ip, npy_intp n, npy_intp *min_ind,
+                PyArrayObject *NPY_UNUSED(aip))
+{
+    *min_ind = bfloat16_arg(ip, n, 0);
+    return 0;
+}
+
+static npy_bool
+BFLOAT16_nonzero(char *ip, PyArrayObject *ap)
+{
+    return (npy_bool) ((half_load_item(ip, ap)&0x7fff) != 0);
+}
+
+static void
+BFLOAT16_fill(npy_bfloat16 *buffer, npy_intp length,
+              void *NPY_UNUSED(ignored))
+{
+    npy_intp i;
+    float start = bfloat16_to_float(buffer[0]);
+    float delta = bfloat16_to_float(buffer[1]);
+
+    delta -= start;
+    for (i = 2; i < length; ++i) {
+        buffer[i] = float_to_bfloat16(start + i*delta);
+    }
+}
+
+static void
+bfloat16_load_block(char *ip, npy_intp is, npy_intp n, float *out)
+{
+    npy_intp i;
+
+    if (is == sizeof(npy_bfloat16)) {
+        bfloat16bits_to_floatbits_n((npy_bfloat16 *)ip, (npy_uint32 *)out, n);
+    }
+    else {
+        for (i = 0; i < n; i++, ip += is) {
+            out[i] = bfloat16_to_float(*(npy_bfloat16 *)ip);
+        }
+    }
+}
+
+static void
+bfloat16_store_block(float *in, npy_intp n, char *op, npy_intp os)
+{
+    npy_bfloat16 buf[HALF_LOOP_BLOCK];
+    npy_intp i;
+
+    if (os == sizeof(npy_bfloat16)) {
+        floatbits_to_bfloat16bits_n((npy_uint32 *)in, (npy_bfloat16 *)op, n);
+    }
+    else {
+        floatbits_to_bfloat16bits_n((npy_uint32 *)in, buf, n);
+        for (i = 0; i < n; i++, op += os) {
+            *(npy_bfloat16 *)op = buf[i];
+        }
+    }
+}
+
+static void
+BFLOAT16_dot(char *ip1, npy_intp is1, char *ip2, npy_intp is2, char *op,
+             npy_intp n, void *NPY_UNUSED(ignore))
+{
+    float a[HALF_LOOP_BLOCK], b[HALF_LOOP_BLOCK], r[8];
+    npy_intp i, block;
+    double tmp = 0.0;
+    int j;
+
+    while (n > 0) {
+        block = n < HALF_LOOP_BLOCK ? n : HALF_LOOP_BLOCK;
+        bfloat16_load_block(ip1, is1, block, a);
+        bfloat16_load_block(ip2, is2, block, b);
+        for (j = 0; j < 8; j++) {
+            r[j] = 0.0f;
+        }
+        /* the products of two bfloat16s are exact in float32 */
+        for (i = 0; i + 8 <= block; i += 8) {
+            for (j = 0; j < 8; j++) {
+                r[j] += a[i + j] * b[i + j];
+            }
+        }
+        for (j = 0; i < block; i++, j++) {
+            r[j] += a[i] * b[i];
+        }
+        tmp += ((r[0] + r[1]) + (r[2] + r[3])) + ((r[4] + r[5]) + (r[6] + r[7]));
+        ip1 += block*is1;
+        ip2 += block*is2;
+        n -= block;
+    }
+    *((npy_bfloat16 *)op) = double_to_bfloat16(tmp);
+}
+
+static void
+BFLOAT16_to_FLOAT(npy_bfloat16 *ip, npy_uint32 *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)BFLOAT16_to_FLOAT,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    bfloat16bits_to_floatbits_n(ip, op, n);
+}
+
+static void
+FLOAT_to_BFLOAT16(npy_uint32 *ip, npy_bfloat16 *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)FLOAT_to_BFLOAT16,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    floatbits_to_bfloat16bits_n(ip, op, n);
+}
+
+/* xfloat16 <-> bfloat16, converted directly on the bits */
+static void
+HALF_to_BFLOAT16(npy_half *ip, npy_bfloat16 *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)HALF_to_BFLOAT16,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    halfbits_to_bfloat16bits_n(ip, op, n);
+}
+
+static void
+BFLOAT16_to_HALF(npy_bfloat16 *ip, npy_half *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)BFLOAT16_to_HALF,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    bfloat16bits_to_halfbits_n(ip, op, n);
+}
+
+#define MAKE_BFLOAT16_TO_T(TYPE, type)                                         \
+static void                                                                    \
+BFLOAT16_to_ ## TYPE(npy_bfloat16 *ip, type *op, npy_intp n,                   \
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
+{                                                                              \
+    float buf[HALF_CAST_BLOCK];                                                \
+    npy_intp i, block;                                                         \
+                                                                               \
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)BFLOAT16_to_ ## TYPE,    \
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {             \
+        return;                                                                \
+    }                                                                          \
+    while (n > 0) {                                                            \
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;                     \
+        bfloat16bits_to_floatbits_n(ip, (npy_uint32 *)buf, block);             \
+        for (i = 0; i < block; i++) {                                          \
+            op[i] = (type)buf[i];                                              \
+        }                                                                      \
+        ip += block;                                                           \
+        op += block;                                                           \
+        n -= block;                                                            \
+    }                                                                          \
+}
+
+MAKE_BFLOAT16_TO_T(BOOL, npy_bool);
+MAKE_BFLOAT16_TO_T(BYTE, npy_byte);
+MAKE_BFLOAT16_TO_T(UBYTE, npy_ubyte);
+MAKE_BFLOAT16_TO_T(SHORT, npy_short);
+MAKE_BFLOAT16_TO_T(USHORT, npy_ushort);
+MAKE_BFLOAT16_TO_T(INT, npy_int);
+MAKE_BFLOAT16_TO_T(UINT, npy_uint);
+MAKE_BFLOAT16_TO_T(LONG, npy_long);
+MAKE_BFLOAT16_TO_T(ULONG, npy_ulong);
+MAKE_BFLOAT16_TO_T(LONGLONG, npy_longlong);
+MAKE_BFLOAT16_TO_T(ULONGLONG, npy_ulonglong);
+MAKE_BFLOAT16_TO_T(LONGDOUBLE, npy_longdouble);
+
+static void
+BFLOAT16_to_DOUBLE(npy_bfloat16 *ip, npy_uint64 *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)BFLOAT16_to_DOUBLE,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    while (n--) {
+        *op++ = bfloat16bits_to_doublebits(*ip++);
+    }
+}
+
+/* Rounded straight from double, which holds all these exactly or nearly */
+#define MAKE_T_TO_BFLOAT16(TYPE, type)                                         \
+static void                                                                    \
+TYPE ## _to_BFLOAT16(type *ip, npy_bfloat16 *op, npy_intp n,                   \
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
+{                                                                              \
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)TYPE ## _to_BFLOAT16,    \
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {             \
+        return;                                                                \
+    }                                                                          \
+    while (n--) {                                                              \
+        *op++ = double_to_bfloat16((double)(*ip++));                           \
+    }                                                                          \
+}
+
+MAKE_T_TO_BFLOAT16(BOOL, npy_bool);
+MAKE_T_TO_BFLOAT16(BYTE, npy_byte);
+MAKE_T_TO_BFLOAT16(UBYTE, npy_ubyte);
+MAKE_T_TO_BFLOAT16(SHORT, npy_short);
+MAKE_T_TO_BFLOAT16(USHORT, npy_ushort);
+MAKE_T_TO_BFLOAT16(INT, npy_int);
+MAKE_T_TO_BFLOAT16(UINT, npy_uint);
+MAKE_T_TO_BFLOAT16(LONG, npy_long);
+MAKE_T_TO_BFLOAT16(ULONG, npy_ulong);
+MAKE_T_TO_BFLOAT16(LONGLONG, npy_longlong);
+MAKE_T_TO_BFLOAT16(ULONGLONG, npy_ulonglong);
+MAKE_T_TO_BFLOAT16(DOUBLE, npy_double);
+MAKE_T_TO_BFLOAT16(LONGDOUBLE, npy_longdouble);
+
+static npy_bfloat16
+bfloat16_reduce_add(npy_bfloat16 acc, char *ip, npy_intp is, npy_intp n)
+{
+    return float_to_bfloat16(bfloat16_to_float(acc) +
+                             half_sum(bfloat16_load_block, ip, is, n));
+}
+
+static npy_bfloat16
+bfloat16_reduce_subtract(npy_bfloat16 acc, char *ip, npy_intp is, npy_intp n)
+{
+    return float_to_bfloat16(bfloat16_to_float(acc) -
+                             half_sum(bfloat16_load_block, ip, is, n));
+}
+
+static npy_bfloat16
+bfloat16_reduce_multiply(npy_bfloat16 acc, char *ip, npy_intp is, npy_intp n)
+{
+    return double_to_bfloat16(bfloat16_to_float(acc) *
+                              half_prod(bfloat16_load_block, ip, is, n));
+}
+
+static npy_bfloat16
+bfloat16_reduce_divide(npy_bfloat16 acc, char *ip, npy_intp is, npy_intp n)
+{
+    return double_to_bfloat16(bfloat16_to_float(acc) /
+                              half_prod(bfloat16_load_block, ip, is, n));
+}
+
+#define MAKE_BFLOAT16_BINARY_LOOP(NAME, OP)                                    \
+    MAKE_BINARY_LOOP(BFLOAT16_ ## NAME, OP, bfloat16_reduce_ ## NAME,          \
+                     bfloat16_load_block, bfloat16_store_block)
+
+MAKE_BFLOAT16_BINARY_LOOP(add, +);
+MAKE_BFLOAT16_BINARY_LOOP(subtract, -);
+MAKE_BFLOAT16_BINARY_LOOP(multiply, *);
+MAKE_BFLOAT16_BINARY_LOOP(divide, /);
+
+#define MAKE_BFLOAT16_COMPARE_LOOP(NAME)                                       \
+static void                                                                    \
+BFLOAT16_ ## NAME(char **args, npy_intp const *dimensions,                     \
+                  npy_intp const *steps, void *NPY_UNUSED(data))               \
+{                                                                              \
+    char *ip1 = args[0], *ip2 = args[1], *op = args[2];                        \
+    npy_intp is1 = steps[0], is2 = steps[1], os = steps[2];                    \
+    npy_intp n = dimensions[0], i;                                             \
+                                                                               \
+    if (half_loop_parallel(BFLOAT16_ ## NAME, args, dimensions, steps, 3)) {   \
+        return;                                                                \
+    }                                                                          \
+    for (i = 0; i < n; i++, ip1 += is1, ip2 += is2, op += os) {                \
+        *(npy_bool *)op = bfloat16_ ## NAME(*(npy_bfloat16 *)ip1,              \
+                                            *(npy_bfloat16 *)ip2);             \
+    }                                                                          \
+}
+
+#define bfloat16_equal bfloat16_eq
+#define bfloat16_not_equal bfloat16_ne
+#define bfloat16_less bfloat16_lt
+#define bfloat16_less_equal bfloat16_le
+#define bfloat16_greater bfloat16_gt
+#define bfloat16_greater_equal bfloat16_ge
+
+MAKE_BFLOAT16_COMPARE_LOOP(equal);
+MAKE_BFLOAT16_COMPARE_LOOP(not_equal);
+MAKE_BFLOAT16_COMPARE_LOOP(less);
+MAKE_BFLOAT16_COMPARE_LOOP(less_equal);
+MAKE_BFLOAT16_COMPARE_LOOP(greater);
+MAKE_BFLOAT16_COMPARE_LOOP(greater_equal);
+
+/* maximum/minimum, with the same NaN and tie rules as the xfloat16 ones */
+#define MAKE_BFLOAT16_MAXMIN_LOOP(NAME, CMP)                                   \
+static void                                                                    \
+BFLOAT16_ ## NAME(char **args, npy_intp const *dimensions,                     \
+                  npy_intp const *steps, void *NPY_UNUSED(data))               \
+{                                                                              \
+    char *ip1 = args[0], *ip2 = args[1], *op = args[2];                        \
+    npy_intp is1 = steps[0], is2 = steps[1], os = steps[2];                    \
+    npy_intp n = dimensions[0], i;                                             \
+    npy_bfloat16 b1, b2;                                                       \
+                                                                               \
+    if (half_loop_parallel(BFLOAT16_ ## NAME, args, dimensions, steps, 3)) {   \
+        return;                                                                \
+    }                                                                          \
+    for (i = 0; i < n; i++, ip1 += is1, ip2 += is2, op += os) {                \
+        b1 = *(npy_bfloat16 *)ip1;                                             \
+        b2 = *(npy_bfloat16 *)ip2;                                             \
+        *(npy_bfloat16 *)op = (bfloat16_isnan(b1) || CMP(b1, b2)) ? b1 : b2;   \
+    }                                                                          \
+}
+
+MAKE_BFLOAT16_MAXMIN_LOOP(maximum, bfloat16_ge);
+MAKE_BFLOAT16_MAXMIN_LOOP(minimum, bfloat16_le);
+
+/*
+ * FP8 array functions and casts.  The float8_e4m3fn and float8_e5m2
+ * dtypes are storage types: they have no ufunc loops of their own, and
+ * arithmetic promotes them to float32.  Narrowing casts follow the
+ * saturation mode set with set_fp8_saturation.
+ */
+static int half_fp8_saturate = HALF_FP8_NONSATURATING;
+
+static NPY_INLINE npy_uint32
+fp8_to_floatbits(npy_uint8 b, int e5m2)
+{
+    return e5m2 ? e5m2bits_to_floatbits(b) : e4m3bits_to_floatbits(b);
+}
+
+static NPY_INLINE float
+fp8_to_float(npy_uint8 b, int e5m2)
+{
+    npy_uint32 f = fp8_to_floatbits(b, e5m2);
+    float r;
+
+    memcpy(&r, &f, sizeof(r));
+    return r;
+}
+
+static void
+fp8_to_floatbits_n(const npy_uint8 *b, npy_uint32 *f, npy_intp n, int e5m2)
+{
+    if (e5m2) {
+        e5m2bits_to_floatbits_n(b, f, n);
+    }
+    else {
+        e4m3bits_to_floatbits_n(b, f, n);
+    }
+}
+
+static void
+floatbits_to_fp8_n(const npy_uint32 *f, npy_uint8 *b, npy_intp n, int e5m2)
+{
+    if (e5m2) {
+        floatbits_to_e5m2bits_n(f, b, n, half_fp8_saturate);
+    }
+    else {
+        floatbits_to_e4m3bits_n(f, b, n, half_fp8_saturate);
+    }
+}
+
+/*
+ * Double to float rounding to odd, so that rounding the float to FP8
+ * afterwards gives the correctly rounded result.  NaNs keep the top of
+ * their payload without being quieted.
+ */
+static npy_uint32
+double_to_floatbits_odd(double d)
+{
+    npy_uint64 dbits;
+    npy_uint32 f;
+    float r;
+
+    memcpy(&dbits, &d, sizeof(dbits));
+    if ((dbits&0x7fffffffffffffffULL) > 0x7ff0000000000000ULL) {
+        f = (npy_uint32)(dbits >> 29)&0x007fffffu;
+        return (npy_uint32)((dbits >> 32)&0x80000000u) + 0x7f800000u +
+               (f ? f : 1);
+    }
+    r = (float)d;
+    memcpy(&f, &r, sizeof(f));
+    if ((double)r != d && !(f&1u)) {
+        /* inexact, step the magnitude towards d to make it odd */
+        f += (npy_fabs((double)r) < npy_fabs(d)) ? 1 : -1;
+    }
+    return f;
+}
+
+static NPY_INLINE npy_uint8
+double_to_fp8(double d, int e5m2)
+{
+    npy_uint32 f = double_to_floatbits_odd(d);
+
+    return e5m2 ? floatbits_to_e5m2bits(f, half_fp8_saturate)
+                : floatbits_to_e4m3bits(f, half_fp8_saturate);
+}
+
+static npy_uint8
+MyPyFloat_AsFp8(PyObject *obj, int e5m2)
+{
+    double d;
+    PyObject *num;
+
+    if (obj == Py_None) {
+        d = NPY_NAN;
+    } else {
+        num = PyNumber_Float(obj);
+        if (num == NULL) {
+            d = NPY_NAN;
+        } else {
+            d = PyFloat_AsDouble(num);
+            Py_DECREF(num);
+        }
+    }
+    return double_to_fp8(d, e5m2);
+}
+
+static int
+fp8_setitem(PyObject *op, char *ov, PyTypeObject *scalar_type, int e5m2)
+{
+    npy_uint8 temp;
+
+    if (PyObject_TypeCheck(op, scalar_type)) {
+        temp = ((PyFloat8ScalarObject *)op)->obval;
+    }
+    else {
+        temp = MyPyFloat_AsFp8(op, e5m2);
+    }
+    if (PyErr_Occurred()) {
+        if (PySequence_Check(op)) {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_ValueError,
+                    "setting an array element with a sequence.");
+        }
+        return -1;
+    }
+    *(npy_uint8 *)ov = temp;
+    return 0;
+}
+
+/* NaNs sort to the end, like in the other compare functions */
+static int
+fp8_compare(npy_uint8 a, npy_uint8 b, int e5m2)
+{
+    float fa = fp8_to_float(a, e5m2), fb = fp8_to_float(b, e5m2);
+    int anan = npy_isnan(fa), bnan = npy_isnan(fb);
+
+    if (anan || bnan) {
+        return anan - bnan;
+    }
+    return (fa > fb) - (fa < fb);
+}
+
+static npy_intp
+fp8_arg(npy_uint8 *ip, npy_intp n, int e5m2, int want_max)
+{
+    npy_intp i, best_i = 0;
+    float best, f;
+
+    if (n <= 0) {
+        return 0;
+    }
+    best = fp8_to_float(ip[0], e5m2);
+    for (i = 0; i < n; i++) {
+        f = fp8_to_float(ip[i], e5m2);
+        if (npy_isnan(f)) {
+            return i;
+        }
+        if (want_max ? f > best : f < best) {
+            best = f;
+            best_i = i;
+        }
+    }
+    return best_i;
+}
+
+static npy_bool
+FLOAT8_nonzero(char *ip, PyArrayObject *NPY_UNUSED(ap))
+{
+    return (npy_bool) ((*(npy_uint8 *)ip&0x7f) != 0);
+}
+
+static void
+FLOAT8_copyswapn(void *dst, npy_intp dstride, void *src, npy_intp sstride,
+                 npy_intp n, int NPY_UNUSED(swap), void *NPY_UNUSED(arr))
+{
+    char *d = (char *)dst, *s = (char *)src;
+    npy_intp i;
+
+    if (src == NULL) {
+        return;
+    }
+    if (dstride == 1 && sstride == 1) {
+        memmove(d, s, n);
+        return;
+    }
+    for (i = 0; i < n; i++, d += dstride, s += sstride) {
+        *d = *s;
+    }
+}
+
+static void
+FLOAT8_copyswap(void *dst, void *src, int NPY_UNUSED(swap),
+                void *NPY_UNUSED(arr))
+{
+    if (src != NULL) {
+        *(npy_uint8 *)dst = *(npy_uint8 *)src;
+    }
+}
+
+/* The functions and casts of one FP8 type, E5M2 is 0 or 1 */
+#define MAKE_FP8_TYPE(TYPE, E5M2)                                              \
+static PyObject **TYPE ## _float_cache = NULL;                                 \
+                                                                               \
+static double                                                                  \
+TYPE ## _decode(npy_uint32 bits)                                               \
+{                                                                              \
+    return fp8_to_float((npy_uint8)bits, E5M2);                                \
+}                                                                              \
+                                                                               \
+static PyObject *                                                              \
+TYPE ## _getitem(char *ip, PyArrayObject *NPY_UNUSED(ap))                      \
+{                                                                              \
+    return scalar_cached_float(&TYPE ## _float_cache, 0x100,                   \
+                               *(npy_uint8 *)ip, TYPE ## _decode);             \
+}                                                                              \
+                                                                               \
+static int                                                                     \
+TYPE ## _setitem(PyObject *op, char *ov, PyArrayObject *NPY_UNUSED(ap))        \
+{                                                                              \
+    return fp8_setitem(op, ov, &Py ## TYPE ## ArrType_Type, E5M2);             \
+}                                                                              \
+                                                                               \
+static int                                                                     \
+TYPE ## _compare(npy_uint8 *pa, npy_uint8 *pb, PyArrayObject *NPY_UNUSED(ap))  \
+{                                                                              \
+    return fp8_compare(*pa, *pb, E5M2);                                        \
+}                                                                              \
+                                                                               \
+static int                                                                     \
+TYPE ## _argmax(npy_uint8 *ip, npy_intp n, npy_intp *max_ind,                  \
+                PyArrayObject *NPY_UNUSED(aip))                                \
+{                                                                              \
+    *max_ind = fp8_arg(ip, n, E5M2, 1);                                        \
+    return 0;                                                                  \
+}                                                                              \
+                                                                               \
+static int                                                                     \
+TYPE ## _argmin(npy_uint8 *ip, npy_intp n, npy_intp *min_ind,                  \
+                PyArrayObject *NPY_UNUSED(aip))                                \
+{                                                                              \
+    *min_ind = fp8_arg(ip, n, E5M2, 0);                                        \
+    return 0;                                                                  \
+}                                                                              \
+                                                                               \
+static void                                                                    \
+TYPE ## _to_FLOAT(npy_uint8 *ip, npy_uint32 *op, npy_intp n,                   \
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
+{                                                                              \
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)TYPE ## _to_FLOAT,       \
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {             \
+        return;                                                                \
+    }                                                                          \
+    fp8_to_floatbits_n(ip, op, n, E5M2);                                       \
+}                                                                              \
+                                                                               \
+static void                                                                    \
+FLOAT_to_ ## TYPE(npy_uint32 *ip, npy_uint8 *op, npy_intp n,                   \
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
+{                                                                              \
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)FLOAT_to_ ## TYPE,       \
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {             \
+        return;                                                                \
+    }                                                                          \
+    floatbits_to_fp8_n(ip, op, n, E5M2);                                       \
+}                                                                              \
+                                                                               \
+static void                                                                    \
+TYPE ## _to_BFLOAT16(npy_uint8 *ip, npy_bfloat16 *op, npy_intp n,              \
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
+{                                                                              \
+    npy_uint32 buf[HALF_CAST_BLOCK];                                           \
+    npy_intp block;                                                            \
+                                                                               \
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)TYPE ## _to_BFLOAT16,    \
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {             \
+        return;                                                                \
+    }                                                                          \
+    while (n > 0) {                                                            \
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;                     \
+        fp8_to_floatbits_n(ip, buf, block, E5M2);                              \
+        /* exact, the FP8 values are all bfloat16 values */                    \
+        floatbits_to_bfloat16bits_n(buf, op, block);                           \
+        ip += block;                                                           \
+        op += block;                                                           \
+        n -= block;                                                            \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static void                                                                    \
+BFLOAT16_to_ ## TYPE(npy_bfloat16 *ip, npy_uint8 *op, npy_intp n,              \
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
+{                                                                              \
+    npy_uint32 buf[HALF_CAST_BLOCK];                                           \
+    npy_intp block;                                                            \
+                                                                               \
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)BFLOAT16_to_ ## TYPE,    \
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {             \
+        return;                                                                \
+    }                                                                          \
+    while (n > 0) {                                                            \
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;                     \
+        bfloat16bits_to_floatbits_n(ip, buf, block);                           \
+        floatbits_to_fp8_n(buf, op, block, E5M2);                              \
+        ip += block;                                                           \
+        op += block;                                                           \
+        n -= block;                                                            \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static PyObject *                                                              \
+TYPE ## _arrtype_new(PyTypeObject *type, PyObject *args, PyObject *kwds)       \
+{                                                                              \
+    PyObject *obj = NULL;                                                      \
+    npy_uint8 value = 0;                                                       \
+    double d;                                                                  \
+    int status = scalar_arg_as_double(args, &d);                               \
+                                                                               \
+    if (status != 0) {                                                         \
+        return status < 0 ? NULL : PyFloat_FromDouble(                         \
+            fp8_to_float(double_to_fp8(d, E5M2), E5M2));                       \
+    }                                                                          \
+    if (!PyArg_ParseTuple(args, "|O", &obj)) {                                 \
+        return NULL;                                                           \
+    }                                                                          \
+    if (obj != NULL) {                                                         \
+        value = MyPyFloat_AsFp8(obj, E5M2);                                    \
+        if (PyErr_Occurred()) {                                                \
+            return NULL;                                                       \
+        }                                                                      \
+    }                                                                          \
+    return PyArray_Scalar(&value, &NPy ## TYPE ## _Descr, NULL);               \
+}                                                                              \
+                                                                               \
+static long                                                                    \
+TYPE ## type_hash(PyObject *obj)                                               \
+{                                                                              \
+    double temp;                                                               \
+    temp = fp8_to_float(((PyFloat8ScalarObject *)obj)->obval, E5M2);           \
+    return _Py_HashDouble(*((double*)&temp));                                  \
+}                                                                              \
+                                                                               \
+static PyObject *                                                              \
+TYPE ## type_repr(PyObject *o)                                                 \
+{                                                                              \
+    char str[64];                                                              \
+                                                                               \
+    sprintf(str, "%s(%g)", Py ## TYPE ## ArrType_Type.tp_name + 5,             \
+            fp8_to_float(((PyFloat8ScalarObject *)o)->obval, E5M2));           \
+    return PyUnicode_FromString(str);                                          \
+}                                                                              \
+                                                                               \
+static PyObject *                                                              \
+TYPE ## type_str(PyObject *o)                                                  \
+{                                                                              \
+    char str[48];                                                              \
+                                                                               \
+    sprintf(str, "%g",                                                         \
+            fp8_to_float(((PyFloat8ScalarObject *)o)->obval, E5M2));           \
+    return PyUnicode_FromString(str);                                          \
+}
+
+MAKE_FP8_TYPE(E4M3, 0)
+MAKE_FP8_TYPE(E5M2, 1)
+
+/* Halves hold all FP8 values, and are rounded to FP8 once */
+static void
+E4M3_to_HALF(npy_uint8 *ip, npy_half *op, npy_intp n,
+             PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)E4M3_to_HALF,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    e4m3bits_to_halfbits_n(ip, op, n);
+}
+
+static void
+E5M2_to_HALF(npy_uint8 *ip, npy_half *op, npy_intp n,
+             PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)E5M2_to_HALF,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    e5m2bits_to_halfbits_n(ip, op, n);
+}
+
+static void
+HALF_to_E4M3(npy_half *ip, npy_uint8 *op, npy_intp n,
+             PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)HALF_to_E4M3,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    halfbits_to_e4m3bits_n(ip, op, n, half_fp8_saturate);
+}
+
+static void
+HALF_to_E5M2(npy_half *ip, npy_uint8 *op, npy_intp n,
+             PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)HALF_to_E5M2,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    halfbits_to_e5m2bits_n(ip, op, n, half_fp8_saturate);
+}
+
+#define MAKE_FP8_TO_T(FP8, E5M2, TYPE, type)                                   \
+static void                                                                    \
+FP8 ## _to_ ## TYPE(npy_uint8 *ip, type *op, npy_intp n,                       \
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
+{                                                                              \
+    float buf[HALF_CAST_BLOCK];                                                \
+    npy_intp i, block;                                                         \
+                                                                               \
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)FP8 ## _to_ ## TYPE,     \
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {             \
+        return;                                                                \
+    }                                                                          \
+    while (n > 0) {                                                            \
+        block = n < HALF_CAST_BLOCK ? n : HALF_CAST_BLOCK;                     \
+        fp8_to_floatbits_n(ip, (npy_uint32 *)buf, block, E5M2);                \
+        for (i = 0; i < block; i++) {                                          \
+            op[i] = (type)buf[i];                                              \
+        }                                                                      \
+        ip += block;                                                           \
+        op += block;                                                           \
+        n -= block;                                                            \
+    }                                                                          \
+}
+
+/* Rounded to odd in float32 first, then once to FP8 */
+#define MAKE_T_TO_FP8(FP8, E5M2, TYPE, type)                                   \
+static void                                                                    \
+TYPE ## _to_ ## FP8(type *ip, npy_uint8 *op, npy_intp n,                       \
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
+{                                                                              \
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)TYPE ## _to_ ## FP8,     \
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {             \
+        return;                                                                \
+    }                                                                          \
+    while (n--) {                                                              \
+        *op++ = double_to_fp8((double)(*ip++), E5M2);                          \
+    }                                                                          \
+}
+
+#define MAKE_FP8_CASTS(FP8, E5M2)                                              \
+    MAKE_FP8_TO_T(FP8, E5M2, BOOL, npy_bool)                                   \
+    MAKE_FP8_TO_T(FP8, E5M2, BYTE, npy_byte)                                   \
+    MAKE_FP8_TO_T(FP8, E5M2, UBYTE, npy_ubyte)                                 \
+    MAKE_FP8_TO_T(FP8, E5M2, SHORT, npy_short)                                 \
+    MAKE_FP8_TO_T(FP8, E5M2, USHORT, npy_ushort)                               \
+    MAKE_FP8_TO_T(FP8, E5M2, INT, npy_int)                                     \
+    MAKE_FP8_TO_T(FP8, E5M2, UINT, npy_uint)                                   \
+    MAKE_FP8_TO_T(FP8, E5M2, LONG, npy_long)                                   \
+    MAKE_FP8_TO_T(FP8, E5M2, ULONG, npy_ulong)                                 \
+    MAKE_FP8_TO_T(FP8, E5M2, LONGLONG, npy_longlong)                           \
+    MAKE_FP8_TO_T(FP8, E5M2, ULONGLONG, npy_ulonglong)                         \
+    MAKE_FP8_TO_T(FP8, E5M2, LONGDOUBLE, npy_longdouble)                       \
+    MAKE_T_TO_FP8(FP8, E5M2, BOOL, npy_bool)                                   \
+    MAKE_T_TO_FP8(FP8, E5M2, BYTE, npy_byte)                                   \
+    MAKE_T_TO_FP8(FP8, E5M2, UBYTE, npy_ubyte)                                 \
+    MAKE_T_TO_FP8(FP8, E5M2, SHORT, npy_short)                                 \
+    MAKE_T_TO_FP8(FP8, E5M2, USHORT, npy_ushort)                               \
+    MAKE_T_TO_FP8(FP8, E5M2, INT, npy_int)                                     \
+    MAKE_T_TO_FP8(FP8, E5M2, UINT, npy_uint)                                   \
+    MAKE_T_TO_FP8(FP8, E5M2, LONG, npy_long)                                   \
+    MAKE_T_TO_FP8(FP8, E5M2, ULONG, npy_ulong)                                 \
+    MAKE_T_TO_FP8(FP8, E5M2, LONGLONG, npy_longlong)                           \
+    MAKE_T_TO_FP8(FP8, E5M2, ULONGLONG, npy_ulonglong)                         \
+    MAKE_T_TO_FP8(FP8, E5M2, DOUBLE, npy_double)                               \
+    MAKE_T_TO_FP8(FP8, E5M2, LONGDOUBLE, npy_longdouble)
+
+MAKE_FP8_CASTS(E4M3, 0)
+MAKE_FP8_CASTS(E5M2, 1)
+
+/* Widened through halves, so NaN payloads are not quieted */
+static void
+E4M3_to_DOUBLE(npy_uint8 *ip, npy_uint64 *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)E4M3_to_DOUBLE,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    while (n--) {
+        *op++ = halfbits_to_doublebits(e4m3bits_to_halfbits(*ip++));
+    }
+}
+
+static void
+E5M2_to_DOUBLE(npy_uint8 *ip, npy_uint64 *op, npy_intp n,
+               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+    if (half_cast_parallel((PyArray_VectorUnaryFunc *)E5M2_to_DOUBLE,
+                           ip, sizeof(*ip), op, sizeof(*op), n)) {
+        return;
+    }
+    while (n--) {
+        *op++ = halfbits_to_doublebits(e5m2bits_to_halfbits(*ip++));
+    }
+}
+
+static void register_cast_function(int sourceType, int destType, PyArray_VectorUnaryFunc *castfunc)
+{
+    PyArray_Descr *descr = PyArray_DescrFromType(sourceType);
+    PyArray_RegisterCastFunc(descr, destType, castfunc);
+    Py_DECREF(descr);
+}
+
+static void register_safe_cast(int sourceType, int destType)
+{
+    PyArray_Descr *descr = PyArray_DescrFromType(sourceType);
+    PyArray_RegisterCanCast(descr, destType, NPY_NOSCALAR);
+    Py_DECREF(descr);
+}
+
+static int register_ufunc_loop(PyObject *numpy, const char *name,
+                               PyUFuncGenericFunction loop, int *types)
+{
+    PyObject *ufunc;
+    int ret;
+
+    ufunc = PyObject_GetAttrString(numpy, name);
+    if (ufunc == NULL) {
+        return -1;
+    }
+    ret = PyUFunc_RegisterLoopForType((PyUFuncObject *)ufunc, types[0],
+                                      loop, types, NULL);
+    Py_DECREF(ufunc);
+    return ret;
+}
+
+static PyObject *
+half_arrtype_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyObject *obj = NULL;
+    npy_half value = 0;
+    double d;
+    int status = scalar_arg_as_double(args, &d);
+
+    if (status != 0) {
+        return status < 0 ? NULL : PyFloat_FromDouble(half_to_double(double_to_half(d)));
+    }
+    if (!PyArg_ParseTuple(args, "|O", &obj)) {
+        return NULL;
+    }
+    if (obj != NULL) {
+        value = MyPyFloat_AsHalf(obj);
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+    return PyArray_Scalar(&value, &xfloat16_Descr, NULL);
+}
+
+static PyObject *
+gentype_richcompare(PyObject *self, PyObject *other, int cmp_op)
+{
+    PyObject *arr, *ret;
+
+    arr = PyArray_FromScalar(self, NULL);
+    if (arr == NULL) {
+        return NULL;
+    }
+    ret = Py_TYPE(arr)->tp_richcompare(arr, other, cmp_op);
+    Py_DECREF(arr);
+    return ret;
+}
+
+static long
+halftype_hash(PyObject *obj)
+{
+    double temp;
+    temp = half_to_double(((PyXHalfScalarObject *)obj)->obval);
+    return _Py_HashDouble(*((double*)&temp));
+}
+
+PyObject* halftype_repr(PyObject *o)
+{
+    double temp;
+    char str[48];
+
+    temp = half_to_double(((PyXHalfScalarObject *)o)->obval);
+    sprintf(str, "xfloat16(%g)", *((double*)&temp));
+    return PyUnicode_FromString(str);
+}
+
+PyObject* halftype_str(PyObject *o)
+{
+    double temp;
+    char str[48];
+
+    temp = half_to_double(((PyXHalfScalarObject *)o)->obval);
+    sprintf(str, "%g", *((double*)&temp));
+    return PyUnicode_FromString(str);
+}
+
+static PyObject *
+bfloat16_arrtype_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyObject *obj = NULL;
+    npy_bfloat16 value = 0;
+    double d;
+    int status = scalar_arg_as_double(args, &d);
+
+    if (status != 0) {
+        return status < 0 ? NULL : PyFloat_FromDouble(bfloat16_to_float(double_to_bfloat16(d)));
+    }
+    if (!PyArg_ParseTuple(args, "|O", &obj)) {
+        return NULL;
+    }
+    if (obj != NULL) {
+        value = MyPyFloat_AsBfloat16(obj);
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+    return PyArray_Scalar(&value, &NPyBfloat16_Descr, NULL);
+}
+
+static long
+bfloat16type_hash(PyObject *obj)
+{
+    double temp;
+    temp = bfloat16_to_float(((PyBfloat16ScalarObject *)obj)->obval);
+    return _Py_HashDouble(*((double*)&temp));
+}
+
+PyObject* bfloat16type_repr(PyObject *o)
+{
+    double temp;
+    char str[48];
+
+    temp = bfloat16_to_float(((PyBfloat16ScalarObject *)o)->obval);
+    sprintf(str, "bfloat16(%g)", temp);
+    return PyUnicode_FromString(str);
+}
+
+PyObject* bfloat16type_str(PyObject *o)
+{
+    double temp;
+    char str[48];
+
+    temp = bfloat16_to_float(((PyBfloat16ScalarObject *)o)->obval);
+    sprintf(str, "%g", temp);
+    return PyUnicode_FromString(str);
+}
+
+#if PY_MAJOR_VERSION >= 3
+  #define MOD_ERROR_VAL NULL
+  #define MOD_SUCCESS_VAL(val) val
+  #define MOD_INIT(name) PyMODINIT_FUNC PyInit_##name(void)
+  #define MOD_DEF(ob, name, doc, methods) \
+          static struct PyModuleDef moduledef = { \
+            PyModuleDef_HEAD_INIT, name, doc, -1, methods, }; \
+          ob = PyModule_Create(&moduledef);
+#else
+  #define MOD_ERROR_VAL
+  #define MOD_SUCCESS_VAL(val)
+  #define MOD_INIT(name) void init##name(void)
+  #define MOD_DEF(ob, name, doc, methods) \
+          ob = Py_InitModule3(name, methods, doc);
+#endif
+
+
+static PyObject *
+halfmod_simd_level(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+    return PyLong_FromLong(half_simd_level());
+}
+
+static PyObject *
+halfmod_set_simd_level(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    int level;
+
+    if (!PyArg_ParseTuple(args, "i", &level)) {
+        return NULL;
+    }
+    return PyLong_FromLong(half_set_simd_level(level));
+}
+
+static PyObject *
+halfmod_dot_accumulation(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+    return PyLong_FromLong(half_dot_accumulate);
+}
+
+static PyObject *
+halfmod_set_dot_accumulation(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    int mode;
+
+    if (!PyArg_ParseTuple(args, "i", &mode)) {
+        return NULL;
+    }
+    if (mode != HALF_DOT_FLOAT && mode != HALF_DOT_PAIRWISE &&
+            mode != HALF_DOT_DOUBLE) {
+        PyErr_SetString(PyExc_ValueError, "invalid dot accumulation mode");
+        return NULL;
+    }
+    half_dot_accumulate = mode;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+halfmod_decode_mode(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+    return PyLong_FromLong(half_decode_mode());
+}
+
+static PyObject *
+halfmod_set_decode_mode(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    int mode;
+
+    if (!PyArg_ParseTuple(args, "i", &mode)) {
+        return NULL;
+    }
+    if (mode != HALF_DECODE_AUTO && mode != HALF_DECODE_BITS &&
+            mode != HALF_DECODE_TABLE) {
+        PyErr_SetString(PyExc_ValueError, "invalid decode mode");
+        return NULL;
+    }
+    half_set_decode_mode(mode);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+halfmod_fpe_mode(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+    return PyLong_FromLong(half_fpe_mode());
 }
 
-static void
-LONGDOUBLE_to_HALF(npy_longdouble *ip, npy_half *op, npy_intp n,
-               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+static PyObject *
+halfmod_set_fpe_mode(PyObject *NPY_UNUSED(self), PyObject *args)
 {
-    npy_uint64 temp;
+    int mode;
 
-    while (n--) {
-        *((double*)&temp) = (double)(*ip++);
-        *op++ = doublebits_to_halfbits(temp);
+    if (!PyArg_ParseTuple(args, "i", &mode)) {
+        return NULL;
+    }
+    if (mode != HALF_FPE_RAISE && mode != HALF_FPE_IGNORE) {
+        PyErr_SetString(PyExc_ValueError, "invalid floating point error mode");
+        return NULL;
     }
+    half_set_fpe_mode(mode);
+    Py_RETURN_NONE;
 }
 
-static void
-CFLOAT_to_HALF(npy_uint32 *ip, npy_half *op, npy_intp n,
-               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+static PyObject *
+halfmod_fp8_saturation(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
 {
-    while (n--) {
-        *op++ = floatbits_to_halfbits(*ip);
-        ip += 2;
+    return PyLong_FromLong(half_fp8_saturate);
+}
+
+static PyObject *
+halfmod_set_fp8_saturation(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    int mode;
+
+    if (!PyArg_ParseTuple(args, "i", &mode)) {
+        return NULL;
+    }
+    if (mode != HALF_FP8_NONSATURATING && mode != HALF_FP8_SATURATING) {
+        PyErr_SetString(PyExc_ValueError, "invalid fp8 saturation mode");
+        return NULL;
     }
+    half_fp8_saturate = mode;
+    Py_RETURN_NONE;
 }
 
-static void
-CDOUBLE_to_HALF(npy_uint64 *ip, npy_half *op, npy_intp n,
-               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+/*
+ * The result array of a conversion of in to type to: out if given, which
+ * must be a C-contiguous array of that type and size, or a new array of
+ * the shape of in.
+ */
+static PyArrayObject *
+half_conversion_result(PyArrayObject *in, PyObject *out, PyArray_Descr *to)
 {
-    while (n--) {
-        *op++ = doublebits_to_halfbits(*ip);
-        ip += 2;
+    if (out == NULL || out == Py_None) {
+        Py_INCREF(to);
+        return (PyArrayObject *)PyArray_NewFromDescr(&PyArray_Type, to,
+                    PyArray_NDIM(in), PyArray_DIMS(in), NULL, NULL, 0, NULL);
+    }
+    if (!PyArray_Check(out) ||
+            PyArray_DESCR((PyArrayObject *)out)->type_num != to->type_num ||
+            !PyArray_IS_C_CONTIGUOUS((PyArrayObject *)out) ||
+            PyArray_SIZE((PyArrayObject *)out) != PyArray_SIZE(in)) {
+        PyErr_SetString(PyExc_ValueError,
+                "out must be a C-contiguous array of the result type "
+                "and the size of the input");
+        return NULL;
     }
+    if (PyArray_FailUnlessWriteable((PyArrayObject *)out, "out") < 0) {
+        return NULL;
+    }
+    Py_INCREF(out);
+    return (PyArrayObject *)out;
 }
 
-static void
-CLONGDOUBLE_to_HALF(npy_longdouble *ip, npy_half *op, npy_intp n,
-               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+/*
+ * Converts the bits of an array of 16-bit elements (such as raw
+ * bfloat16 stored as uint16) into a new or given C-contiguous array of
+ * the other type, see HALF_to_BFLOAT16/BFLOAT16_to_HALF.
+ */
+static PyObject *
+half_convert_bits(PyObject *args, PyObject *kwds, PyArray_Descr *to,
+                  PyArray_VectorUnaryFunc *cast)
 {
-    npy_uint64 temp;
+    static const char *kwlist[] = {"a", "out", NULL};
+    PyObject *obj, *out = NULL;
+    PyArrayObject *in, *ret;
+    NPY_BEGIN_THREADS_DEF;
 
-    while (n--) {
-        *((double*)&temp) = (double)(*ip);
-        *op++ = doublebits_to_halfbits(temp);
-        ip += 2;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", (char **)kwlist,
+                                     &obj, &out)) {
+        return NULL;
+    }
+    in = (PyArrayObject *)PyArray_FromAny(obj, NULL, 0, 0,
+                    NPY_ARRAY_C_CONTIGUOUS | NPY_ARRAY_ALIGNED, NULL);
+    if (in == NULL) {
+        return NULL;
+    }
+    if (PyArray_ITEMSIZE(in) != 2 || !PyArray_ISNOTSWAPPED(in)) {
+        PyErr_SetString(PyExc_TypeError,
+                "expected an array of native 16-bit elements");
+        Py_DECREF(in);
+        return NULL;
+    }
+    ret = half_conversion_result(in, out, to);
+    if (ret == NULL) {
+        Py_DECREF(in);
+        return NULL;
     }
+    NPY_BEGIN_THREADS;
+    cast(PyArray_DATA(in), PyArray_DATA(ret), PyArray_SIZE(in), NULL, NULL);
+    NPY_END_THREADS;
+    Py_DECREF(in);
+    return (PyObject *)ret;
 }
 
+static int
+half_intp_cmp(const void *a, const void *b)
+{
+    npy_intp x = *(const npy_intp *)a, y = *(const npy_intp *)b;
 
-#define MAKE_T_TO_HALF(TYPE, type)                                             \
-static void                                                                    \
-TYPE ## _to_HALF(type *ip, npy_half *op, npy_intp n,                           \
-               PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
-{                                                                              \
-    float temp;                                                                \
-                                                                               \
-    while (n--) {                                                              \
-        temp = (float)(*ip++);                                                 \
-        *op++ = float_to_half(temp);                                          \
-    }                                                                          \
+    return (x > y) - (x < y);
 }
 
-MAKE_T_TO_HALF(BOOL, npy_bool);
-MAKE_T_TO_HALF(BYTE, npy_byte);
-MAKE_T_TO_HALF(UBYTE, npy_ubyte);
-MAKE_T_TO_HALF(SHORT, npy_short);
-MAKE_T_TO_HALF(USHORT, npy_ushort);
-MAKE_T_TO_HALF(INT, npy_int);
-MAKE_T_TO_HALF(UINT, npy_uint);
-MAKE_T_TO_HALF(LONG, npy_long);
-MAKE_T_TO_HALF(ULONG, npy_ulong);
-MAKE_T_TO_HALF(LONGLONG, npy_longlong);
-MAKE_T_TO_HALF(ULONGLONG, npy_ulonglong);
+/*
+ * partition/argpartition of xfloat16 arrays along an axis, see
+ * half_partition_row.  numpy has no partition hook for user types, its
+ * own np.partition falls back to a comparison sort.
+ */
+static PyObject *
+half_partition(PyObject *args, PyObject *kwds, int arg)
+{
+    static const char *kwlist[] = {"a", "kth", "axis", NULL};
+    PyObject *obj, *kth_obj, *res = NULL;
+    PyArrayObject *arr, *vals = NULL, *kth_arr = NULL, *ret = NULL;
+    npy_intp *kth = NULL, *count = NULL, *off = NULL, nkth, n, rows, i;
+    npy_uint16 *group = NULL, *keys = NULL;
+    npy_half *buf = NULL;
+    int axis = -1, ndim, err = 0;
+    NPY_BEGIN_THREADS_DEF;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|i", (char **)kwlist,
+                                     &obj, &kth_obj, &axis)) {
+        return NULL;
+    }
+    Py_INCREF(&xfloat16_Descr);
+    arr = (PyArrayObject *)PyArray_FromAny(obj, &xfloat16_Descr, 1, 0, 0,
+                                           NULL);
+    if (arr == NULL) {
+        return NULL;
+    }
+    ndim = PyArray_NDIM(arr);
+    if (axis < -ndim || axis >= ndim) {
+        PyErr_Format(PyExc_ValueError, "axis %d is out of bounds for array "
+                     "of dimension %d", axis, ndim);
+        Py_DECREF(arr);
+        return NULL;
+    }
+    if (axis < 0) {
+        axis += ndim;
+    }
+    /* Work on a C-contiguous copy with the axis last */
+    res = PyArray_SwapAxes(arr, axis, ndim - 1);
+    Py_DECREF(arr);
+    if (res == NULL) {
+        return NULL;
+    }
+    vals = (PyArrayObject *)PyArray_NewCopy((PyArrayObject *)res, NPY_CORDER);
+    Py_DECREF(res);
+    res = NULL;
+    if (vals == NULL) {
+        return NULL;
+    }
+    n = PyArray_DIM(vals, ndim - 1);
+    rows = n ? PyArray_SIZE(vals) / n : 0;
 
+    kth_arr = (PyArrayObject *)PyArray_FROMANY(kth_obj, NPY_INTP, 0, 1,
+                                               NPY_ARRAY_CARRAY);
+    if (kth_arr == NULL) {
+        goto finish;
+    }
+    nkth = PyArray_SIZE(kth_arr);
+    kth = (npy_intp *)malloc((nkth + 1) * sizeof(npy_intp));
+    if (kth == NULL) {
+        PyErr_NoMemory();
+        goto finish;
+    }
+    for (i = 0; i < nkth; i++) {
+        kth[i] = ((npy_intp *)PyArray_DATA(kth_arr))[i];
+        if (kth[i] < 0) {
+            kth[i] += n;
+        }
+        if (kth[i] < 0 || kth[i] >= n) {
+            PyErr_Format(PyExc_ValueError, "kth(=%zd) out of bounds (%zd)",
+                         ((npy_intp *)PyArray_DATA(kth_arr))[i], n);
+            goto finish;
+        }
+    }
+    qsort(kth, nkth, sizeof(npy_intp), half_intp_cmp);
 
-static void register_cast_function(int sourceType, int destType, PyArray_VectorUnaryFunc *castfunc)
+    if (arg) {
+        ret = (PyArrayObject *)PyArray_SimpleNew(ndim, PyArray_DIMS(vals),
+                                                 NPY_INTP);
+        if (ret == NULL) {
+            goto finish;
+        }
+    }
+    count = (npy_intp *)malloc(0x10000 * sizeof(npy_intp));
+    group = (npy_uint16 *)malloc(0x10000 * sizeof(npy_uint16));
+    keys = (npy_uint16 *)malloc((nkth + 1) * sizeof(npy_uint16));
+    off = (npy_intp *)malloc((2*nkth + 1) * sizeof(npy_intp));
+    buf = (npy_half *)malloc((n + 1) * sizeof(npy_half));
+    if (count == NULL || group == NULL || keys == NULL || off == NULL ||
+            buf == NULL) {
+        PyErr_NoMemory();
+        goto finish;
+    }
+
+    NPY_BEGIN_THREADS;
+    for (i = 0; i < rows && !err; i++) {
+        err = half_partition_row((npy_half *)PyArray_DATA(vals) + i*n, n,
+                    kth, nkth, arg ? (npy_intp *)PyArray_DATA(ret) + i*n : NULL,
+                    buf, count, group, keys, off);
+    }
+    NPY_END_THREADS;
+    if (err) {
+        PyErr_NoMemory();
+        goto finish;
+    }
+    res = PyArray_SwapAxes(arg ? ret : vals, axis, ndim - 1);
+
+finish:
+    free(kth);
+    free(count);
+    free(group);
+    free(keys);
+    free(off);
+    free(buf);
+    Py_XDECREF(kth_arr);
+    Py_XDECREF(ret);
+    Py_DECREF(vals);
+    return res;
+}
+
+static PyObject *
+halfmod_partition(PyObject *NPY_UNUSED(self), PyObject *args, PyObject *kwds)
 {
-    PyArray_Descr *descr = PyArray_DescrFromType(sourceType);
-    PyArray_RegisterCastFunc(descr, destType, castfunc);
-    Py_DECREF(descr);
+    return half_partition(args, kwds, 0);
 }
 
 static PyObject *
-half_arrtype_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+halfmod_argpartition(PyObject *NPY_UNUSED(self), PyObject *args,
+                     PyObject *kwds)
 {
-    PyObject *obj = NULL;
-    npy_half value = 0;
+    return half_partition(args, kwds, 1);
+}
 
-    if (!PyArg_ParseTuple(args, "|O", &obj)) {
+/*
+ * Parses one column of delimited text into a new xfloat16 array, see
+ * half_parse_column.
+ */
+static PyObject *
+halfmod_loadcolumn(PyObject *NPY_UNUSED(self), PyObject *args, PyObject *kwds)
+{
+    static const char *kwlist[] = {"text", "column", "delimiter", NULL};
+    PyObject *obj, *bytes = NULL, *resized;
+    PyArrayObject *ret;
+    PyArray_Dims shape;
+    const char *text, *delimiter = ",", *p;
+    Py_ssize_t len, column = 0;
+    npy_intp lines, n;
+    NPY_BEGIN_THREADS_DEF;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|ns", (char **)kwlist,
+                                     &obj, &column, &delimiter)) {
         return NULL;
     }
-    if (obj != NULL) {
-        value = MyPyFloat_AsHalf(obj);
+    if (column < 0 || strlen(delimiter) != 1) {
+        PyErr_SetString(PyExc_ValueError,
+                "column must be nonnegative and delimiter one character");
+        return NULL;
     }
-    return PyArray_Scalar(&value, &xfloat16_Descr, NULL);
+    if (PyUnicode_Check(obj)) {
+        text = PyUnicode_AsUTF8AndSize(obj, &len);
+    }
+    else if (PyBytes_Check(obj)) {
+        bytes = obj;
+        Py_INCREF(bytes);
+        text = PyBytes_AS_STRING(bytes);
+        len = PyBytes_GET_SIZE(bytes);
+    }
+    else {
+        PyErr_SetString(PyExc_TypeError, "text must be str or bytes");
+        return NULL;
+    }
+    if (text == NULL) {
+        return NULL;
+    }
+    if ((Py_ssize_t)strlen(text) != len) {
+        PyErr_SetString(PyExc_ValueError, "text contains a NUL character");
+        Py_XDECREF(bytes);
+        return NULL;
+    }
+    lines = 1;
+    for (p = text; (p = strchr(p, '\n')) != NULL; p++) {
+        lines++;
+    }
+    Py_INCREF(&xfloat16_Descr);
+    ret = (PyArrayObject *)PyArray_NewFromDescr(&PyArray_Type,
+                &xfloat16_Descr, 1, &lines, NULL, NULL, 0, NULL);
+    if (ret == NULL) {
+        Py_XDECREF(bytes);
+        return NULL;
+    }
+    NPY_BEGIN_THREADS;
+    n = half_parse_column(text, delimiter[0], column,
+                          (npy_half *)PyArray_DATA(ret));
+    NPY_END_THREADS;
+    Py_XDECREF(bytes);
+    if (n < 0) {
+        PyErr_Format(PyExc_ValueError,
+                "line %zd: field %zd is missing or not a number",
+                (Py_ssize_t)(-n), column);
+        Py_DECREF(ret);
+        return NULL;
+    }
+    shape.ptr = &n;
+    shape.len = 1;
+    resized = PyArray_Resize(ret, &shape, 0, NPY_CORDER);
+    if (resized == NULL) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    Py_DECREF(resized);
+    return (PyObject *)ret;
 }
 
 static PyObject *
-gentype_richcompare(PyObject *self, PyObject *other, int cmp_op)
+halfmod_bfloat16_to_xfloat16(PyObject *NPY_UNUSED(self), PyObject *args,
+                             PyObject *kwds)
 {
-    PyObject *arr, *ret;
-
-    arr = PyArray_FromScalar(self, NULL);
-    if (arr == NULL) {
-        return NULL;
-    }
-    ret = Py_TYPE(arr)->tp_richcompare(arr, other, cmp_op);
-    Py_DECREF(arr);
-    return ret;
+    return half_convert_bits(args, kwds, &xfloat16_Descr,
+                             (PyArray_VectorUnaryFunc *)BFLOAT16_to_HALF);
 }
 
-static long
-halftype_hash(PyObject *obj)
+static PyObject *
+halfmod_xfloat16_to_bfloat16(PyObject *NPY_UNUSED(self), PyObject *args,
+                             PyObject *kwds)
 {
-    double temp;
-    temp = half_to_double(((PyXHalfScalarObject *)obj)->obval);
-    return _Py_HashDouble(*((double*)&temp));
+    return half_convert_bits(args, kwds, &NPyBfloat16_Descr,
+                             (PyArray_VectorUnaryFunc *)HALF_to_BFLOAT16);
 }
 
-PyObject* halftype_repr(PyObject *o)
+/*
+ * Rounds float32 or float64 values to xfloat16 with a rounding mode,
+ * see floatbits_to_halfbits_round_n.  The threads each take a part at
+ * its own counter offset, so stochastic rounding gives the same bits
+ * for any number of threads.
+ */
+typedef struct {
+    const char *ip;
+    npy_uint16 *op;
+    int wide, mode;
+    npy_uint64 seed, start;
+} half_round_ctx;
+
+static void
+half_round_part(void *ctx, npy_intp start, npy_intp len)
 {
-    double temp;
-    char str[48];
+    half_round_ctx *c = (half_round_ctx *)ctx;
 
-    temp = half_to_double(((PyXHalfScalarObject *)o)->obval);
-    sprintf(str, "xfloat16(%g)", *((double*)&temp));
-    return PyUnicode_FromString(str);
+    if (c->wide) {
+        doublebits_to_halfbits_round_n((const npy_uint64 *)c->ip + start,
+                c->op + start, len, c->mode, c->seed, c->start + start);
+    }
+    else {
+        floatbits_to_halfbits_round_n((const npy_uint32 *)c->ip + start,
+                c->op + start, len, c->mode, c->seed, c->start + start);
+    }
 }
 
-PyObject* halftype_str(PyObject *o)
+static PyObject *
+halfmod_to_xfloat16(PyObject *NPY_UNUSED(self), PyObject *args,
+                    PyObject *kwds)
 {
-    double temp;
-    char str[48];
+    static const char *kwlist[] = {"a", "rounding", "seed", "start", "out",
+                                   NULL};
+    PyObject *obj, *out = NULL;
+    PyArrayObject *arr, *in, *ret;
+    unsigned long long seed = 0, start = 0;
+    int mode = HALF_ROUNDING_NEAREST_EVEN;
+    half_round_ctx ctx;
+    npy_intp n;
+    NPY_BEGIN_THREADS_DEF;
 
-    temp = half_to_double(((PyXHalfScalarObject *)o)->obval);
-    sprintf(str, "%g", *((double*)&temp));
-    return PyUnicode_FromString(str);
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iKKO", (char **)kwlist,
+                                     &obj, &mode, &seed, &start, &out)) {
+        return NULL;
+    }
+    if (mode != HALF_ROUNDING_NEAREST_EVEN &&
+            mode != HALF_ROUNDING_TOWARD_ZERO &&
+            mode != HALF_ROUNDING_STOCHASTIC) {
+        PyErr_SetString(PyExc_ValueError, "invalid rounding mode");
+        return NULL;
+    }
+    arr = (PyArrayObject *)PyArray_FromAny(obj, NULL, 0, 0, 0, NULL);
+    if (arr == NULL) {
+        return NULL;
+    }
+    /* Anything but float32 goes through float64 */
+    ctx.wide = PyArray_TYPE(arr) != NPY_FLOAT;
+    in = (PyArrayObject *)PyArray_FromArray(arr,
+                PyArray_DescrFromType(ctx.wide ? NPY_DOUBLE : NPY_FLOAT),
+                NPY_ARRAY_C_CONTIGUOUS | NPY_ARRAY_ALIGNED |
+                NPY_ARRAY_NOTSWAPPED | NPY_ARRAY_FORCECAST);
+    Py_DECREF(arr);
+    if (in == NULL) {
+        return NULL;
+    }
+    ret = half_conversion_result(in, out, &xfloat16_Descr);
+    if (ret == NULL) {
+        Py_DECREF(in);
+        return NULL;
+    }
+    ctx.ip = (const char *)PyArray_DATA(in);
+    ctx.op = (npy_uint16 *)PyArray_DATA(ret);
+    ctx.mode = mode;
+    ctx.seed = seed;
+    ctx.start = start;
+    n = PyArray_SIZE(in);
+    if (!half_parallel_run(n, half_round_part, &ctx)) {
+        NPY_BEGIN_THREADS;
+        half_round_part(&ctx, 0, n);
+        NPY_END_THREADS;
+    }
+    Py_DECREF(in);
+    return (PyObject *)ret;
 }
 
-#if PY_MAJOR_VERSION >= 3
-  #define MOD_ERROR_VAL NULL
-  #define MOD_SUCCESS_VAL(val) val
-  #define MOD_INIT(name) PyMODINIT_FUNC PyInit_##name(void)
-  #define MOD_DEF(ob, name, doc, methods) \
-          static struct PyModuleDef moduledef = { \
-            PyModuleDef_HEAD_INIT, name, doc, -1, methods, }; \
-          ob = PyModule_Create(&moduledef);
-#else
-  #define MOD_ERROR_VAL
-  #define MOD_SUCCESS_VAL(val)
-  #define MOD_INIT(name) void init##name(void)
-  #define MOD_DEF(ob, name, doc, methods) \
-          ob = Py_InitModule3(name, methods, doc);
-#endif
+static PyObject *
+halfmod_get_num_threads(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+    return PyLong_FromLong(half_get_num_threads());
+}
 
+static PyObject *
+halfmod_set_num_threads(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    int n;
+
+    if (!PyArg_ParseTuple(args, "i", &n)) {
+        return NULL;
+    }
+    if (n <= 0) {
+        n = half_cpu_count();
+    }
+    if (!HALF_HAVE_THREADS) {
+        n = 1;
+    }
+    half_num_threads = n > HALF_MAX_THREADS ? HALF_MAX_THREADS : n;
+    return PyLong_FromLong(half_num_threads);
+}
 
 static PyMethodDef HalfMethods[] = {
+    {"simd_level", halfmod_simd_level, METH_NOARGS,
+     "simd_level()\n\nThe SIMD level used by the bulk conversions."},
+    {"set_simd_level", halfmod_set_simd_level, METH_VARARGS,
+     "set_simd_level(level)\n\nCaps the SIMD level used by the bulk "
+     "conversions, -1 restores\nthe detected level.  Returns the level "
+     "selected."},
+    {"dot_accumulation", halfmod_dot_accumulation, METH_NOARGS,
+     "dot_accumulation()\n\nHow dot products are accumulated, one of "
+     "DOT_FLOAT, DOT_PAIRWISE\nor DOT_DOUBLE."},
+    {"set_dot_accumulation", halfmod_set_dot_accumulation, METH_VARARGS,
+     "set_dot_accumulation(mode)\n\nSets how dot products are accumulated: "
+     "DOT_FLOAT sums in float32,\nDOT_PAIRWISE sums float32 blocks "
+     "pairwise (the default), DOT_DOUBLE\nsums in float64."},
+    {"decode_mode", halfmod_decode_mode, METH_NOARGS,
+     "decode_mode()\n\nHow halves are widened, one of DECODE_AUTO, "
+     "DECODE_BITS or\nDECODE_TABLE."},
+    {"set_decode_mode", halfmod_set_decode_mode, METH_VARARGS,
+     "set_decode_mode(mode)\n\nSets how halves are widened: DECODE_BITS "
+     "with bit manipulation or\nSIMD, DECODE_TABLE with lookups in a "
+     "table of all 65536 values, or\nDECODE_AUTO (the default) with "
+     "lookups where they are faster."},
+    {"fpe_mode", halfmod_fpe_mode, METH_NOARGS,
+     "fpe_mode()\n\nHow casts and ufuncs rounding to xfloat16 report "
+     "overflow and underflow,\none of FPE_RAISE or FPE_IGNORE."},
+    {"set_fpe_mode", halfmod_set_fpe_mode, METH_VARARGS,
+     "set_fpe_mode(mode)\n\nSets how casts, ufuncs and reductions rounding "
+     "to xfloat16 or\nbfloat16 report overflow and underflow: FPE_RAISE "
+     "(the default)\nraises each flag once per call for NumPy's error "
+     "state, FPE_IGNORE\nraises nothing."},
+    {"fp8_saturation", halfmod_fp8_saturation, METH_NOARGS,
+     "fp8_saturation()\n\nHow casts to the FP8 types handle values out of "
+     "range, one of\nFP8_NONSATURATING or FP8_SATURATING."},
+    {"set_fp8_saturation", halfmod_set_fp8_saturation, METH_VARARGS,
+     "set_fp8_saturation(mode)\n\nSets how casts to the FP8 types handle "
+     "values out of range and\ninfinities: FP8_NONSATURATING (the default) "
+     "gives NaN for\nfloat8_e4m3fn and inf for float8_e5m2, FP8_SATURATING "
+     "gives the\nlargest finite value."},
+    {"bfloat16_to_xfloat16", (PyCFunction)halfmod_bfloat16_to_xfloat16,
+     METH_VARARGS | METH_KEYWORDS,
+     "bfloat16_to_xfloat16(a, out=None)\n\nConverts an array of bfloat16 "
+     "bits (bfloat16, or raw uint16) to\nxfloat16, rounding to nearest "
+     "even, into out if given."},
+    {"xfloat16_to_bfloat16", (PyCFunction)halfmod_xfloat16_to_bfloat16,
+     METH_VARARGS | METH_KEYWORDS,
+     "xfloat16_to_bfloat16(a, out=None)\n\nConverts an array of half bits "
+     "(xfloat16, or raw uint16) to\nbfloat16, rounding to nearest even, "
+     "into out if given."},
+    {"to_xfloat16", (PyCFunction)halfmod_to_xfloat16,
+     METH_VARARGS | METH_KEYWORDS,
+     "to_xfloat16(a, rounding=ROUND_NEAREST_EVEN, seed=0, start=0, "
+     "out=None)\n\nRounds a to xfloat16 once, from float32 or else through "
+     "float64,\nwith ROUND_NEAREST_EVEN, ROUND_TOWARD_ZERO or "
+     "ROUND_STOCHASTIC, into\nout if given.  Stochastic rounding takes the "
+     "random bits of element\ni (in C order) from counter start + i of the "
+     "stream selected by\nseed, so the result depends only on seed and "
+     "start, not on the\nSIMD level or the number of threads."},
+    {"loadcolumn", (PyCFunction)halfmod_loadcolumn,
+     METH_VARARGS | METH_KEYWORDS,
+     "loadcolumn(text, column=0, delimiter=',')\n\nParses field column "
+     "(from 0) of each line of the str or bytes text\ninto an xfloat16 "
+     "array, rounding the decimal values once to nearest\neven.  Fields "
+     "may be padded with spaces and blank lines are skipped."},
+    {"partition", (PyCFunction)halfmod_partition,
+     METH_VARARGS | METH_KEYWORDS,
+     "partition(a, kth, axis=-1)\n\nLike numpy.partition for xfloat16 arrays, "
+     "with NaNs last.  Long\nrows are selected in two passes with a "
+     "histogram of the values."},
+    {"argpartition", (PyCFunction)halfmod_argpartition,
+     METH_VARARGS | METH_KEYWORDS,
+     "argpartition(a, kth, axis=-1)\n\nLike numpy.argpartition for xfloat16 "
+     "arrays, see partition."},
+    {"get_num_threads", halfmod_get_num_threads, METH_NOARGS,
+     "get_num_threads()\n\nThe number of threads large casts and "
+     "elementwise loops are split\nbetween."},
+    {"set_num_threads", halfmod_set_num_threads, METH_VARARGS,
+     "set_num_threads(n)\n\nSets the number of threads large casts and "
+     "elementwise loops are\nsplit between.  0 selects the default: "
+     "OMP_NUM_THREADS if it is set,\nor else one per CPU the process may "
+     "run on.  Loops under 65536\nelements per thread run serially.  "
+     "Returns the number selected."},
     {NULL, NULL, 0, NULL}
 };
 const char* module___doc__ = "";
 
+/*
+ * Sets up the scalar type and array functions of one FP8 type, and
+ * registers it and its casts.  Returns its type number, or -1.
+ */
+#define MAKE_FP8_REGISTER(FP8)                                                 \
+static int                                                                     \
+register_ ## FP8(int halfNum, int bfloat16Num)                                 \
+{                                                                              \
+    PyArray_ArrFuncs *f = &NPy ## FP8 ## _ArrFuncs;                            \
+    int num;                                                                   \
+                                                                               \
+    Py ## FP8 ## ArrType_Type.tp_flags = Py_TPFLAGS_DEFAULT |                  \
+                                         Py_TPFLAGS_BASETYPE;                  \
+    Py ## FP8 ## ArrType_Type.tp_doc = "8-bit floating-point values";          \
+    Py ## FP8 ## ArrType_Type.tp_new = FP8 ## _arrtype_new;                    \
+    Py ## FP8 ## ArrType_Type.tp_richcompare = gentype_richcompare;            \
+    Py ## FP8 ## ArrType_Type.tp_hash = FP8 ## type_hash;                      \
+    Py ## FP8 ## ArrType_Type.tp_repr = FP8 ## type_repr;                      \
+    Py ## FP8 ## ArrType_Type.tp_str = FP8 ## type_str;                        \
+    Py ## FP8 ## ArrType_Type.tp_base = &PyFloatingArrType_Type;               \
+    if (PyType_Ready(&Py ## FP8 ## ArrType_Type) < 0) {                        \
+        PyErr_Print();                                                         \
+        PyErr_SetString(PyExc_SystemError,                                     \
+                        "could not initialize Py" #FP8 "ArrType_Type");        \
+        return -1;                                                             \
+    }                                                                          \
+                                                                               \
+    PyArray_InitArrFuncs(f);                                                   \
+    f->getitem = (PyArray_GetItemFunc*)FP8 ## _getitem;                        \
+    f->setitem = (PyArray_SetItemFunc*)FP8 ## _setitem;                        \
+    f->copyswap = (PyArray_CopySwapFunc*)FLOAT8_copyswap;                      \
+    f->copyswapn = (PyArray_CopySwapNFunc*)FLOAT8_copyswapn;                   \
+    f->compare = (PyArray_CompareFunc*)FP8 ## _compare;                        \
+    f->argmax = (PyArray_ArgFunc*)FP8 ## _argmax;                              \
+    f->argmin = (PyArray_ArgFunc*)FP8 ## _argmin;                              \
+    f->nonzero = (PyArray_NonzeroFunc*)FLOAT8_nonzero;                         \
+    f->cast[NPY_BOOL] = (PyArray_VectorUnaryFunc*)FP8 ## _to_BOOL;             \
+    f->cast[NPY_BYTE] = (PyArray_VectorUnaryFunc*)FP8 ## _to_BYTE;             \
+    f->cast[NPY_UBYTE] = (PyArray_VectorUnaryFunc*)FP8 ## _to_UBYTE;           \
+    f->cast[NPY_SHORT] = (PyArray_VectorUnaryFunc*)FP8 ## _to_SHORT;           \
+    f->cast[NPY_USHORT] = (PyArray_VectorUnaryFunc*)FP8 ## _to_USHORT;         \
+    f->cast[NPY_INT] = (PyArray_VectorUnaryFunc*)FP8 ## _to_INT;               \
+    f->cast[NPY_UINT] = (PyArray_VectorUnaryFunc*)FP8 ## _to_UINT;             \
+    f->cast[NPY_LONG] = (PyArray_VectorUnaryFunc*)FP8 ## _to_LONG;             \
+    f->cast[NPY_ULONG] = (PyArray_VectorUnaryFunc*)FP8 ## _to_ULONG;           \
+    f->cast[NPY_LONGLONG] = (PyArray_VectorUnaryFunc*)FP8 ## _to_LONGLONG;     \
+    f->cast[NPY_ULONGLONG] = (PyArray_VectorUnaryFunc*)FP8 ## _to_ULONGLONG;   \
+    f->cast[NPY_FLOAT] = (PyArray_VectorUnaryFunc*)FP8 ## _to_FLOAT;           \
+    f->cast[NPY_DOUBLE] = (PyArray_VectorUnaryFunc*)FP8 ## _to_DOUBLE;         \
+    f->cast[NPY_LONGDOUBLE] = (PyArray_VectorUnaryFunc*)FP8 ## _to_LONGDOUBLE; \
+                                                                               \
+    Py_INCREF(&Py ## FP8 ## ArrType_Type);                                     \
+    Py_TYPE(&NPy ## FP8 ## _Descr) = &PyArrayDescr_Type;                       \
+    num = PyArray_RegisterDataType(&NPy ## FP8 ## _Descr);                     \
+    if (num < 0) {                                                             \
+        return -1;                                                             \
+    }                                                                          \
+                                                                               \
+    register_cast_function(NPY_BOOL, num, (PyArray_VectorUnaryFunc*)BOOL_to_ ## FP8); \
+    register_cast_function(NPY_BYTE, num, (PyArray_VectorUnaryFunc*)BYTE_to_ ## FP8); \
+    register_cast_function(NPY_UBYTE, num, (PyArray_VectorUnaryFunc*)UBYTE_to_ ## FP8); \
+    register_cast_function(NPY_SHORT, num, (PyArray_VectorUnaryFunc*)SHORT_to_ ## FP8); \
+    register_cast_function(NPY_USHORT, num, (PyArray_VectorUnaryFunc*)USHORT_to_ ## FP8); \
+    register_cast_function(NPY_INT, num, (PyArray_VectorUnaryFunc*)INT_to_ ## FP8); \
+    register_cast_function(NPY_UINT, num, (PyArray_VectorUnaryFunc*)UINT_to_ ## FP8); \
+    register_cast_function(NPY_LONG, num, (PyArray_VectorUnaryFunc*)LONG_to_ ## FP8); \
+    register_cast_function(NPY_ULONG, num, (PyArray_VectorUnaryFunc*)ULONG_to_ ## FP8); \
+    register_cast_function(NPY_LONGLONG, num, (PyArray_VectorUnaryFunc*)LONGLONG_to_ ## FP8); \
+    register_cast_function(NPY_ULONGLONG, num, (PyArray_VectorUnaryFunc*)ULONGLONG_to_ ## FP8); \
+    register_cast_function(NPY_FLOAT, num, (PyArray_VectorUnaryFunc*)FLOAT_to_ ## FP8); \
+    register_cast_function(NPY_DOUBLE, num, (PyArray_VectorUnaryFunc*)DOUBLE_to_ ## FP8); \
+    register_cast_function(NPY_LONGDOUBLE, num, (PyArray_VectorUnaryFunc*)LONGDOUBLE_to_ ## FP8); \
+    PyArray_RegisterCastFunc(&xfloat16_Descr, num,                             \
+                             (PyArray_VectorUnaryFunc*)HALF_to_ ## FP8);       \
+    PyArray_RegisterCastFunc(&NPy ## FP8 ## _Descr, halfNum,                   \
+                             (PyArray_VectorUnaryFunc*)FP8 ## _to_HALF);       \
+    PyArray_RegisterCastFunc(&NPyBfloat16_Descr, num,                          \
+                             (PyArray_VectorUnaryFunc*)BFLOAT16_to_ ## FP8);   \
+    PyArray_RegisterCastFunc(&NPy ## FP8 ## _Descr, bfloat16Num,               \
+                             (PyArray_VectorUnaryFunc*)FP8 ## _to_BFLOAT16);   \
+                                                                               \
+    /* Both FP8 formats are held exactly by all the wider floats */            \
+    PyArray_RegisterCanCast(&NPy ## FP8 ## _Descr, halfNum, NPY_NOSCALAR);     \
+    PyArray_RegisterCanCast(&NPy ## FP8 ## _Descr, bfloat16Num, NPY_NOSCALAR); \
+    PyArray_RegisterCanCast(&NPy ## FP8 ## _Descr, NPY_FLOAT, NPY_NOSCALAR);   \
+    PyArray_RegisterCanCast(&NPy ## FP8 ## _Descr, NPY_DOUBLE, NPY_NOSCALAR);  \
+    PyArray_RegisterCanCast(&NPy ## FP8 ## _Descr, NPY_LONGDOUBLE,             \
+                            NPY_NOSCALAR);                                     \
+    register_safe_cast(NPY_BOOL, num);                                         \
+    return num;                                                                \
+}
+
+MAKE_FP8_REGISTER(E4M3)
+MAKE_FP8_REGISTER(E5M2)
+
 PyMODINIT_FUNC PyInit_numpy_xhalf(void)
 {
-    PyObject *m;
-    int halfNum;
-    PyArray_Descr *descr;
+    PyObject *m, *numpy;
+    int halfNum, bfloat16Num, e4m3Num, e5m2Num;
+    int binary_types[3], compare_types[3];
 
     m = NULL;
 
@@ -727,6 +3808,11 @@ PyMODINIT_FUNC PyInit_numpy_xhalf(void)
 
     /* Make sure NumPy is initialized */
     import_array();
+    import_umath();
+
+#if HALF_HAVE_THREADS
+    pthread_atfork(NULL, NULL, half_pool_atfork_child);
+#endif
 
     /* Register the half array scalar type */
 #if defined(NPY_PY3K)
@@ -750,18 +3836,20 @@ PyMODINIT_FUNC PyInit_numpy_xhalf(void)
     PyArray_InitArrFuncs(&_PyXHalf_ArrFuncs);
     _PyXHalf_ArrFuncs.getitem = (PyArray_GetItemFunc*)HALF_getitem;
     _PyXHalf_ArrFuncs.setitem = (PyArray_SetItemFunc*)HALF_setitem;
-    /* copy copyswap and copyswapn from uint16 */
-    descr = PyArray_DescrFromType(NPY_UINT16);
-    _PyXHalf_ArrFuncs.copyswap = descr->f->copyswap;
-    _PyXHalf_ArrFuncs.copyswapn = descr->f->copyswapn;
-    Py_DECREF(descr);
+    _PyXHalf_ArrFuncs.copyswap = (PyArray_CopySwapFunc*)HALF_copyswap;
+    _PyXHalf_ArrFuncs.copyswapn = (PyArray_CopySwapNFunc*)HALF_copyswapn;
     _PyXHalf_ArrFuncs.compare = (PyArray_CompareFunc*)HALF_compare;
     _PyXHalf_ArrFuncs.argmax = (PyArray_ArgFunc*)HALF_argmax;
+    _PyXHalf_ArrFuncs.argmin = (PyArray_ArgFunc*)HALF_argmin;
+    _PyXHalf_ArrFuncs.sort[NPY_QUICKSORT] = (PyArray_SortFunc*)HALF_quicksort;
+    _PyXHalf_ArrFuncs.sort[NPY_HEAPSORT] = (PyArray_SortFunc*)HALF_quicksort;
+    _PyXHalf_ArrFuncs.sort[NPY_MERGESORT] = (PyArray_SortFunc*)HALF_mergesort;
+    _PyXHalf_ArrFuncs.argsort[NPY_QUICKSORT] = (PyArray_ArgSortFunc*)HALF_argsort;
+    _PyXHalf_ArrFuncs.argsort[NPY_HEAPSORT] = (PyArray_ArgSortFunc*)HALF_argsort;
+    _PyXHalf_ArrFuncs.argsort[NPY_MERGESORT] = (PyArray_ArgSortFunc*)HALF_argsort;
     _PyXHalf_ArrFuncs.dotfunc = (PyArray_DotFunc*)HALF_dot;
-    /*
     _PyXHalf_ArrFuncs.scanfunc = (PyArray_ScanFunc*)HALF_scan;
     _PyXHalf_ArrFuncs.fromstr = (PyArray_FromStrFunc*)HALF_fromstr;
-    */
     _PyXHalf_ArrFuncs.nonzero = (PyArray_NonzeroFunc*)HALF_nonzero;
     _PyXHalf_ArrFuncs.fill = (PyArray_FillFunc*)HALF_fill;
     _PyXHalf_ArrFuncs.fillwithscalar = (PyArray_FillWithScalarFunc*)HALF_fillwithscalar;
@@ -807,6 +3895,54 @@ PyMODINIT_FUNC PyInit_numpy_xhalf(void)
     if (halfNum < 0)
         return NULL;
 
+    /* The bfloat16 scalar type and array functions */
+    PyBfloat16ArrType_Type.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
+    PyBfloat16ArrType_Type.tp_new = bfloat16_arrtype_new;
+    PyBfloat16ArrType_Type.tp_richcompare = gentype_richcompare;
+    PyBfloat16ArrType_Type.tp_hash = bfloat16type_hash;
+    PyBfloat16ArrType_Type.tp_repr = bfloat16type_repr;
+    PyBfloat16ArrType_Type.tp_str = bfloat16type_str;
+    PyBfloat16ArrType_Type.tp_base = &PyFloatingArrType_Type;
+    if (PyType_Ready(&PyBfloat16ArrType_Type) < 0) {
+        PyErr_Print();
+        PyErr_SetString(PyExc_SystemError, "could not initialize PyBfloat16ArrType_Type");
+        return NULL;
+    }
+
+    PyArray_InitArrFuncs(&NPyBfloat16_ArrFuncs);
+    NPyBfloat16_ArrFuncs.getitem = (PyArray_GetItemFunc*)BFLOAT16_getitem;
+    NPyBfloat16_ArrFuncs.setitem = (PyArray_SetItemFunc*)BFLOAT16_setitem;
+    NPyBfloat16_ArrFuncs.copyswap = _PyXHalf_ArrFuncs.copyswap;
+    NPyBfloat16_ArrFuncs.copyswapn = _PyXHalf_ArrFuncs.copyswapn;
+    NPyBfloat16_ArrFuncs.compare = (PyArray_CompareFunc*)BFLOAT16_compare;
+    NPyBfloat16_ArrFuncs.argmax = (PyArray_ArgFunc*)BFLOAT16_argmax;
+    NPyBfloat16_ArrFuncs.argmin = (PyArray_ArgFunc*)BFLOAT16_argmin;
+    NPyBfloat16_ArrFuncs.dotfunc = (PyArray_DotFunc*)BFLOAT16_dot;
+    NPyBfloat16_ArrFuncs.nonzero = (PyArray_NonzeroFunc*)BFLOAT16_nonzero;
+    NPyBfloat16_ArrFuncs.fill = (PyArray_FillFunc*)BFLOAT16_fill;
+    NPyBfloat16_ArrFuncs.fillwithscalar = (PyArray_FillWithScalarFunc*)HALF_fillwithscalar;
+    NPyBfloat16_ArrFuncs.cast[NPY_BOOL] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_BOOL;
+    NPyBfloat16_ArrFuncs.cast[NPY_BYTE] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_BYTE;
+    NPyBfloat16_ArrFuncs.cast[NPY_UBYTE] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_UBYTE;
+    NPyBfloat16_ArrFuncs.cast[NPY_SHORT] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_SHORT;
+    NPyBfloat16_ArrFuncs.cast[NPY_USHORT] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_USHORT;
+    NPyBfloat16_ArrFuncs.cast[NPY_INT] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_INT;
+    NPyBfloat16_ArrFuncs.cast[NPY_UINT] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_UINT;
+    NPyBfloat16_ArrFuncs.cast[NPY_LONG] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_LONG;
+    NPyBfloat16_ArrFuncs.cast[NPY_ULONG] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_ULONG;
+    NPyBfloat16_ArrFuncs.cast[NPY_LONGLONG] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_LONGLONG;
+    NPyBfloat16_ArrFuncs.cast[NPY_ULONGLONG] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_ULONGLONG;
+    NPyBfloat16_ArrFuncs.cast[NPY_FLOAT] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_FLOAT;
+    NPyBfloat16_ArrFuncs.cast[NPY_DOUBLE] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_DOUBLE;
+    NPyBfloat16_ArrFuncs.cast[NPY_LONGDOUBLE] = (PyArray_VectorUnaryFunc*)BFLOAT16_to_LONGDOUBLE;
+
+    Py_INCREF(&PyBfloat16ArrType_Type);
+    Py_TYPE(&NPyBfloat16_Descr) = &PyArrayDescr_Type;
+    bfloat16Num = PyArray_RegisterDataType(&NPyBfloat16_Descr);
+
+    if (bfloat16Num < 0)
+        return NULL;
+
     register_cast_function(NPY_BOOL, halfNum, (PyArray_VectorUnaryFunc*)BOOL_to_HALF);
     register_cast_function(NPY_BYTE, halfNum, (PyArray_VectorUnaryFunc*)BYTE_to_HALF);
     register_cast_function(NPY_UBYTE, halfNum, (PyArray_VectorUnaryFunc*)UBYTE_to_HALF);
@@ -831,7 +3967,148 @@ PyMODINIT_FUNC PyInit_numpy_xhalf(void)
     PyArray_RegisterCanCast(&xfloat16_Descr, NPY_CFLOAT, NPY_NOSCALAR);
     PyArray_RegisterCanCast(&xfloat16_Descr, NPY_CDOUBLE, NPY_NOSCALAR);
     PyArray_RegisterCanCast(&xfloat16_Descr, NPY_CLONGDOUBLE, NPY_NOSCALAR);
+    /*
+     * Like for float16, these cast safely to xfloat16.  Without them dot()
+     * promotes xfloat16 operands (against bool) to float32.
+     */
+    register_safe_cast(NPY_BOOL, halfNum);
+    register_safe_cast(NPY_BYTE, halfNum);
+    register_safe_cast(NPY_UBYTE, halfNum);
+
+    register_cast_function(NPY_BOOL, bfloat16Num, (PyArray_VectorUnaryFunc*)BOOL_to_BFLOAT16);
+    register_cast_function(NPY_BYTE, bfloat16Num, (PyArray_VectorUnaryFunc*)BYTE_to_BFLOAT16);
+    register_cast_function(NPY_UBYTE, bfloat16Num, (PyArray_VectorUnaryFunc*)UBYTE_to_BFLOAT16);
+    register_cast_function(NPY_SHORT, bfloat16Num, (PyArray_VectorUnaryFunc*)SHORT_to_BFLOAT16);
+    register_cast_function(NPY_USHORT, bfloat16Num, (PyArray_VectorUnaryFunc*)USHORT_to_BFLOAT16);
+    register_cast_function(NPY_INT, bfloat16Num, (PyArray_VectorUnaryFunc*)INT_to_BFLOAT16);
+    register_cast_function(NPY_UINT, bfloat16Num, (PyArray_VectorUnaryFunc*)UINT_to_BFLOAT16);
+    register_cast_function(NPY_LONG, bfloat16Num, (PyArray_VectorUnaryFunc*)LONG_to_BFLOAT16);
+    register_cast_function(NPY_ULONG, bfloat16Num, (PyArray_VectorUnaryFunc*)ULONG_to_BFLOAT16);
+    register_cast_function(NPY_LONGLONG, bfloat16Num, (PyArray_VectorUnaryFunc*)LONGLONG_to_BFLOAT16);
+    register_cast_function(NPY_ULONGLONG, bfloat16Num, (PyArray_VectorUnaryFunc*)ULONGLONG_to_BFLOAT16);
+    register_cast_function(NPY_FLOAT, bfloat16Num, (PyArray_VectorUnaryFunc*)FLOAT_to_BFLOAT16);
+    register_cast_function(NPY_DOUBLE, bfloat16Num, (PyArray_VectorUnaryFunc*)DOUBLE_to_BFLOAT16);
+    register_cast_function(NPY_LONGDOUBLE, bfloat16Num, (PyArray_VectorUnaryFunc*)LONGDOUBLE_to_BFLOAT16);
+    PyArray_RegisterCastFunc(&xfloat16_Descr, bfloat16Num,
+                             (PyArray_VectorUnaryFunc*)HALF_to_BFLOAT16);
+    PyArray_RegisterCastFunc(&NPyBfloat16_Descr, halfNum,
+                             (PyArray_VectorUnaryFunc*)BFLOAT16_to_HALF);
+
+    /*
+     * bfloat16 widens safely to the floats, and holds the 8 bit integers
+     * exactly.  Neither of xfloat16 and bfloat16 holds the other.
+     */
+    PyArray_RegisterCanCast(&NPyBfloat16_Descr, NPY_FLOAT, NPY_NOSCALAR);
+    PyArray_RegisterCanCast(&NPyBfloat16_Descr, NPY_DOUBLE, NPY_NOSCALAR);
+    PyArray_RegisterCanCast(&NPyBfloat16_Descr, NPY_LONGDOUBLE, NPY_NOSCALAR);
+    register_safe_cast(NPY_BOOL, bfloat16Num);
+    register_safe_cast(NPY_BYTE, bfloat16Num);
+    register_safe_cast(NPY_UBYTE, bfloat16Num);
+
+    /*
+     * The FP8 types.  There are no casts between them: numpy would take
+     * any cast between two types of the same kind and size as safe, so
+     * they convert through xfloat16 instead, which holds both exactly.
+     */
+    e4m3Num = register_E4M3(halfNum, bfloat16Num);
+    if (e4m3Num < 0) {
+        return NULL;
+    }
+    e5m2Num = register_E5M2(halfNum, bfloat16Num);
+    if (e5m2Num < 0) {
+        return NULL;
+    }
+
+    /* The ufunc loops */
+    numpy = PyImport_ImportModule("numpy");
+    if (numpy == NULL) {
+        return NULL;
+    }
+    binary_types[0] = binary_types[1] = binary_types[2] = halfNum;
+    if (register_ufunc_loop(numpy, "add",
+                (PyUFuncGenericFunction)HALF_add, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "subtract",
+                (PyUFuncGenericFunction)HALF_subtract, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "multiply",
+                (PyUFuncGenericFunction)HALF_multiply, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "true_divide",
+                (PyUFuncGenericFunction)HALF_divide, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "matmul",
+                (PyUFuncGenericFunction)HALF_matmul, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "maximum",
+                (PyUFuncGenericFunction)HALF_maximum, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "minimum",
+                (PyUFuncGenericFunction)HALF_minimum, binary_types) < 0) {
+        Py_DECREF(numpy);
+        return NULL;
+    }
+    compare_types[0] = compare_types[1] = halfNum;
+    compare_types[2] = NPY_BOOL;
+    if (register_ufunc_loop(numpy, "equal",
+                (PyUFuncGenericFunction)HALF_equal, compare_types) < 0 ||
+        register_ufunc_loop(numpy, "not_equal",
+                (PyUFuncGenericFunction)HALF_not_equal, compare_types) < 0 ||
+        register_ufunc_loop(numpy, "less",
+                (PyUFuncGenericFunction)HALF_less, compare_types) < 0 ||
+        register_ufunc_loop(numpy, "less_equal",
+                (PyUFuncGenericFunction)HALF_less_equal, compare_types) < 0 ||
+        register_ufunc_loop(numpy, "greater",
+                (PyUFuncGenericFunction)HALF_greater, compare_types) < 0 ||
+        register_ufunc_loop(numpy, "greater_equal",
+                (PyUFuncGenericFunction)HALF_greater_equal,
+                compare_types) < 0) {
+        Py_DECREF(numpy);
+        return NULL;
+    }
+    binary_types[0] = binary_types[1] = binary_types[2] = bfloat16Num;
+    compare_types[0] = compare_types[1] = bfloat16Num;
+    if (register_ufunc_loop(numpy, "add",
+                (PyUFuncGenericFunction)BFLOAT16_add, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "subtract",
+                (PyUFuncGenericFunction)BFLOAT16_subtract, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "multiply",
+                (PyUFuncGenericFunction)BFLOAT16_multiply, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "true_divide",
+                (PyUFuncGenericFunction)BFLOAT16_divide, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "maximum",
+                (PyUFuncGenericFunction)BFLOAT16_maximum, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "minimum",
+                (PyUFuncGenericFunction)BFLOAT16_minimum, binary_types) < 0 ||
+        register_ufunc_loop(numpy, "equal",
+                (PyUFuncGenericFunction)BFLOAT16_equal, compare_types) < 0 ||
+        register_ufunc_loop(numpy, "not_equal",
+                (PyUFuncGenericFunction)BFLOAT16_not_equal, compare_types) < 0 ||
+        register_ufunc_loop(numpy, "less",
+                (PyUFuncGenericFunction)BFLOAT16_less, compare_types) < 0 ||
+        register_ufunc_loop(numpy, "less_equal",
+                (PyUFuncGenericFunction)BFLOAT16_less_equal, compare_types) < 0 ||
+        register_ufunc_loop(numpy, "greater",
+                (PyUFuncGenericFunction)BFLOAT16_greater, compare_types) < 0 ||
+        register_ufunc_loop(numpy, "greater_equal",
+                (PyUFuncGenericFunction)BFLOAT16_greater_equal,
+                compare_types) < 0) {
+        Py_DECREF(numpy);
+        return NULL;
+    }
+    Py_DECREF(numpy);
 
     PyModule_AddObject(m, "xfloat16", (PyObject *)&PyXHalfArrType_Type);
+    PyModule_AddObject(m, "bfloat16", (PyObject *)&PyBfloat16ArrType_Type);
+    PyModule_AddObject(m, "float8_e4m3fn", (PyObject *)&PyE4M3ArrType_Type);
+    PyModule_AddObject(m, "float8_e5m2", (PyObject *)&PyE5M2ArrType_Type);
+    PyModule_AddIntConstant(m, "DOT_FLOAT", HALF_DOT_FLOAT);
+    PyModule_AddIntConstant(m, "DOT_PAIRWISE", HALF_DOT_PAIRWISE);
+    PyModule_AddIntConstant(m, "DOT_DOUBLE", HALF_DOT_DOUBLE);
+    PyModule_AddIntConstant(m, "DECODE_AUTO", HALF_DECODE_AUTO);
+    PyModule_AddIntConstant(m, "DECODE_BITS", HALF_DECODE_BITS);
+    PyModule_AddIntConstant(m, "DECODE_TABLE", HALF_DECODE_TABLE);
+    PyModule_AddIntConstant(m, "FPE_RAISE", HALF_FPE_RAISE);
+    PyModule_AddIntConstant(m, "FPE_IGNORE", HALF_FPE_IGNORE);
+    PyModule_AddIntConstant(m, "ROUND_NEAREST_EVEN",
+                            HALF_ROUNDING_NEAREST_EVEN);
+    PyModule_AddIntConstant(m, "ROUND_TOWARD_ZERO", HALF_ROUNDING_TOWARD_ZERO);
+    PyModule_AddIntConstant(m, "ROUND_STOCHASTIC", HALF_ROUNDING_STOCHASTIC);
+    PyModule_AddIntConstant(m, "FP8_NONSATURATING", HALF_FP8_NONSATURATING);
+    PyModule_AddIntConstant(m, "FP8_SATURATING", HALF_FP8_SATURATING);
     return m;
 }
@@ -8,6 +8,7 @@ def configuration(parent_package='',top_path=None):
     config = Configuration('half',parent_package,top_path)
     config.add_extension('numpy_xhalf',['halffloat.h','halffloat.cc','numpy_half.cc'])
     #config.add_data_dir('tests')
+    config.add_data_dir('benchmarks')
     return config
 
 if __name__ == "__main__":
@@ -0,0 +1,641 @@
+/*
+ * Conformance harness for the half conversion kernels.  Every kernel in
+ * the table below is checked bit for bit against the scalar reference
+ * routines of halffloat.c:
+ *
+ *   half -> float, half -> double   all 65536 halves
+ *   float -> half                   all 2^32 float patterns, in parallel
+ *   double -> half                  every half, every midpoint and the
+ *                                   doubles a few ulps around them, the
+ *                                   underflow and overflow boundaries,
+ *                                   NaN payloads and random patterns
+ *
+ * Strict kernels must also give the same NaN payloads and raise the same
+ * overflow and underflow flags over each block of 4096 values; the others
+ * only need to return some NaN for a NaN.  It needs neither Python nor
+ * NumPy:
+ *
+ *   cc -O2 -pthread -DHALF_STANDALONE -I. tests/check_conversions.c \
+ *      halffloat.c -lm -o check_conversions
+ *   ./check_conversions [--quick] [--threads N]
+ *
+ * Add -DCHECK_NPYMATH and link with NumPy's npymath library to check
+ * NumPy's own float16 conversions too.  A new kernel is checked by adding
+ * its bulk routines to the kernels table; a NULL routine skips that
+ * direction.  The exit status is 1 if anything differs.
+ */
+#include "halffloat.h"
+#include <fenv.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define CHECK_THREADS 0
+#else
+#include <pthread.h>
+#include <unistd.h>
+#define CHECK_THREADS 1
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define CHECK_HAVE_F16C 1
+#else
+#define CHECK_HAVE_F16C 0
+#endif
+
+#define CHECK_BLOCK 4096
+#define CHECK_EXAMPLES 8
+#define CHECK_FLAGS (FE_OVERFLOW | FE_UNDERFLOW | FE_INVALID)
+
+enum { FLOAT_TO_HALF, DOUBLE_TO_HALF, HALF_TO_FLOAT, HALF_TO_DOUBLE,
+       NDIRECTIONS };
+
+static const char *direction_names[NDIRECTIONS] = {
+    "float -> half", "double -> half", "half -> float", "half -> double"
+};
+
+/*
+ * A kernel under test.  level >= 0 selects that SIMD level of the bulk
+ * routines of halffloat.c before running, and skips the kernel if the
+ * CPU does not have it.  available, when set, decides the same for other
+ * kernels.
+ */
+typedef struct {
+    const char *name;
+    int level;
+    int (*available)(void);
+    void (*float_to_half)(const npy_uint32 *f, npy_uint16 *h, npy_intp n);
+    void (*double_to_half)(const npy_uint64 *d, npy_uint16 *h, npy_intp n);
+    void (*half_to_float)(const npy_uint16 *h, npy_uint32 *f, npy_intp n);
+    void (*half_to_double)(const npy_uint16 *h, npy_uint64 *d, npy_intp n);
+    int strict;
+} kernel;
+
+/*
+ ********************************************************************
+ *                         OTHER KERNELS                            *
+ ********************************************************************
+ */
+
+#if CHECK_HAVE_F16C
+static int
+f16c_available(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    /* CPUID.1:ECX bit 29 is F16C */
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 29));
+}
+
+__attribute__((target("f16c"))) static void
+f16c_float_to_half(const npy_uint32 *f, npy_uint16 *h, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        __m128 v = _mm_castsi128_ps(_mm_cvtsi32_si128((int)f[i]));
+        h[i] = (npy_uint16)_mm_cvtsi128_si32(
+                        _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+    }
+}
+
+__attribute__((target("f16c"))) static void
+f16c_half_to_float(const npy_uint16 *h, npy_uint32 *f, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        __m128 v = _mm_cvtph_ps(_mm_cvtsi32_si128(h[i]));
+        f[i] = (npy_uint32)_mm_cvtsi128_si32(_mm_castps_si128(v));
+    }
+}
+
+__attribute__((target("f16c"))) static void
+f16c_half_to_double(const npy_uint16 *h, npy_uint64 *d, npy_intp n)
+{
+    npy_intp i;
+    double x;
+
+    for (i = 0; i < n; i++) {
+        x = _mm_cvtss_f32(_mm_cvtph_ps(_mm_cvtsi32_si128(h[i])));
+        memcpy(&d[i], &x, sizeof(x));
+    }
+}
+#endif
+
+#ifdef CHECK_NPYMATH
+/* From NumPy's npymath library, declared here to avoid its headers */
+#ifdef __cplusplus
+extern "C" {
+#endif
+npy_uint16 npy_floatbits_to_halfbits(npy_uint32 f);
+npy_uint16 npy_doublebits_to_halfbits(npy_uint64 d);
+npy_uint32 npy_halfbits_to_floatbits(npy_uint16 h);
+npy_uint64 npy_halfbits_to_doublebits(npy_uint16 h);
+#ifdef __cplusplus
+}
+#endif
+
+static void
+npymath_float_to_half(const npy_uint32 *f, npy_uint16 *h, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        h[i] = npy_floatbits_to_halfbits(f[i]);
+    }
+}
+
+static void
+npymath_double_to_half(const npy_uint64 *d, npy_uint16 *h, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        h[i] = npy_doublebits_to_halfbits(d[i]);
+    }
+}
+
+static void
+npymath_half_to_float(const npy_uint16 *h, npy_uint32 *f, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        f[i] = npy_halfbits_to_floatbits(h[i]);
+    }
+}
+
+static void
+npymath_half_to_double(const npy_uint16 *h, npy_uint64 *d, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        d[i] = npy_halfbits_to_doublebits(h[i]);
+    }
+}
+#endif
+
+static const kernel kernels[] = {
+    {"bulk, no SIMD", HALF_SIMD_NONE, NULL,
+     floatbits_to_halfbits_n, doublebits_to_halfbits_n,
+     halfbits_to_floatbits_n, halfbits_to_doublebits_n, 1},
+    {"bulk, SSE2", HALF_SIMD_SSE2, NULL,
+     floatbits_to_halfbits_n, doublebits_to_halfbits_n,
+     halfbits_to_floatbits_n, halfbits_to_doublebits_n, 1},
+    {"bulk, AVX2", HALF_SIMD_AVX2, NULL,
+     floatbits_to_halfbits_n, doublebits_to_halfbits_n,
+     halfbits_to_floatbits_n, halfbits_to_doublebits_n, 1},
+    {"bulk, AVX-512", HALF_SIMD_AVX512, NULL,
+     floatbits_to_halfbits_n, doublebits_to_halfbits_n,
+     halfbits_to_floatbits_n, halfbits_to_doublebits_n, 1},
+#if CHECK_HAVE_F16C
+    /* The hardware quiets signalling NaNs */
+    {"F16C instructions", -1, f16c_available,
+     f16c_float_to_half, NULL, f16c_half_to_float, f16c_half_to_double, 0},
+#endif
+#ifdef CHECK_NPYMATH
+    {"NumPy npymath", -1, NULL,
+     npymath_float_to_half, npymath_double_to_half,
+     npymath_half_to_float, npymath_half_to_double, 1},
+#endif
+};
+#define NKERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+/*
+ ********************************************************************
+ *                            INPUTS                                *
+ ********************************************************************
+ */
+
+static npy_uint64 *double_inputs = NULL;
+static npy_intp ndouble_inputs = 0, double_inputs_size = 0;
+
+static void
+add_double(npy_uint64 d)
+{
+    if (ndouble_inputs == double_inputs_size) {
+        double_inputs_size = double_inputs_size ? 2 * double_inputs_size
+                                                : 1 << 16;
+        double_inputs = (npy_uint64 *)realloc(double_inputs,
+                                double_inputs_size * sizeof(npy_uint64));
+        if (double_inputs == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(2);
+        }
+    }
+    double_inputs[ndouble_inputs++] = d;
+}
+
+/* d and the doubles up to ulps away from it, with both signs */
+static void
+add_double_around(double x, int ulps)
+{
+    npy_uint64 d;
+    int i;
+
+    memcpy(&d, &x, sizeof(d));
+    d &= 0x7fffffffffffffffULL;
+    for (i = -ulps; i <= ulps; i++) {
+        if ((i >= 0 || d >= (npy_uint64)-i) &&
+                d + i <= 0x7ff0000000000000ULL) {
+            add_double(d + i);
+            add_double((d + i) | 0x8000000000000000ULL);
+        }
+    }
+}
+
+static npy_uint64 rng_state = 0x9e3779b97f4a7c15ULL;
+
+static npy_uint64
+rng_next(void)
+{
+    /* xorshift64 */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* The value of a positive half, or 65536 for 0x7c00 */
+static double
+half_value(int h)
+{
+    if (h < 0x400) {
+        return ldexp(h, -24);
+    }
+    return ldexp((h & 0x3ff) | 0x400, (h >> 10) - 25);
+}
+
+/* The boundary patterns for double -> half */
+static void
+make_double_inputs(int quick)
+{
+    npy_uint64 d;
+    double x, next;
+    int h, e, i, nrandom = quick ? 1 << 16 : 1 << 22;
+
+    for (h = 0; h < 0x7c00; h++) {
+        x = half_value(h);
+        next = half_value(h + 1);
+        add_double_around(x, 2);
+        /* The midpoint, and with a sticky bit far below the half */
+        add_double_around((x + next) / 2, 2);
+        add_double_around((x + next) / 2 + ldexp(x + next, -50), 0);
+        add_double_around((x + next) / 2 - ldexp(x + next, -50), 0);
+    }
+    /* Every binade below the half range and above it */
+    for (e = -1074; e < 1024; e++) {
+        add_double_around(ldexp(1.0, e), 1);
+        add_double_around(ldexp(1.5, e), 0);
+    }
+    add_double_around(65520.0, 3);
+    add_double_around(ldexp(1.0, -25), 3);
+    add_double_around(ldexp(3.0, -26), 3);
+    /* Infinities and NaN payloads in every bit */
+    for (i = 0; i <= 52; i++) {
+        d = 0x7ff0000000000000ULL | (i < 52 ? 1ULL << i : 0);
+        add_double(d);
+        add_double(d | 0x8000000000000000ULL);
+        add_double(d | 0x0008000000000000ULL);
+    }
+    for (i = 0; i < nrandom; i++) {
+        add_double(rng_next());
+    }
+}
+
+static void
+make_inputs(int direction, npy_uint64 start, npy_intp n, void *in)
+{
+    npy_intp i;
+
+    switch (direction) {
+        case FLOAT_TO_HALF:
+            for (i = 0; i < n; i++) {
+                ((npy_uint32 *)in)[i] = (npy_uint32)(start + i);
+            }
+            break;
+        case DOUBLE_TO_HALF:
+            memcpy(in, double_inputs + start, n * sizeof(npy_uint64));
+            break;
+        default:
+            for (i = 0; i < n; i++) {
+                ((npy_uint16 *)in)[i] = (npy_uint16)(start + i);
+            }
+            break;
+    }
+}
+
+static npy_uint64
+input_count(int direction)
+{
+    switch (direction) {
+        case FLOAT_TO_HALF:
+            return (npy_uint64)1 << 32;
+        case DOUBLE_TO_HALF:
+            return ndouble_inputs;
+        default:
+            return 1 << 16;
+    }
+}
+
+/*
+ ********************************************************************
+ *                           CHECKING                               *
+ ********************************************************************
+ */
+
+static void
+run_reference(int direction, const void *in, void *out, npy_intp n)
+{
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        switch (direction) {
+            case FLOAT_TO_HALF:
+                ((npy_uint16 *)out)[i] =
+                        floatbits_to_halfbits(((const npy_uint32 *)in)[i]);
+                break;
+            case DOUBLE_TO_HALF:
+                ((npy_uint16 *)out)[i] =
+                        doublebits_to_halfbits(((const npy_uint64 *)in)[i]);
+                break;
+            case HALF_TO_FLOAT:
+                ((npy_uint32 *)out)[i] =
+                        halfbits_to_floatbits(((const npy_uint16 *)in)[i]);
+                break;
+            default:
+                ((npy_uint64 *)out)[i] =
+                        halfbits_to_doublebits(((const npy_uint16 *)in)[i]);
+                break;
+        }
+    }
+}
+
+static int
+has_direction(const kernel *k, int direction)
+{
+    switch (direction) {
+        case FLOAT_TO_HALF:
+            return k->float_to_half != NULL;
+        case DOUBLE_TO_HALF:
+            return k->double_to_half != NULL;
+        case HALF_TO_FLOAT:
+            return k->half_to_float != NULL;
+        default:
+            return k->half_to_double != NULL;
+    }
+}
+
+static void
+run_kernel(const kernel *k, int direction, const void *in, void *out,
+           npy_intp n)
+{
+    switch (direction) {
+        case FLOAT_TO_HALF:
+            k->float_to_half((const npy_uint32 *)in, (npy_uint16 *)out, n);
+            break;
+        case DOUBLE_TO_HALF:
+            k->double_to_half((const npy_uint64 *)in, (npy_uint16 *)out, n);
+            break;
+        case HALF_TO_FLOAT:
+            k->half_to_float((const npy_uint16 *)in, (npy_uint32 *)out, n);
+            break;
+        default:
+            k->half_to_double((const npy_uint16 *)in, (npy_uint64 *)out, n);
+            break;
+    }
+}
+
+/* The i-th element of a buffer of halves, floats or doubles as bits */
+static npy_uint64
+element(const void *p, int size, npy_intp i)
+{
+    switch (size) {
+        case 2:
+            return ((const npy_uint16 *)p)[i];
+        case 4:
+            return ((const npy_uint32 *)p)[i];
+        default:
+            return ((const npy_uint64 *)p)[i];
+    }
+}
+
+static int
+is_nan_bits(npy_uint64 v, int size)
+{
+    switch (size) {
+        case 2:
+            return (v & 0x7fffu) > 0x7c00u;
+        case 4:
+            return (v & 0x7fffffffu) > 0x7f800000u;
+        default:
+            return (v & 0x7fffffffffffffffULL) > 0x7ff0000000000000ULL;
+    }
+}
+
+typedef struct {
+    npy_uint64 input, expected, actual;
+    int flags;      /* 0 for a value, else the reference flags */
+    int actual_flags;
+} mismatch;
+
+typedef struct {
+    const kernel *k;
+    int direction, thread, nthreads, quick;
+    npy_uint64 count;
+    npy_uint64 nmismatches, nchecked;
+    mismatch examples[CHECK_EXAMPLES];
+} job;
+
+static void
+record(job *j, npy_uint64 input, npy_uint64 expected, npy_uint64 actual,
+       int flags, int actual_flags)
+{
+    if (j->nmismatches < CHECK_EXAMPLES) {
+        mismatch *m = &j->examples[j->nmismatches];
+
+        m->input = input;
+        m->expected = expected;
+        m->actual = actual;
+        m->flags = flags;
+        m->actual_flags = actual_flags;
+    }
+    j->nmismatches++;
+}
+
+static void *
+run_job(void *arg)
+{
+    job *j = (job *)arg;
+    static const int in_sizes[NDIRECTIONS] = {4, 8, 2, 2};
+    static const int out_sizes[NDIRECTIONS] = {2, 2, 4, 8};
+    int in_size = in_sizes[j->direction], size = out_sizes[j->direction];
+    npy_uint64 nblocks = (j->count + CHECK_BLOCK - 1) / CHECK_BLOCK, b;
+    npy_uint64 in[CHECK_BLOCK], expected[CHECK_BLOCK], actual[CHECK_BLOCK];
+    npy_uint64 e, a;
+    npy_intp n, i;
+    int ref_flags, flags;
+
+    for (b = j->thread; b < nblocks; b += j->nthreads) {
+        /* The quick check takes every 61st block of the float patterns */
+        if (j->quick && j->direction == FLOAT_TO_HALF && b % 61 != 0) {
+            continue;
+        }
+        n = (npy_intp)(j->count - b * CHECK_BLOCK < CHECK_BLOCK ?
+                       j->count - b * CHECK_BLOCK : CHECK_BLOCK);
+        make_inputs(j->direction, b * CHECK_BLOCK, n, in);
+        feclearexcept(FE_ALL_EXCEPT);
+        run_reference(j->direction, in, expected, n);
+        ref_flags = fetestexcept(CHECK_FLAGS);
+        feclearexcept(FE_ALL_EXCEPT);
+        run_kernel(j->k, j->direction, in, actual, n);
+        flags = fetestexcept(CHECK_FLAGS);
+        for (i = 0; i < n; i++) {
+            e = element(expected, size, i);
+            a = element(actual, size, i);
+            if (e != a && (j->k->strict || !is_nan_bits(e, size) ||
+                                           !is_nan_bits(a, size))) {
+                record(j, element(in, in_size, i), e, a, 0, 0);
+            }
+        }
+        if (j->k->strict && flags != ref_flags) {
+            record(j, element(in, in_size, 0), 0, 0, ref_flags | 0x10000,
+                   flags);
+        }
+        j->nchecked += n;
+    }
+    return NULL;
+}
+
+static void
+print_flags(int flags)
+{
+    printf("%s%s%s%s", (flags & FE_OVERFLOW) ? " overflow" : "",
+           (flags & FE_UNDERFLOW) ? " underflow" : "",
+           (flags & FE_INVALID) ? " invalid" : "",
+           (flags & CHECK_FLAGS) ? "" : " none");
+}
+
+/* Checks one kernel in one direction, returning the mismatch count */
+static npy_uint64
+check(const kernel *k, int direction, int nthreads, int quick)
+{
+    job *jobs = (job *)calloc(nthreads, sizeof(job));
+    npy_uint64 nmismatches = 0, nchecked = 0;
+    int t, i, shown = 0;
+#if CHECK_THREADS
+    pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+#endif
+
+    for (t = 0; t < nthreads; t++) {
+        jobs[t].k = k;
+        jobs[t].direction = direction;
+        jobs[t].thread = t;
+        jobs[t].nthreads = nthreads;
+        jobs[t].quick = quick;
+        jobs[t].count = input_count(direction);
+#if CHECK_THREADS
+        if (nthreads > 1) {
+            pthread_create(&threads[t], NULL, run_job, &jobs[t]);
+            continue;
+        }
+#endif
+        run_job(&jobs[t]);
+    }
+    for (t = 0; t < nthreads; t++) {
+#if CHECK_THREADS
+        if (nthreads > 1) {
+            pthread_join(threads[t], NULL);
+        }
+#endif
+        nmismatches += jobs[t].nmismatches;
+        nchecked += jobs[t].nchecked;
+    }
+
+    printf("%-20s %-16s %12llu checked  ", k->name,
+           direction_names[direction], (unsigned long long)nchecked);
+    if (nmismatches == 0) {
+        printf("ok\n");
+    }
+    else {
+        printf("%llu MISMATCHES\n", (unsigned long long)nmismatches);
+    }
+    for (t = 0; t < nthreads; t++) {
+        for (i = 0; i < CHECK_EXAMPLES && i < (int)jobs[t].nmismatches &&
+                    shown < CHECK_EXAMPLES; i++, shown++) {
+            mismatch *m = &jobs[t].examples[i];
+
+            if (m->flags) {
+                printf("    block from 0x%llx: flags",
+                       (unsigned long long)m->input);
+                print_flags(m->flags);
+                printf(", kernel");
+                print_flags(m->actual_flags);
+                printf("\n");
+            }
+            else {
+                printf("    0x%llx: reference 0x%llx, kernel 0x%llx\n",
+                       (unsigned long long)m->input,
+                       (unsigned long long)m->expected,
+                       (unsigned long long)m->actual);
+            }
+        }
+    }
+    fflush(stdout);
+#if CHECK_THREADS
+    free(threads);
+#endif
+    free(jobs);
+    return nmismatches;
+}
+
+int
+main(int argc, char **argv)
+{
+    int quick = 0, nthreads = 1, i, direction;
+    npy_uint64 failures = 0;
+
+#if CHECK_THREADS
+    nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = 1;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "usage: %s [--quick] [--threads N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (nthreads < 1 || !CHECK_THREADS) {
+        nthreads = 1;
+    }
+    make_double_inputs(quick);
+
+    for (i = 0; i < NKERNELS; i++) {
+        const kernel *k = &kernels[i];
+
+        if ((k->level >= 0 && half_set_simd_level(k->level) != k->level) ||
+                (k->available != NULL && !k->available())) {
+            printf("%-20s not available on this CPU\n", k->name);
+            continue;
+        }
+        for (direction = 0; direction < NDIRECTIONS; direction++) {
+            if (has_direction(k, direction)) {
+                failures += check(k, direction, nthreads, quick) != 0;
+            }
+        }
+    }
+    half_set_simd_level(-1);
+    free(double_inputs);
+    return failures != 0;
+}
@@ -198,3 +198,951 @@ def test_half_funcs():
     a = np.arange(10, dtype=float16)
     for i in range(10):
         assert_equal(a.item(i),i)
+
+def test_half_simd_casts():
+    """Checks that every SIMD level casts float32/float64 <-> xfloat16
+       exactly like the scalar routines, NaN payloads included"""
+    from half import xfloat16, numpy_xhalf
+
+    # All 16-bit values, and float32 values around every rounding
+    # boundary and NaN payload
+    h = np.arange(0x10000, dtype=uint16)
+    low = np.array([0, 1, 0x0fff, 0x1000, 0x1001, 0xffff], dtype=np.uint32)
+    f = np.concatenate([
+            np.arange(0, 2**32, 4099, dtype=np.uint64).astype(np.uint32),
+            ((h.astype(np.uint32) << 16) + low[:,None]).ravel()])
+
+    low = np.array([0, 1, 0x7ff, 0x800, 0x3ffffffffff, 0x20000000000,
+                    0x20000000001], dtype=np.uint64)
+    d = np.concatenate([
+            (f.astype(np.uint64) << 32) + 0x80000001,
+            ((np.arange(0x3e000, 0x41000, dtype=np.uint64) << 44) +
+                low[:,None]).ravel()])
+
+    level = numpy_xhalf.simd_level()
+    try:
+        numpy_xhalf.set_simd_level(0)
+        h2f = h.view(xfloat16).astype(float32).view(np.uint32)
+        f2h = f.view(float32).astype(xfloat16).view(uint16)
+        d2h = d.view(float64).astype(xfloat16).view(uint16)
+        for l in range(1, level+1):
+            assert_equal(numpy_xhalf.set_simd_level(l), l)
+            assert_equal(h.view(xfloat16).astype(float32).view(np.uint32),
+                         h2f)
+            assert_equal(f.view(float32).astype(xfloat16).view(uint16),
+                         f2h)
+            assert_equal(d.view(float64).astype(xfloat16).view(uint16),
+                         d2h)
+            assert_equal(d.view(float64)[::2].astype(np.complex128).astype(
+                         xfloat16).view(uint16), d2h[::2])
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+
+    # The scalar reference keeps the sticky bits below a subnormal half
+    a = np.array([2.0**-25 + 2.0**-48, 5*2.0**-25 + 2.0**-46], dtype=float32)
+    assert_equal(a.astype(xfloat16).view(uint16), [0x0001, 0x0003])
+    a = np.array([2.0**-25 + 2.0**-70, 1.0 + 2.0**-11 + 2.0**-50])
+    assert_equal(a.astype(xfloat16).view(uint16), [0x0001, 0x3c01])
+
+def test_half_arithmetic():
+    """Checks the native xfloat16 arithmetic loops against float32
+       arithmetic narrowed once"""
+    from half import xfloat16
+
+    rng = np.random.RandomState(1234)
+    a = (rng.randn(1000)*100).astype(xfloat16)
+    b = (rng.randn(1000)*100).astype(xfloat16)
+    af = a.astype(float32)
+    bf = b.astype(float32)
+
+    for op in [np.add, np.subtract, np.multiply, np.true_divide]:
+        c = op(a, b)
+        assert_equal(c.dtype, np.dtype(xfloat16))
+        assert_equal(c.view(uint16), op(af, bf).astype(xfloat16).view(uint16))
+        # Strided and broadcast operands
+        assert_equal(op(a[:-1:3], b[1::3]).view(uint16),
+                     op(af[:-1:3], bf[1::3]).astype(xfloat16).view(uint16))
+        assert_equal(op(a, b[:1]).view(uint16),
+                     op(af, bf[:1]).astype(xfloat16).view(uint16))
+        assert_equal(op(a[:1], b).view(uint16),
+                     op(af[:1], bf).astype(xfloat16).view(uint16))
+
+    # In-place, and a reduction accumulates without intermediate rounding
+    c = a.copy()
+    c += b
+    assert_equal(c.view(uint16), np.add(a, b).view(uint16))
+    a = np.ones(4096, dtype=xfloat16)
+    assert_equal(np.add.reduce(a), 4096)
+
+    # Overflow and division by zero give infs
+    with np.errstate(all='ignore'):
+        a = np.array([60000, 1, -1], dtype=xfloat16)
+        assert_equal(a + a, [np.inf, 2, -2])
+        assert_equal(a / np.zeros(3, dtype=xfloat16), [np.inf, np.inf, -np.inf])
+
+def test_half_comparisons():
+    """Checks the xfloat16 comparison loops at every SIMD level against
+       float64 comparisons, including NaNs and signed zeros"""
+    from half import xfloat16, numpy_xhalf
+
+    a = np.arange(0x10000, dtype=uint16).view(xfloat16)
+    b = np.random.RandomState(1234).permutation(a.view(uint16)).view(xfloat16)
+    z = np.array([0x8000]*40, dtype=uint16).view(xfloat16)
+    af, bf, zf = [x.astype(float64) for x in (a, b, z)]
+
+    level = numpy_xhalf.simd_level()
+    try:
+        for l in range(level+1):
+            numpy_xhalf.set_simd_level(l)
+            for op in [np.equal, np.not_equal, np.less, np.less_equal,
+                       np.greater, np.greater_equal]:
+                assert_equal(op(a, b), op(af, bf))
+                assert_equal(op(a, b[7]), op(af, bf[7]))
+                assert_equal(op(a[3], b), op(af[3], bf))
+                assert_equal(op(a[::3], b[::-3]), op(af[::3], bf[::-3]))
+                assert_equal(op(z, np.zeros(40, dtype=xfloat16)),
+                             op(zf, np.zeros(40)))
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+
+def test_half_argmax_argmin():
+    """Checks xfloat16 argmax/argmin at every SIMD level"""
+    from half import xfloat16, numpy_xhalf
+
+    rs = np.random.RandomState(4321)
+    a = rs.permutation(np.arange(0x7c01, dtype=uint16))
+    a[::2] |= 0x8000
+    a = a.view(xfloat16)
+    af = a.astype(float64)
+
+    level = numpy_xhalf.simd_level()
+    try:
+        for l in range(level+1):
+            numpy_xhalf.set_simd_level(l)
+            for n in [1, 7, 33, 1000, 1025, 5000, len(a)]:
+                assert_equal(np.argmax(a[:n]), np.argmax(af[:n]))
+                assert_equal(np.argmin(a[:n]), np.argmin(af[:n]))
+            # Ties resolve to the first occurrence, signed zeros are equal
+            z = np.array([-0.0, 0.0, -1.0, 0.0, -1.0]*300, dtype=xfloat16)
+            assert_equal(np.argmax(z), 0)
+            assert_equal(np.argmin(z), 2)
+            # The first nan wins
+            b = a.copy()
+            b[3000] = b[4000] = np.nan
+            assert_equal(np.argmax(b), 3000)
+            assert_equal(np.argmin(b), 3000)
+            assert_equal(np.argmax(a[::-3]), np.argmax(af[::-3]))
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+
+def test_half_reductions():
+    """Checks xfloat16 sum/prod/maximum/minimum reductions at every SIMD level"""
+    from half import xfloat16, numpy_xhalf
+
+    rs = np.random.RandomState(2468)
+    a = rs.uniform(-1, 1, 5000).astype(xfloat16)
+    af = a.astype(float64)
+    p = rs.uniform(0.9, 1.1, 5000).astype(xfloat16)
+    pf = p.astype(float64)
+
+    level = numpy_xhalf.simd_level()
+    try:
+        for l in range(level+1):
+            numpy_xhalf.set_simd_level(l)
+            for n in [1, 7, 33, 256, 1000, 5000]:
+                # Pairwise float accumulation rounds only once at the end
+                assert_equal(np.add.reduce(a[:n]),
+                             np.array(np.sum(af[:n]), dtype=xfloat16))
+                assert_equal(np.multiply.reduce(p[:n]),
+                             np.array(np.prod(pf[:n]), dtype=xfloat16))
+                assert_equal(np.maximum.reduce(a[:n]), a[:n].max())
+                assert_equal(float(np.maximum.reduce(a[:n])), af[:n].max())
+                assert_equal(float(np.minimum.reduce(a[:n])), af[:n].min())
+            assert_equal(np.sum(a[::-3]),
+                         np.array(np.sum(af[::-3]), dtype=xfloat16))
+            assert_equal(float(np.max(a[::-3])), af[::-3].max())
+            assert_equal(np.sum(a.reshape(50, 100), axis=1).astype(float64),
+                         np.sum(af.reshape(50, 100), axis=1).astype(float16))
+            assert_(abs(float(np.mean(a)) - af.mean()) < 1e-3)
+            # Elementwise maximum/minimum propagate the first nan
+            b = a.copy()
+            b[3000] = np.nan
+            assert_(np.isnan(float(np.maximum.reduce(b))))
+            assert_(np.isnan(float(np.minimum.reduce(b))))
+            c = rs.uniform(-1, 1, 5000).astype(xfloat16)
+            assert_equal(np.maximum(a, c).astype(float64),
+                         np.maximum(af, c.astype(float64)))
+            assert_equal(np.minimum(a[::2], c[::2]).astype(float64),
+                         np.minimum(af[::2], c[::2].astype(float64)))
+            m = np.maximum(b, c).astype(float64)
+            assert_(np.isnan(m[3000]))
+            assert_equal(np.isnan(m).sum(), 1)
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+
+def test_half_sort():
+    """Sorts and argsorts with NaNs last, stably for kind='stable'"""
+    from half import xfloat16
+
+    rng = np.random.RandomState(3)
+    for n in (0, 1, 7, 16, 17, 300, 0x10000 + 5):
+        bits = rng.randint(0, 0x10000, n).astype(uint16)
+        bits[rng.rand(n) < 0.1] = 0x8000
+        bits[rng.rand(n) < 0.1] = 0x0000
+        a = bits.view(xfloat16)
+        f = a.astype(float32)
+        expect = np.argsort(f, kind='mergesort')
+        for kind in ('quicksort', 'heapsort', 'mergesort'):
+            s = np.sort(a, kind=kind)
+            assert_equal(s.astype(float32), np.sort(f))
+            assert_equal(np.argsort(a, kind=kind), expect)
+        # The stable sort keeps the order of -0.0 and +0.0
+        assert_equal(np.sort(a, kind='mergesort').view(uint16)[:n-np.isnan(f).sum()],
+                     bits[expect][:n-np.isnan(f).sum()])
+    # Along an axis
+    a = np.array([[3, -1, np.nan, 2], [0, -0.5, 7, -2]], dtype=xfloat16)
+    assert_equal(np.sort(a, axis=1).astype(float32),
+                 [[-1, 2, 3, np.nan], [-2, -0.5, 0, 7]])
+    assert_equal(np.argsort(a, axis=0), [[1, 0, 1, 1], [0, 1, 0, 0]])
+
+def test_half_partition():
+    """partition/argpartition, short rows are sorted and long ones use the
+       histogram selection"""
+    from half import xfloat16, numpy_xhalf
+
+    rng = np.random.RandomState(4)
+    for n in (10, 0x10000 + 7):
+        a = rng.randint(0, 0x10000, n).astype(uint16).view(xfloat16)
+        f = a.astype(float32)
+        s = np.sort(f)
+        for kth in (0, n - 1, n // 2, [3, n // 3, n // 3, -1]):
+            p = numpy_xhalf.partition(a, kth).astype(float32)
+            i = numpy_xhalf.argpartition(a, kth)
+            for k in np.atleast_1d(kth) % n:
+                assert_equal(p[k], s[k])
+                assert_equal(f[i[k]], s[k])
+                assert_(not (p[:k] > p[k]).any() and not (p[k+1:] < p[k]).any())
+                assert_(not (f[i[:k]] > s[k]).any() and
+                        not (f[i[k+1:]] < s[k]).any())
+            assert_equal(np.sort(p), s)
+            assert_equal(np.sort(i), np.arange(n))
+    # Along an axis, NaNs last
+    a = np.array([[3, np.nan, 0], [-1, 5, 2]], dtype=xfloat16)
+    assert_equal(numpy_xhalf.partition(a, 1, axis=0).astype(float32),
+                 [[-1, 5, 0], [3, np.nan, 2]])
+    assert_equal(numpy_xhalf.argpartition(a, 2, axis=1)[:, 2], [1, 1])
+    assert_raises(ValueError, numpy_xhalf.partition, a, 3)
+    assert_raises(ValueError, numpy_xhalf.partition, a, 0, axis=2)
+
+def test_half_scalar_new():
+    """The scalar constructors round like the array casts"""
+    from half import xfloat16, bfloat16, float8_e4m3fn, float8_e5m2
+
+    rng = np.random.RandomState(5)
+    vals = rng.standard_normal(1000) * 10.0 ** rng.randint(-9, 9, 1000)
+    vals = list(vals) + [0.0, -0.0, np.inf, -np.inf, 65520.0, 1e-300]
+    for T in (xfloat16, bfloat16, float8_e4m3fn, float8_e5m2):
+        ref = np.array(vals).astype(T).astype(float64)
+        assert_equal([T(float(v)) for v in vals], ref)
+        assert_equal([T(v) for v in (3, -1000, 2**40)],
+                     np.array([3, -1000, 2**40], float64).astype(T).astype(float64))
+        assert_equal(T(), 0.0)
+        assert_(np.isnan(T(np.nan)) and np.isnan(T(None)))
+        assert_equal(T("1.5"), 1.5)
+        assert_raises(ValueError, T, "abc")
+        assert_raises(TypeError, T, [1])
+        assert_raises(OverflowError, T, 10**400)
+
+def test_half_getitem_cache():
+    """getitem returns cached floats, one per bit pattern"""
+    from half import xfloat16, bfloat16, float8_e4m3fn, float8_e5m2
+
+    for T, n in ((xfloat16, 0x10000), (bfloat16, 0x10000),
+                 (float8_e4m3fn, 0x100), (float8_e5m2, 0x100)):
+        bits = np.arange(n).astype(np.uint8 if n == 0x100 else uint16)
+        a = bits.view(T)
+        ref = a.astype(float64)
+        for l in (a.tolist(), list(a), a[::-1].tolist()[::-1]):
+            assert_equal(np.array(l), ref)
+        assert_(a[1] is a.tolist()[1])
+        assert_(a[0] is not a[n // 2])
+        # Swapped arrays are read through the same cache
+        if n == 0x10000:
+            b = a.byteswap().view(a.dtype.newbyteorder())
+            assert_(b[3] is a[3])
+
+def test_half_byteswap():
+    """Non-native and unaligned 16-bit arrays, at every SIMD level"""
+    from half import xfloat16, bfloat16, numpy_xhalf
+
+    level = numpy_xhalf.simd_level()
+    try:
+        for l in range(level+1):
+            numpy_xhalf.set_simd_level(l)
+            for T in (xfloat16, bfloat16):
+                for n in (1, 7, 31, 32, 33, 100):
+                    bits = np.arange(0x1234, 0x1234 + 409 * n, 409,
+                                     dtype=uint16)
+                    a = bits.view(T)
+                    be = bits.byteswap().view(np.dtype(T).newbyteorder())
+                    buf = np.zeros(2 * n + 1, np.uint8)
+                    un = np.frombuffer(buf, np.dtype(T), n, 1)
+                    un[...] = a
+                    for b in (be, un):
+                        assert_equal(b.astype(T).view(uint16), bits)
+                        assert_equal(b.astype(float32), a.astype(float32))
+                        assert_equal(b.tolist(), a.tolist())
+                        assert_equal(np.count_nonzero(b),
+                                     np.count_nonzero(bits & 0x7fff))
+                        assert_equal(b[::3].astype(T).view(uint16), bits[::3])
+                    assert_equal(a.astype(be.dtype).view(uint16),
+                                 bits.byteswap())
+                    be[n // 2] = 2.5
+                    un[n // 2] = 2.5
+                    assert_equal(be[n // 2], 2.5)
+                    assert_equal(un[n // 2], 2.5)
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+
+def test_half_parse():
+    """Decimal text is rounded once, directly to xfloat16"""
+    from half import xfloat16, numpy_xhalf
+    import tempfile, os
+
+    # Every half value and every midpoint between neighbours
+    a = np.arange(0x7c00, dtype=uint16).view(xfloat16).astype(float64)
+    mid = (a[:-1] + a[1:]) / 2
+    for v in (a, mid, -mid):
+        s = " ".join("%.25f" % x for x in v)
+        assert_equal(np.fromstring(s, xfloat16, sep=" ").view(uint16),
+                     v.astype(xfloat16).view(uint16))
+    # Just above a midpoint, where strtod would round down to it first
+    s = "1.00048828125000000000000000001 0.0000000298023223876953125001"
+    assert_equal(np.fromstring(s, xfloat16, sep=" ").view(uint16),
+                 [0x3c01, 0x0001])
+    s = "65519.99 65520 1e400 -inf Infinity nan -NaN 1e-400 0.0000000298"
+    assert_equal(np.fromstring(s, xfloat16, sep=" ").view(uint16),
+                 [0x7bff, 0x7c00, 0x7c00, 0xfc00, 0x7c00, 0x7e00, 0xfe00,
+                  0, 0])
+
+    text = "a,1.5,x\n\n b , -2.25e1 ,y\r\nc,3,\n"
+    for t in (text, text.encode()):
+        assert_equal(numpy_xhalf.loadcolumn(t, 1).astype(float64),
+                     [1.5, -22.5, 3])
+        assert_equal(numpy_xhalf.loadcolumn(t, column=1).dtype, xfloat16)
+    assert_equal(numpy_xhalf.loadcolumn("1;2\n3;4", 1, ";").astype(float64),
+                 [2, 4])
+    assert_equal(numpy_xhalf.loadcolumn("").shape, (0,))
+    assert_raises(ValueError, numpy_xhalf.loadcolumn, text, 2)
+    assert_raises(ValueError, numpy_xhalf.loadcolumn, text, 0)
+    assert_raises(ValueError, numpy_xhalf.loadcolumn, "1,2", 0, ",,")
+
+    fd, name = tempfile.mkstemp()
+    try:
+        with os.fdopen(fd, "w") as f:
+            f.write("0.1 0.2\n0.3")
+        assert_equal(np.fromfile(name, xfloat16, sep=" ").view(uint16),
+                     np.array([0.1, 0.2, 0.3]).astype(xfloat16).view(uint16))
+        # Tokens longer than the scan buffer are read whole
+        with open(name, "w") as f:
+            f.write("1.00048828125" + "0" * 70 + "1 2.5 1" + "0" * 1000 +
+                    "e-1000 -3")
+        assert_equal(np.fromfile(name, xfloat16, sep=" ").view(uint16),
+                     [0x3c01, 0x4100, 0x3c00, 0xc200])
+    finally:
+        os.unlink(name)
+
+def test_half_conformance():
+    """xfloat16 converts like NumPy's float16; NaNs only need to stay NaN.
+    tests/check_conversions.c checks every float pattern and kernel."""
+    from half import xfloat16
+
+    def same(a, b):
+        nan = np.isnan(a)
+        assert_equal(nan, np.isnan(b))
+        bits = 'u%d' % a.itemsize
+        assert_equal(a[~nan].view(bits), b[~nan].view(bits))
+
+    h = np.arange(0x10000, dtype=uint16)
+    for T in (float32, float64):
+        same(h.view(xfloat16).astype(T), h.view(float16).astype(T))
+    f = np.arange(0, 1 << 32, 4093, dtype=np.uint64).astype(np.uint32)
+    with np.errstate(all='ignore'):
+        for T in (float32, float64):
+            v = f.view(float32).astype(T)
+            assert_equal(np.isnan(v.astype(xfloat16).astype(float32)),
+                         np.isnan(v))
+            ok = ~np.isnan(v)
+            assert_equal(v[ok].astype(xfloat16).view(uint16),
+                         v[ok].astype(float16).view(uint16))
+
+def test_half_fpe_mode():
+    """Rounding to xfloat16 or bfloat16 raises overflow and underflow once
+       per call, or not at all in FPE_IGNORE mode, at every SIMD level and
+       in reductions"""
+    from half import xfloat16, bfloat16, numpy_xhalf
+
+    a = np.ones(101, dtype=xfloat16)
+    big, tiny = a.copy(), a.copy()
+    big[50] = 300
+    tiny[[40, 99]] = 2e-4
+    reductions = []
+    # Sums past the largest finite value, products below the smallest
+    for T, hi, lo in ((xfloat16, [65504, 32], 2e-4),
+                      (bfloat16, [3.3895e38, 1e36], 1e-23)):
+        over, under = np.array(hi, dtype=T), np.full(2, lo, dtype=T)
+        reductions += [(np.add.reduce, over), (lambda x: x.sum(), over),
+                       (np.multiply.reduce, under)]
+    level = numpy_xhalf.simd_level()
+    try:
+        for l in range(level+1):
+            numpy_xhalf.set_simd_level(l)
+            for mode in (numpy_xhalf.FPE_RAISE, numpy_xhalf.FPE_IGNORE):
+                numpy_xhalf.set_fpe_mode(mode)
+                assert_equal(numpy_xhalf.fpe_mode(), mode)
+                with np.errstate(over='raise', under='raise'):
+                    for x in (big, tiny):
+                        if mode == numpy_xhalf.FPE_RAISE:
+                            assert_raises(FloatingPointError,
+                                          np.multiply, x, x)
+                        else:
+                            y = np.multiply(x, x)
+                            with np.errstate(all='ignore'):
+                                r = (x.astype(float32) ** 2).astype(xfloat16)
+                            assert_equal(y.view(uint16), r.view(uint16))
+                    for f, x in reductions:
+                        if mode == numpy_xhalf.FPE_RAISE:
+                            assert_raises(FloatingPointError, f, x)
+                        else:
+                            y = np.array(f(x), dtype=x.dtype)
+                            r = np.array(f(x.astype(float64)), dtype=x.dtype)
+                            assert_equal(y.view(uint16), r.view(uint16))
+                    assert_equal(np.multiply(a, a), a)
+        assert_raises(ValueError, numpy_xhalf.set_fpe_mode, 2)
+    finally:
+        numpy_xhalf.set_fpe_mode(numpy_xhalf.FPE_RAISE)
+        numpy_xhalf.set_simd_level(-1)
+
+def test_half_fpe_flags():
+    """Parsing text and the casts to the FP8 types set overflow and
+       underflow in FPE_RAISE mode only.  NumPy does not check the flags
+       after these, so they are read back with fetestexcept on x86"""
+    import ctypes, ctypes.util, platform
+    from half import xfloat16, float8_e4m3fn, float8_e5m2, numpy_xhalf
+
+    libm = ctypes.util.find_library('m')
+    if libm is None or platform.machine() not in ('x86_64', 'i686', 'i386'):
+        return
+    libm = ctypes.CDLL(libm)
+    OVER, UNDER = 0x08, 0x10  # FE_OVERFLOW and FE_UNDERFLOW on x86
+
+    def flags(f):
+        libm.feclearexcept(0x3d)
+        f()
+        return libm.fetestexcept(OVER | UNDER)
+
+    def fill(T, n, i, v):
+        x = np.ones(n, dtype=T)
+        x[i] = v
+        return x
+    cases = [(OVER, lambda: np.fromstring("1 1e6", xfloat16, sep=" ")),
+             (UNDER, lambda: np.fromstring("1e-9 1", xfloat16, sep=" ")),
+             (0, lambda: np.fromstring("1 65504", xfloat16, sep=" ")),
+             (OVER, lambda: numpy_xhalf.loadcolumn("1\n70000\n2")),
+             (UNDER, lambda: numpy_xhalf.loadcolumn("3e-6")),
+             (0, lambda: numpy_xhalf.loadcolumn("1\n2"))]
+    # In the SIMD loops and in their scalar tails, from float and from half
+    for S in (float32, xfloat16):
+        for i in (0, 36):
+            for T, big, tiny in ((float8_e4m3fn, 500, 1e-3),
+                                 (float8_e5m2, 65000, 1e-5)):
+                for flag, v in ((OVER, big), (UNDER, tiny), (0, 1)):
+                    x = fill(S, 37, i, v)
+                    cases.append((flag, lambda x=x, T=T: x.astype(T)))
+    level = numpy_xhalf.simd_level()
+    try:
+        for l in range(level+1):
+            numpy_xhalf.set_simd_level(l)
+            for mode in (numpy_xhalf.FPE_RAISE, numpy_xhalf.FPE_IGNORE):
+                numpy_xhalf.set_fpe_mode(mode)
+                for flag, f in cases:
+                    if mode == numpy_xhalf.FPE_IGNORE:
+                        flag = 0
+                    with np.errstate(all='ignore'):
+                        assert_equal(flags(f), flag)
+    finally:
+        numpy_xhalf.set_fpe_mode(numpy_xhalf.FPE_RAISE)
+        numpy_xhalf.set_simd_level(-1)
+
+def test_half_rounding_modes():
+    """to_xfloat16 rounds to nearest even, toward zero or stochastically,
+       reproducibly for a seed at every SIMD level and thread count"""
+    from half import xfloat16, numpy_xhalf
+
+    rng = np.random.RandomState(5)
+    bits = rng.randint(0, 1 << 32, 1 << 16, dtype=np.uint64).astype(np.uint32)
+    a32 = np.concatenate([bits.view(float32), (bits >> 3).view(float32),
+                          (rng.standard_normal(1 << 16) *
+                           10 ** rng.uniform(-9, 6, 1 << 16)).astype(float32),
+                          np.array([0, -0.0, np.inf, -np.inf, 65504, 65520,
+                                    -1e5, 2**-25, 3 * 2**-26], float32)])
+    a64 = a32.astype(float64)
+    ok = ~np.isnan(a32)
+
+    # Toward zero: nearest, stepped back where it rounded away from zero
+    # (including overflows to inf)
+    with np.errstate(all='ignore'):
+        near = a32.astype(xfloat16)
+        f = near.astype(float64)
+    rtz = near.view(uint16).copy()
+    rtz[ok & (abs(f) > abs(a64))] -= 1
+
+    level = numpy_xhalf.simd_level()
+    threads = numpy_xhalf.get_num_threads()
+    try:
+        with np.errstate(all='ignore'):
+            sr = numpy_xhalf.to_xfloat16(a32, numpy_xhalf.ROUND_STOCHASTIC, 7)
+            for l in range(level+1):
+                numpy_xhalf.set_simd_level(l)
+                for a in (a32, a64):
+                    r = numpy_xhalf.to_xfloat16(a)
+                    assert_equal(r.view(uint16)[ok], near.view(uint16)[ok])
+                    r = numpy_xhalf.to_xfloat16(a, numpy_xhalf.ROUND_TOWARD_ZERO)
+                    assert_equal(r.view(uint16)[ok], rtz[ok])
+                    r = numpy_xhalf.to_xfloat16(a, numpy_xhalf.ROUND_STOCHASTIC, 7)
+                    assert_equal(r.view(uint16)[ok], sr.view(uint16)[ok])
+            # Split at the counters, and between threads
+            r = np.empty(len(a32), xfloat16)
+            numpy_xhalf.to_xfloat16(a32[:1001], numpy_xhalf.ROUND_STOCHASTIC,
+                                    7, out=r[:1001])
+            numpy_xhalf.to_xfloat16(a32[1001:], numpy_xhalf.ROUND_STOCHASTIC,
+                                    7, 1001, out=r[1001:])
+            assert_equal(r.view(uint16), sr.view(uint16))
+            numpy_xhalf.set_num_threads(3)
+            r = numpy_xhalf.to_xfloat16(a32, numpy_xhalf.ROUND_STOCHASTIC, 7)
+            assert_equal(r.view(uint16), sr.view(uint16))
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+        numpy_xhalf.set_num_threads(threads)
+
+    # Stochastic rounding picks a neighbour, and exact values stay put
+    s = sr.view(uint16)[ok]
+    assert_(np.all((s == rtz[ok]) | (s == rtz[ok] + 1)))
+    exact = ok & (f == a64)
+    assert_equal(sr.view(uint16)[exact], near.view(uint16)[exact])
+    r = numpy_xhalf.to_xfloat16(a32, numpy_xhalf.ROUND_STOCHASTIC, 8)
+    assert_(np.any(r.view(uint16) != sr.view(uint16)))
+
+    # ... with the probability of the fraction dropped
+    for x in [1 + 1./3072, np.pi, -0.3, 1e-6, 1e-9]:
+        r = numpy_xhalf.to_xfloat16(np.full(1 << 16, x), 2, 3)
+        lo, hi = np.sort(np.unique(np.abs(r.astype(float64))))[[0, -1]]
+        p = (abs(x) - lo) / (hi - lo)
+        assert_(abs(np.mean(np.abs(r.astype(float64)) == hi) - p) < 0.01)
+
+    assert_raises(ValueError, numpy_xhalf.to_xfloat16, a32, 3)
+
+def test_half_dot():
+    """Checks xfloat16 dot products in every accumulation mode and at
+       every SIMD level against float64"""
+    from half import xfloat16, numpy_xhalf
+
+    rs = np.random.RandomState(99)
+    a = rs.uniform(-1, 1, 5000).astype(xfloat16)
+    b = rs.uniform(-1, 1, 5000).astype(xfloat16)
+    af, bf = a.astype(float64), b.astype(float64)
+
+    level = numpy_xhalf.simd_level()
+    mode = numpy_xhalf.dot_accumulation()
+    try:
+        for m in [numpy_xhalf.DOT_FLOAT, numpy_xhalf.DOT_PAIRWISE,
+                  numpy_xhalf.DOT_DOUBLE]:
+            numpy_xhalf.set_dot_accumulation(m)
+            for l in range(level+1):
+                numpy_xhalf.set_simd_level(l)
+                for n in [0, 1, 15, 31, 257, 5000]:
+                    expected = np.dot(af[:n], bf[:n]).astype(xfloat16)
+                    got = np.dot(a[:n], b[:n])
+                    if m == numpy_xhalf.DOT_DOUBLE:
+                        assert_equal(got, expected)
+                    else:
+                        assert_(abs(float(got) - float(expected)) <=
+                                np.spacing(float16(expected)))
+                assert_equal(np.dot(a[::3], b[1::3]),
+                             np.dot(af[::3], bf[1::3]).astype(xfloat16))
+                # strided operands are summed across their gather blocks
+                # like contiguous ones: 2**24 + 1 is 2**24 in float32, so
+                # this cancels to 0 unless the mode sums in float64
+                c = np.zeros((3072, 2), dtype=xfloat16)
+                d = np.zeros((3072, 2), dtype=xfloat16)
+                c[[0, 1024, 2048], 0] = [4096, 1, -4096]
+                d[[0, 1024, 2048], 0] = [4096, 1, 4096]
+                r = 1 if m == numpy_xhalf.DOT_DOUBLE else 0
+                assert_equal(np.dot(c[:, 0], d[:, 0]), r)
+                assert_equal(np.dot(c[:, 0].copy(), d[:, 0].copy()), r)
+                # nans and infs propagate
+                c = a.copy()
+                c[1234] = np.inf
+                assert_equal(np.dot(c, abs(b)), np.inf)
+                c[4321] = np.nan
+                assert_(np.isnan(float(np.dot(c, b))))
+                # matrix products stay in xfloat16
+                m2 = rs.uniform(-1, 1, (7, 300)).astype(xfloat16)
+                m2f = m2.astype(float64)
+                assert_equal(np.dot(m2, m2.T).dtype, xfloat16)
+                assert_allclose(np.dot(m2, m2.T).astype(float64),
+                                np.dot(m2f, m2f.T), rtol=2**-10, atol=2**-10)
+        assert_raises(ValueError, numpy_xhalf.set_dot_accumulation, 7)
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+        numpy_xhalf.set_dot_accumulation(mode)
+
+def test_half_matmul():
+    """Checks the xfloat16 matmul loop at every SIMD level against a
+       float64 product, including matrix-vector shapes"""
+    from half import xfloat16, numpy_xhalf
+
+    rs = np.random.RandomState(7)
+    level = numpy_xhalf.simd_level()
+    try:
+        for l in range(level+1):
+            numpy_xhalf.set_simd_level(l)
+            for m, k, n in [(1, 1, 1), (5, 3, 7), (13, 300, 40),
+                            (100, 600, 530), (7, 0, 5), (2000, 64, 1),
+                            (1, 700, 1), (1, 300, 70), (40, 1, 3),
+                            (1, 0, 40)]:
+                a = rs.uniform(-1, 1, (m, k)).astype(xfloat16)
+                b = rs.uniform(-1, 1, (k, n)).astype(xfloat16)
+                c = np.matmul(a, b)
+                assert_equal(c.dtype, xfloat16)
+                assert_allclose(c.astype(float64),
+                        np.matmul(a.astype(float64), b.astype(float64)),
+                        rtol=2**-10, atol=2**-10)
+                # transposed and strided operands and output
+                bt = np.ascontiguousarray(b.T).T
+                out = np.zeros((n, m), dtype=xfloat16).T
+                np.matmul(a, bt, out=out)
+                assert_equal(out, c)
+                assert_equal(np.matmul(np.ascontiguousarray(a.T).T, b), c)
+                # a narrower product may take another path, so it is
+                # compared with the same shape contiguous
+                assert_equal(np.matmul(a[::2], b[:, ::3]),
+                             np.matmul(a[::2].copy(), b[:, ::3].copy()))
+            # stacked matrices and vectors
+            a = rs.uniform(-1, 1, (3, 4, 20)).astype(xfloat16)
+            b = rs.uniform(-1, 1, (20, 6)).astype(xfloat16)
+            assert_equal(np.matmul(a, b)[1], np.matmul(a[1], b))
+            assert_equal(np.matmul(a[0, 0], b), np.matmul(a[0, :1], b)[0])
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+
+def test_half_threads():
+    """Checks that large casts and loops split between threads give the
+       same results and floating point errors as serial ones"""
+    from half import xfloat16, numpy_xhalf
+    import os
+
+    rs = np.random.RandomState(11)
+    f = (rs.randn(1000003) * 1000).astype(float32)
+    h = f.astype(xfloat16)
+    nthreads = numpy_xhalf.get_num_threads()
+    omp = os.environ.pop("OMP_NUM_THREADS", None)
+    try:
+        numpy_xhalf.set_num_threads(1)
+        ref = [h.view(uint16).copy(), h.astype(float32), h.astype(float64),
+               f.astype(float64).astype(xfloat16).view(uint16),
+               f.astype(np.int32).astype(xfloat16).view(uint16),
+               (h + h[::-1]).view(uint16), h < h[::-1]]
+        assert_equal(numpy_xhalf.set_num_threads(4), 4)
+        assert_equal(numpy_xhalf.get_num_threads(), 4)
+        got = [f.astype(xfloat16).view(uint16), h.astype(float32),
+               h.astype(float64),
+               f.astype(float64).astype(xfloat16).view(uint16),
+               f.astype(np.int32).astype(xfloat16).view(uint16),
+               (h + h[::-1]).view(uint16), h < h[::-1]]
+        for r, g in zip(ref, got):
+            assert_equal(g, r)
+        # reductions stay serial
+        assert_equal(np.add.reduce(np.full(2**18, 2**-4, dtype=xfloat16)),
+                     2**14)
+        # errors raised by the worker threads reach the caller
+        g = np.ones(1000003, dtype=xfloat16)
+        g[-5] = 300
+        with np.errstate(over='raise'):
+            assert_raises(FloatingPointError, np.multiply, g, g)
+        # the default follows OMP_NUM_THREADS, then the CPU affinity
+        os.environ["OMP_NUM_THREADS"] = "3,2"
+        assert_equal(numpy_xhalf.set_num_threads(0), 3)
+        del os.environ["OMP_NUM_THREADS"]
+        if hasattr(os, "sched_getaffinity"):
+            assert_equal(numpy_xhalf.set_num_threads(0),
+                         min(len(os.sched_getaffinity(0)), 64))
+    finally:
+        os.environ.pop("OMP_NUM_THREADS", None)
+        if omp is not None:
+            os.environ["OMP_NUM_THREADS"] = omp
+        numpy_xhalf.set_num_threads(nthreads)
+
+def test_half_casts_release_gil():
+    """Checks that xfloat16 casts do not require the Python API, and that
+       concurrent casts from several threads agree with serial ones"""
+    import threading
+    from half import xfloat16
+
+    NPY_NEEDS_PYAPI = 0x10
+    assert_equal(np.dtype(xfloat16).flags & NPY_NEEDS_PYAPI, 0)
+
+    rs = np.random.RandomState(5)
+    arrays = [rs.randn(200000).astype(float32) for i in range(4)]
+    expected = [a.astype(xfloat16).view(uint16) for a in arrays]
+    results = [None]*4
+
+    def work(i):
+        h = arrays[i].astype(xfloat16)
+        results[i] = (h.view(uint16), h.astype(float64), h + h)
+
+    threads = [threading.Thread(target=work, args=(i,)) for i in range(4)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    for i in range(4):
+        assert_equal(results[i][0], expected[i])
+        assert_equal(results[i][1], expected[i].view(xfloat16).astype(float64))
+        assert_equal(results[i][2].astype(float64), 2*results[i][1])
+
+def test_half_decode_table():
+    """Checks that table and bit manipulation decoding agree, including
+       NaN payloads, at every SIMD level"""
+    from half import xfloat16, numpy_xhalf
+
+    a = np.arange(0x10000, dtype=uint16)
+    h = a.view(xfloat16)
+    level = numpy_xhalf.simd_level()
+    mode = numpy_xhalf.decode_mode()
+    try:
+        numpy_xhalf.set_simd_level(0)
+        numpy_xhalf.set_decode_mode(numpy_xhalf.DECODE_BITS)
+        f32 = h.astype(float32).view(np.uint32)
+        f64 = h.astype(float64).view(np.uint64)
+        for l in range(level+1):
+            numpy_xhalf.set_simd_level(l)
+            for m in [numpy_xhalf.DECODE_AUTO, numpy_xhalf.DECODE_BITS,
+                      numpy_xhalf.DECODE_TABLE]:
+                numpy_xhalf.set_decode_mode(m)
+                assert_equal(h.astype(float32).view(np.uint32), f32)
+                assert_equal(h.astype(float64).view(np.uint64), f64)
+                assert_equal(h.astype(np.complex128).real.view(np.uint64),
+                             f64)
+                assert_equal(h.astype(np.longdouble)[:0x7c01],
+                             f64.view(float64)[:0x7c01])
+                assert_equal(h[::-3].astype(np.int64),
+                             f32.view(float32)[::-3].astype(np.int64))
+                with np.errstate(invalid='ignore'):
+                    assert_equal((h[::2] * 1).view(uint16),
+                                 (h[::2].astype(float32) * 1)
+                                 .astype(xfloat16).view(uint16))
+                assert_equal(np.float64(h[12345]).view(np.uint64), f64[12345])
+        assert_raises(ValueError, numpy_xhalf.set_decode_mode, 5)
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+        numpy_xhalf.set_decode_mode(mode)
+
+def test_half_bfloat16():
+    """Checks the bfloat16 dtype: conversions, arithmetic and comparisons,
+       at every SIMD level"""
+    from half import xfloat16, bfloat16, numpy_xhalf
+
+    a = np.arange(0x10000, dtype=uint16)
+    b = a.view(bfloat16)
+    # Round to nearest even on the dropped 16 bits, NaNs keep their payload
+    rs = np.random.RandomState(97531)
+    f = np.concatenate([rs.randint(0, 2**32, 100000, dtype=np.uint64),
+                        np.arange(0x7f7f0000, 0x7f810000, 0x4000),
+                        np.arange(0, 0x30000, 0x4000),
+                        [0x7f800001, 0xff80ffff, 0x7fc00000]]).astype(np.uint32)
+    ff = f.view(float32)
+    r = (f.astype(np.uint64) + 0x7fff + ((f >> 16) & 1)) >> 16
+    r = np.where(np.isnan(ff), (f >> 16) | (((f >> 16) & 0x7f) == 0), r)
+    r = r.astype(uint16)
+
+    level = numpy_xhalf.simd_level()
+    try:
+        for l in range(level+1):
+            numpy_xhalf.set_simd_level(l)
+            assert_equal(b.astype(float32).view(np.uint32),
+                         a.astype(np.uint32) << 16)
+            assert_equal(b.astype(float32).astype(bfloat16).view(uint16), a)
+            assert_equal(b.astype(float64).astype(bfloat16).view(uint16), a)
+            with np.errstate(over='ignore'):
+                assert_equal(ff.astype(bfloat16).view(uint16), r)
+                assert_equal(ff[::3].astype(bfloat16).view(uint16), r[::3])
+            # Doubles round once, not through float32
+            d = np.array([1 + 2**-8, 1 + 3*2**-8, 1 + 2**-8 + 2**-40,
+                          -(1 + 2**-8 + 2**-40), 2**-133, 2**-134,
+                          2**-134 + 2**-160, 1e300], dtype=float64)
+            with np.errstate(over='ignore'):
+                assert_equal(d.astype(bfloat16).astype(float64),
+                             [1, 1 + 2**-6, 1 + 2**-7, -(1 + 2**-7),
+                              2**-133, 0, 2**-133, np.inf])
+            # xfloat16 <-> bfloat16 round through float32
+            h = a.view(xfloat16)
+            assert_equal(h.astype(bfloat16).view(uint16),
+                         h.astype(float32).astype(bfloat16).view(uint16))
+            assert_equal(b.astype(xfloat16).view(uint16),
+                         b.astype(float32).astype(xfloat16).view(uint16))
+            # Arithmetic rounds the float32 result once
+            x = rs.uniform(-100, 100, 1000).astype(bfloat16)
+            y = rs.uniform(-100, 100, 1000).astype(bfloat16)
+            xf, yf = x.astype(float32), y.astype(float32)
+            for op in [np.add, np.subtract, np.multiply, np.true_divide]:
+                assert_equal(op(x, y).view(uint16),
+                             op(xf, yf).astype(bfloat16).view(uint16))
+                assert_equal(op(x[::2], y[1::2]).view(uint16),
+                             op(xf[::2], yf[1::2]).astype(bfloat16)
+                             .view(uint16))
+            assert_equal(float(np.sum(x)),
+                         float(np.array(xf.astype(float64).sum(),
+                                        dtype=bfloat16)))
+            # Comparisons and maximum/minimum, with NaNs and signed zeros
+            x[::7] = np.nan
+            x[1::11] = 0.0
+            y[1::11] = -0.0
+            xf, yf = x.astype(float32), y.astype(float32)
+            for op in [np.equal, np.not_equal, np.less, np.less_equal,
+                       np.greater, np.greater_equal]:
+                assert_equal(op(x, y), op(xf, yf))
+            assert_equal(np.maximum(x, y).astype(float32),
+                         np.maximum(xf, yf))
+            assert_equal(np.minimum(y, x).astype(float32),
+                         np.minimum(yf, xf))
+            assert_(np.isnan(float(np.max(x))))
+            assert_equal(np.argmax(x[1:7]), np.argmax(xf[1:7]))
+        with warnings.catch_warnings(record=True) as w:
+            warnings.simplefilter('always')
+            np.multiply(np.array([3e38], dtype=bfloat16), 2)
+            assert_(len(w) == 1 and 'overflow' in str(w[0].message))
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+
+def test_half_bfloat16_bits():
+    """Checks the direct xfloat16 <-> bfloat16 conversions on raw bits at
+       every SIMD level"""
+    from half import xfloat16, bfloat16, numpy_xhalf
+
+    a = np.arange(0x10000, dtype=uint16)
+    to_half = a.view(bfloat16).astype(float32).astype(xfloat16).view(uint16)
+    to_bf16 = a.view(xfloat16).astype(float32).astype(bfloat16).view(uint16)
+    level = numpy_xhalf.simd_level()
+    try:
+        for l in range(level+1):
+            numpy_xhalf.set_simd_level(l)
+            with np.errstate(all='ignore'):
+                h = numpy_xhalf.bfloat16_to_xfloat16(a)
+                assert_equal(h.dtype, np.dtype(xfloat16))
+                assert_equal(h.view(uint16), to_half)
+                assert_equal(numpy_xhalf.bfloat16_to_xfloat16(a.view(bfloat16))
+                             .view(uint16), to_half)
+                assert_equal(a.view(bfloat16).astype(xfloat16).view(uint16),
+                             to_half)
+            b = numpy_xhalf.xfloat16_to_bfloat16(a.reshape(256, 256))
+            assert_equal(b.dtype, np.dtype(bfloat16))
+            assert_equal(b.shape, (256, 256))
+            assert_equal(b.view(uint16).ravel(), to_bf16)
+            assert_equal(a.view(xfloat16).astype(bfloat16).view(uint16),
+                         to_bf16)
+            # Strided input is copied, the output can be given
+            out = np.zeros(0x8000, dtype=bfloat16)
+            r = numpy_xhalf.xfloat16_to_bfloat16(a[::2].view(xfloat16), out=out)
+            assert_(r is out)
+            assert_equal(out.view(uint16), to_bf16[::2])
+        assert_raises(TypeError, numpy_xhalf.bfloat16_to_xfloat16,
+                      np.zeros(3, dtype=float32))
+        assert_raises(ValueError, numpy_xhalf.xfloat16_to_bfloat16, a,
+                      out=np.zeros(3, dtype=bfloat16))
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+
+def test_half_fp8():
+    """Checks the FP8 types against a reference rounding at every SIMD
+       level, in both saturation modes"""
+    from half import xfloat16, bfloat16, numpy_xhalf
+    from half import float8_e4m3fn, float8_e5m2
+
+    def reference(x, e5m2, saturate):
+        # The finite positive values, plus the one past the largest
+        if e5m2:
+            vals = (np.arange(0x7c, dtype=uint16) << 8).view(float16)
+        else:
+            m = np.arange(0x7f) & 7
+            e = np.arange(0x7f) >> 3
+            vals = np.where(e == 0, m * 2.0**-9, (1 + m/8.0) * 2.0**(e - 7))
+        vals = np.append(vals.astype(float64), 2*vals[-1] - vals[-2])
+        big = 0x7c if e5m2 else 0x7f
+        a = np.abs(x)
+        hi = np.clip(np.searchsorted(vals, a), 1, len(vals) - 1)
+        lo = hi - 1
+        up = (vals[hi] - a < a - vals[lo]) | \
+             ((vals[hi] - a == a - vals[lo]) & (hi % 2 == 0))
+        r = np.where(up, hi, lo)
+        r = np.where(r == len(vals) - 1, len(vals) - 2 if saturate else big, r)
+        return (r | np.where(np.signbit(x), 0x80, 0)).astype(np.uint8)
+
+    halves = np.arange(0x10000, dtype=uint16).view(float16)
+    halves = halves[~np.isnan(halves)]
+    f = np.concatenate([halves.astype(float32),
+                        np.array([448, 464, 464.01, 480, 57344, 61440,
+                                  61439.9, 2.0**-10, 1.5*2.0**-10, 2.0**-17,
+                                  3e38, 1e-40], dtype=float32)])
+    f = np.concatenate([f, -f, np.nextafter(f, float32(np.inf))])
+    level = numpy_xhalf.simd_level()
+    try:
+        for t, e5m2 in ((float8_e4m3fn, 0), (float8_e5m2, 1)):
+            bits = np.arange(256, dtype=np.uint8)
+            vals = bits.view(t).astype(float64)
+            # Every value round trips, through any of the wider types
+            for wide in (xfloat16, bfloat16, float32, float64):
+                assert_equal(bits.view(t).astype(wide).astype(t).view(np.uint8),
+                             bits)
+            for saturate in (numpy_xhalf.FP8_NONSATURATING,
+                             numpy_xhalf.FP8_SATURATING):
+                numpy_xhalf.set_fp8_saturation(saturate)
+                assert_equal(numpy_xhalf.fp8_saturation(), saturate)
+                expect = reference(f.astype(float64), e5m2, saturate)
+                for l in range(level+1):
+                    numpy_xhalf.set_simd_level(l)
+                    assert_equal(bits.view(t).astype(float32),
+                                 vals.astype(float32))
+                    with np.errstate(all='ignore'):
+                        assert_equal(f.astype(t).view(np.uint8), expect)
+                        assert_equal(f.astype(float64).astype(t)
+                                          .view(np.uint8), expect)
+                        assert_equal(halves.view(xfloat16).astype(t)
+                                           .view(np.uint8),
+                                     reference(halves.astype(float64),
+                                               e5m2, saturate))
+            numpy_xhalf.set_fp8_saturation(numpy_xhalf.FP8_NONSATURATING)
+            # NaNs stay NaNs
+            assert_(np.isnan(np.array([np.nan], dtype=float32).astype(t)
+                             .astype(float32)[0]))
+            # Arithmetic promotes to float32
+            a = np.array([1, 2, 3], dtype=t)
+            assert_equal((a + a).dtype, np.dtype(float32))
+            assert_equal(a + a, [2, 4, 6])
+            assert_equal(np.argmax(a), 2)
+            assert_equal(np.sort(a[::-1]).astype(float32), [1, 2, 3])
+            assert_equal(float(t(2.25)), 2.25 if not e5m2 else 2.0)
+        # Neither FP8 type holds the other, so there is no safe cast or
+        # common type between them; they convert through xfloat16
+        e4, e5 = np.dtype(float8_e4m3fn), np.dtype(float8_e5m2)
+        assert_(not np.can_cast(e4, e5) and not np.can_cast(e5, e4))
+        a5 = np.array([57344.], dtype=e5)
+        a4 = np.array([1.], dtype=e4)
+        assert_raises(TypeError, np.concatenate, [a5, a4])
+        assert_equal(np.concatenate([a5.astype(xfloat16),
+                                     a4.astype(xfloat16)]), [57344, 1])
+        assert_equal(a4.astype(xfloat16).astype(e5).astype(float32), [1])
+        assert_raises(ValueError, numpy_xhalf.set_fp8_saturation, 2)
+    finally:
+        numpy_xhalf.set_simd_level(-1)
+        numpy_xhalf.set_fp8_saturation(numpy_xhalf.FP8_NONSATURATING)